@@ -0,0 +1,773 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#define ASYNC_IO_IOCP 1
+#elif defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+// IORING_FEAT_FAST_POLL came with 5.7, whose header has every opcode used here
+#if defined(__NR_io_uring_setup) && defined(IORING_FEAT_FAST_POLL)
+#define ASYNC_IO_URING 1
+#endif
+#endif
+#endif
+
+// Whole-file reads with many requests in flight, for slow or remote storage
+// (network shares, cold disks) where opening and reading one file at a time
+// leaves the scanner waiting on latency. Backends: io_uring on Linux (raw
+// system calls, no liburing needed), overlapped reads on an I/O completion
+// port on Windows, and a pool of reader threads everywhere else.
+// Kept free of pybind11 like text_unescape.h.
+
+namespace async_io {
+
+enum class Backend { Threads, IoUring, Iocp };
+
+inline const char* backend_name(Backend backend) {
+    switch (backend) {
+        case Backend::Threads: return "threads";
+        case Backend::IoUring: return "io_uring";
+        case Backend::Iocp: return "iocp";
+    }
+    return "threads";
+}
+
+// Contents of one file, or why there are none
+struct ReadResult {
+    void* context = nullptr;   // The caller's tag, handed back unchanged
+    std::string path;
+    std::string data;
+    bool ok = false;           // False if the file could not be opened or read
+    bool too_large = false;    // At or above the size limit; left for the caller to map
+    double seconds = 0;        // From the start of the read to its completion
+};
+
+// Read a file the blocking way; used by the thread backend
+inline void read_file(ReadResult& result, uint64_t size_limit) {
+    std::error_code ec;
+    uintmax_t size = std::filesystem::file_size(result.path, ec);
+    if (ec) {
+        return;
+    }
+    if (size >= size_limit && size > 0) {
+        result.ok = true;
+        result.too_large = true;
+        return;
+    }
+    std::ifstream file(result.path, std::ios::binary);
+    if (!file.is_open()) {
+        return;
+    }
+    result.data.resize(static_cast<size_t>(size));
+    file.read(result.data.data(), static_cast<std::streamsize>(size));
+    result.data.resize(static_cast<size_t>(file.gcount()));
+    result.ok = true;
+}
+
+#if defined(ASYNC_IO_URING)
+// Minimal io_uring: one submission and one completion ring, driven by a
+// single thread
+class Ring {
+public:
+    Ring() = default;
+    ~Ring() {
+        if (sqes) {
+            munmap(sqes, sqes_size);
+        }
+        if (cq_ptr && cq_ptr != sq_ptr) {
+            munmap(cq_ptr, cq_size);
+        }
+        if (sq_ptr) {
+            munmap(sq_ptr, sq_size);
+        }
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+
+    Ring(const Ring&) = delete;
+    Ring& operator=(const Ring&) = delete;
+
+    bool init(unsigned entries) {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (fd < 0) {
+            return false;
+        }
+        sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single_mmap) {
+            sq_size = cq_size = std::max(sq_size, cq_size);
+        }
+        sq_ptr = map(sq_size, IORING_OFF_SQ_RING);
+        if (!sq_ptr) {
+            return false;
+        }
+        cq_ptr = single_mmap ? sq_ptr : map(cq_size, IORING_OFF_CQ_RING);
+        if (!cq_ptr) {
+            return false;
+        }
+        sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = static_cast<io_uring_sqe*>(map(sqes_size, IORING_OFF_SQES));
+        if (!sqes) {
+            return false;
+        }
+        char* sq = static_cast<char*>(sq_ptr);
+        sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sq_mask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        sq_entries = params.sq_entries;
+        char* cq = static_cast<char*>(cq_ptr);
+        cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        local_tail = *sq_tail;
+        return true;
+    }
+
+    // Whether the kernel implements every operation FileReader uses
+    bool supports_file_reads() const {
+        constexpr unsigned op_count = 256;
+        std::vector<char> buffer(sizeof(io_uring_probe) + op_count * sizeof(io_uring_probe_op), 0);
+        auto* probe = reinterpret_cast<io_uring_probe*>(buffer.data());
+        if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, op_count) < 0) {
+            return false;
+        }
+        for (unsigned op : {IORING_OP_STATX, IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_POLL_ADD}) {
+            if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Next free submission entry, cleared, or nullptr if the ring is full
+    io_uring_sqe* next_sqe() {
+        unsigned head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+        if (local_tail - head >= sq_entries) {
+            return nullptr;
+        }
+        unsigned index = local_tail & sq_mask;
+        sq_array[index] = index;
+        local_tail++;
+        unsubmitted++;
+        io_uring_sqe* sqe = &sqes[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        return sqe;
+    }
+
+    // Hand queued entries to the kernel and wait for at least `wait` completions
+    bool submit(unsigned wait) {
+        __atomic_store_n(sq_tail, local_tail, __ATOMIC_RELEASE);
+        while (true) {
+            long submitted = syscall(__NR_io_uring_enter, fd, unsubmitted, wait,
+                                     wait > 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+            if (submitted >= 0) {
+                unsubmitted -= static_cast<unsigned>(submitted);
+                return true;
+            }
+            if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                return false;
+            }
+        }
+    }
+
+    bool pop(io_uring_cqe& out) {
+        unsigned head = *cq_head;
+        if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+            return false;
+        }
+        out = cqes[head & cq_mask];
+        __atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+private:
+    int fd = -1;
+    void* sq_ptr = nullptr;
+    void* cq_ptr = nullptr;
+    size_t sq_size = 0;
+    size_t cq_size = 0;
+    size_t sqes_size = 0;
+    io_uring_sqe* sqes = nullptr;
+    unsigned* sq_head = nullptr;
+    unsigned* sq_tail = nullptr;
+    unsigned* sq_array = nullptr;
+    unsigned sq_mask = 0;
+    unsigned sq_entries = 0;
+    unsigned local_tail = 0;
+    unsigned unsubmitted = 0;
+    unsigned* cq_head = nullptr;
+    unsigned* cq_tail = nullptr;
+    unsigned cq_mask = 0;
+    io_uring_cqe* cqes = nullptr;
+
+    void* map(size_t size, off_t offset) {
+        void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+        return ptr == MAP_FAILED ? nullptr : ptr;
+    }
+};
+#endif
+
+// io_uring can be compiled in but refused at runtime (old kernel, seccomp
+// filters in containers), so it is probed once
+inline bool io_uring_available() {
+#if defined(ASYNC_IO_URING)
+    static const bool available = [] {
+        Ring ring;
+        return ring.init(4) && ring.supports_file_reads();
+    }();
+    return available;
+#else
+    return false;
+#endif
+}
+
+inline bool iocp_available() {
+#if defined(ASYNC_IO_IOCP)
+    return true;
+#else
+    return false;
+#endif
+}
+
+inline Backend best_backend() {
+    if (iocp_available()) {
+        return Backend::Iocp;
+    }
+    return io_uring_available() ? Backend::IoUring : Backend::Threads;
+}
+
+// Reads whole files in the background and hands each one to `on_read` as
+// soon as it completes, in completion order, on one of the reader's own
+// threads. At most `depth` files are held at a time: a file's slot is taken
+// when its read starts and given back by release(), which the consumer
+// calls once it is done with the contents. Files at or above `size_limit`
+// bytes are not read; they come back with too_large set.
+class FileReader {
+public:
+    using Callback = std::function<void(ReadResult&&)>;
+
+    static constexpr size_t max_depth = 1024;
+
+    FileReader(Backend requested, size_t depth, uint64_t size_limit, Callback on_read)
+        : backend_(requested), depth(std::clamp<size_t>(depth, 1, max_depth)), size_limit(size_limit),
+          on_read(std::move(on_read)) {
+        if (backend_ == Backend::IoUring && !start_uring()) {
+            backend_ = Backend::Threads;
+        }
+        if (backend_ == Backend::Iocp && !start_iocp()) {
+            backend_ = Backend::Threads;
+        }
+        if (backend_ == Backend::Threads) {
+            for (size_t i = 0; i < this->depth; i++) {
+                threads.emplace_back([this] { run_threads(); });
+            }
+        }
+    }
+
+    ~FileReader() {
+        close();
+#if defined(ASYNC_IO_URING)
+        if (wake_fd >= 0) {
+            ::close(wake_fd);
+        }
+#endif
+    }
+
+    FileReader(const FileReader&) = delete;
+    FileReader& operator=(const FileReader&) = delete;
+
+    // The backend in use; io_uring and IOCP fall back to threads if they
+    // cannot be set up
+    Backend backend() const {
+        return backend_;
+    }
+
+    // Queue a read; never blocks
+    void read(std::string path, void* context = nullptr) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ReadResult& result = pending.emplace_back();
+            result.path = std::move(path);
+            result.context = context;
+            outstanding++;
+        }
+        ready.notify_one();
+        wake();
+    }
+
+    // Give back the slot of a delivered file
+    void release() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            in_use--;
+        }
+        ready.notify_one();
+        wake();
+    }
+
+    // Drop the reads that have not started; the ones in flight are still delivered
+    void cancel() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            outstanding -= pending.size();
+            pending.clear();
+        }
+        ready.notify_all();
+        drained.notify_all();
+    }
+
+    // Wait until every queued file has been delivered, then stop the reader
+    // threads. The consumer must keep releasing slots meanwhile; release()
+    // may still be called afterwards, until the reader is destroyed.
+    void close() {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            closing = true;
+            ready.notify_all();
+            wake();
+            drained.wait(lock, [this] { return outstanding == 0; });
+        }
+        ready.notify_all();
+        wake();
+        for (auto& thread : threads) {
+            if (thread.joinable()) {
+                thread.join();
+            }
+        }
+        threads.clear();
+#if defined(ASYNC_IO_IOCP)
+        if (port) {
+            PostQueuedCompletionStatus(port, 0, quit_key, nullptr);
+            if (completion_thread.joinable()) {
+                completion_thread.join();
+            }
+            CloseHandle(port);
+            port = nullptr;
+        }
+#endif
+    }
+
+private:
+    Backend backend_;
+    const size_t depth;
+    const uint64_t size_limit;
+    Callback on_read;
+
+    // Reader threads wait on `ready` for work, close() on `drained`. Each
+    // change wakes one reader, which passes it on if work is left.
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::condition_variable drained;
+    std::deque<ReadResult> pending;   // Queued, not started
+    size_t in_use = 0;                // Started and not yet released
+    size_t outstanding = 0;           // Queued or started, not yet delivered
+    bool closing = false;
+    std::vector<std::thread> threads;
+
+    using Clock = std::chrono::steady_clock;
+
+    static double since(Clock::time_point start) {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    // Wait for a queued read and a free slot; false once closed and drained
+    bool take(ReadResult& out) {
+        std::unique_lock<std::mutex> lock(mutex);
+        ready.wait(lock, [this] { return (!pending.empty() && in_use < depth) || (closing && pending.empty()); });
+        if (pending.empty()) {
+            ready.notify_all();
+            return false;
+        }
+        out = std::move(pending.front());
+        pending.pop_front();
+        in_use++;
+        if (!pending.empty() && in_use < depth) {
+            ready.notify_one();
+        }
+        return true;
+    }
+
+    void deliver(ReadResult&& result) {
+        on_read(std::move(result));
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--outstanding > 0) {
+                return;
+            }
+        }
+        drained.notify_all();
+    }
+
+    void run_threads() {
+        ReadResult result;
+        while (take(result)) {
+            auto start = Clock::now();
+            read_file(result, size_limit);
+            result.seconds = since(start);
+            deliver(std::move(result));
+            result = ReadResult();
+        }
+    }
+
+#if defined(ASYNC_IO_URING)
+    // Each file goes through statx (size, without opening), openat and as
+    // many reads as it takes, all on the ring. The reader thread also keeps
+    // a poll on an eventfd in flight, so read() and release() can wake it.
+    int wake_fd = -1;
+
+    static constexpr uint64_t wake_tag = ~uint64_t(0);
+
+    struct UringRequest {
+        enum class Stage { Statx, Open, Read };
+        Stage stage = Stage::Statx;
+        bool busy = false;
+        ReadResult result;
+        struct statx info;
+        int fd = -1;
+        size_t done = 0;
+        Clock::time_point start;
+    };
+
+    void wake() {
+        if (wake_fd >= 0) {
+            uint64_t one = 1;
+            while (::write(wake_fd, &one, sizeof(one)) < 0 && errno == EINTR) {
+            }
+        }
+    }
+
+    bool start_uring() {
+        auto ring = std::make_shared<Ring>();
+        // Each slot has at most one operation in flight, plus the wake poll
+        if (!ring->init(static_cast<unsigned>(depth + 1)) || !ring->supports_file_reads()) {
+            return false;
+        }
+        wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (wake_fd < 0) {
+            return false;
+        }
+        threads.emplace_back([this, ring] { run_uring(*ring); });
+        return true;
+    }
+
+    void run_uring(Ring& ring) {
+        std::vector<UringRequest> slots(depth);
+        std::vector<size_t> free_slots;
+        for (size_t i = depth; i-- > 0;) {
+            free_slots.push_back(i);
+        }
+        size_t active = 0;
+        bool wake_armed = false;
+        auto arm_wake = [&] {
+            if (io_uring_sqe* sqe = ring.next_sqe()) {
+                sqe->opcode = IORING_OP_POLL_ADD;
+                sqe->fd = wake_fd;
+                sqe->poll_events = POLLIN;
+                sqe->user_data = wake_tag;
+                wake_armed = true;
+            }
+        };
+        auto finish = [&](size_t index, bool ok) {
+            UringRequest& request = slots[index];
+            if (request.fd >= 0) {
+                ::close(request.fd);
+                request.fd = -1;
+            }
+            request.result.ok = ok;
+            if (!ok) {
+                request.result.data.clear();
+            }
+            request.result.seconds = since(request.start);
+            ReadResult result = std::move(request.result);
+            request = UringRequest();
+            free_slots.push_back(index);
+            active--;
+            deliver(std::move(result));
+        };
+        auto queue_read = [&](size_t index) {
+            UringRequest& request = slots[index];
+            io_uring_sqe* sqe = ring.next_sqe();
+            request.stage = UringRequest::Stage::Read;
+            sqe->opcode = IORING_OP_READ;
+            sqe->fd = request.fd;
+            sqe->addr = reinterpret_cast<uint64_t>(request.result.data.data() + request.done);
+            sqe->len = static_cast<uint32_t>(std::min<size_t>(request.result.data.size() - request.done, 1u << 30));
+            sqe->off = request.done;
+            sqe->user_data = index;
+        };
+
+        arm_wake();
+        while (true) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                while (!pending.empty() && in_use < depth && !free_slots.empty()) {
+                    size_t index = free_slots.back();
+                    free_slots.pop_back();
+                    UringRequest& request = slots[index];
+                    request.result = std::move(pending.front());
+                    pending.pop_front();
+                    request.start = Clock::now();
+                    request.busy = true;
+                    in_use++;
+                    active++;
+                    io_uring_sqe* sqe = ring.next_sqe();
+                    sqe->opcode = IORING_OP_STATX;
+                    sqe->fd = AT_FDCWD;
+                    sqe->addr = reinterpret_cast<uint64_t>(request.result.path.c_str());
+                    sqe->len = STATX_SIZE;
+                    sqe->off = reinterpret_cast<uint64_t>(&request.info);
+                    sqe->user_data = index;
+                }
+                if (closing && pending.empty() && active == 0) {
+                    break;
+                }
+            }
+            if (!wake_armed) {
+                arm_wake();
+            }
+            if (!ring.submit(1)) {
+                break;
+            }
+            io_uring_cqe cqe;
+            while (ring.pop(cqe)) {
+                if (cqe.user_data == wake_tag) {
+                    uint64_t count;
+                    while (::read(wake_fd, &count, sizeof(count)) < 0 && errno == EINTR) {
+                    }
+                    wake_armed = false;
+                    continue;
+                }
+                size_t index = static_cast<size_t>(cqe.user_data);
+                UringRequest& request = slots[index];
+                if (cqe.res < 0) {
+                    finish(index, false);
+                    continue;
+                }
+                switch (request.stage) {
+                    case UringRequest::Stage::Statx: {
+                        uint64_t size = request.info.stx_size;
+                        if (size >= size_limit && size > 0) {
+                            request.result.too_large = true;
+                            finish(index, true);
+                            break;
+                        }
+                        request.result.data.resize(static_cast<size_t>(size));
+                        request.stage = UringRequest::Stage::Open;
+                        io_uring_sqe* sqe = ring.next_sqe();
+                        sqe->opcode = IORING_OP_OPENAT;
+                        sqe->fd = AT_FDCWD;
+                        sqe->addr = reinterpret_cast<uint64_t>(request.result.path.c_str());
+                        sqe->open_flags = O_RDONLY | O_CLOEXEC;
+                        sqe->user_data = index;
+                        break;
+                    }
+                    case UringRequest::Stage::Open:
+                        request.fd = cqe.res;
+                        if (request.result.data.empty()) {
+                            finish(index, true);
+                        } else {
+                            queue_read(index);
+                        }
+                        break;
+                    case UringRequest::Stage::Read:
+                        request.done += static_cast<size_t>(cqe.res);
+                        // A file that shrank since statx ends early
+                        if (cqe.res == 0 || request.done == request.result.data.size()) {
+                            request.result.data.resize(request.done);
+                            finish(index, true);
+                        } else {
+                            queue_read(index);
+                        }
+                        break;
+                }
+            }
+        }
+        // Only reached with nothing in flight but the wake poll, or after
+        // the ring failed; either way, whatever is left is read the plain way
+        for (size_t index = 0; index < slots.size(); index++) {
+            if (slots[index].busy) {
+                finish(index, false);
+            }
+        }
+        ReadResult result;
+        while (take(result)) {
+            auto start = Clock::now();
+            read_file(result, size_limit);
+            result.seconds = since(start);
+            deliver(std::move(result));
+            result = ReadResult();
+        }
+    }
+#else
+    void wake() {}
+
+    bool start_uring() {
+        return false;
+    }
+#endif
+
+#if defined(ASYNC_IO_IOCP)
+    // Windows has no asynchronous open, so a few opener threads open each
+    // file, get its size and start an overlapped read; one thread waits on
+    // the completion port and continues or finishes the reads.
+    static constexpr ULONG_PTR quit_key = 1;
+
+    struct IocpRequest {
+        OVERLAPPED overlapped;   // First, so the OVERLAPPED pointer leads back to the request
+        ReadResult result;
+        HANDLE file = INVALID_HANDLE_VALUE;
+        size_t done = 0;
+        Clock::time_point start;
+    };
+
+    HANDLE port = nullptr;
+    std::thread completion_thread;
+
+    bool start_iocp() {
+        port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1);
+        if (!port) {
+            return false;
+        }
+        completion_thread = std::thread([this] { run_iocp_completions(); });
+        size_t openers = std::min<size_t>(depth, 8);
+        for (size_t i = 0; i < openers; i++) {
+            threads.emplace_back([this] { run_iocp_opener(); });
+        }
+        return true;
+    }
+
+    void finish_iocp(std::unique_ptr<IocpRequest> request, bool ok) {
+        if (request->file != INVALID_HANDLE_VALUE) {
+            CloseHandle(request->file);
+        }
+        request->result.ok = ok;
+        if (!ok) {
+            request->result.data.clear();
+        }
+        request->result.seconds = since(request->start);
+        deliver(std::move(request->result));
+    }
+
+    bool queue_iocp_read(IocpRequest* request) {
+        std::memset(&request->overlapped, 0, sizeof(request->overlapped));
+        request->overlapped.Offset = static_cast<DWORD>(request->done & 0xFFFFFFFFu);
+        request->overlapped.OffsetHigh = static_cast<DWORD>(static_cast<uint64_t>(request->done) >> 32);
+        DWORD length = static_cast<DWORD>(std::min<size_t>(request->result.data.size() - request->done, 1u << 30));
+        // Even a read that finishes at once posts its completion to the port
+        if (ReadFile(request->file, request->result.data.data() + request->done, length, nullptr,
+                     &request->overlapped)) {
+            return true;
+        }
+        return GetLastError() == ERROR_IO_PENDING;
+    }
+
+    void run_iocp_opener() {
+        ReadResult result;
+        while (take(result)) {
+            auto request = std::make_unique<IocpRequest>();
+            request->result = std::move(result);
+            result = ReadResult();
+            request->start = Clock::now();
+            request->file = CreateFileW(std::filesystem::path(request->result.path).wstring().c_str(), GENERIC_READ,
+                                        FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                        FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+            LARGE_INTEGER size;
+            if (request->file == INVALID_HANDLE_VALUE || !GetFileSizeEx(request->file, &size)) {
+                finish_iocp(std::move(request), false);
+                continue;
+            }
+            uint64_t bytes = static_cast<uint64_t>(size.QuadPart);
+            if (bytes >= size_limit && bytes > 0) {
+                request->result.too_large = true;
+                finish_iocp(std::move(request), true);
+                continue;
+            }
+            if (bytes == 0) {
+                finish_iocp(std::move(request), true);
+                continue;
+            }
+            request->result.data.resize(static_cast<size_t>(bytes));
+            if (!CreateIoCompletionPort(request->file, port, 0, 0) || !queue_iocp_read(request.get())) {
+                finish_iocp(std::move(request), false);
+                continue;
+            }
+            // Owned by the pending read until its completion comes back
+            request.release();
+        }
+    }
+
+    void run_iocp_completions() {
+        while (true) {
+            DWORD bytes = 0;
+            ULONG_PTR key = 0;
+            OVERLAPPED* overlapped = nullptr;
+            BOOL ok = GetQueuedCompletionStatus(port, &bytes, &key, &overlapped, INFINITE);
+            if (!overlapped) {
+                if (key == quit_key || !ok) {
+                    return;
+                }
+                continue;
+            }
+            std::unique_ptr<IocpRequest> request(reinterpret_cast<IocpRequest*>(overlapped));
+            bool at_end = !ok && GetLastError() == ERROR_HANDLE_EOF;
+            if (!ok && !at_end) {
+                finish_iocp(std::move(request), false);
+                continue;
+            }
+            request->done += bytes;
+            if (at_end || bytes == 0 || request->done == request->result.data.size()) {
+                request->result.data.resize(request->done);
+                finish_iocp(std::move(request), true);
+            } else if (queue_iocp_read(request.get())) {
+                request.release();
+            } else {
+                finish_iocp(std::move(request), false);
+            }
+        }
+    }
+#else
+    bool start_iocp() {
+        return false;
+    }
+#endif
+};
+
+}  // namespace async_io
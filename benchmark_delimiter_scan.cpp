@@ -0,0 +1,101 @@
+// Micro-benchmark: vectorized delimiter search (delimiter_scan.h) at each
+// instruction-set level this CPU supports, against the plain byte loop.
+//
+// Build and run:
+//   c++ -O2 -std=c++17 benchmark_delimiter_scan.cpp -o benchmark_delimiter_scan
+//   ./benchmark_delimiter_scan [iterations]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "delimiter_scan.h"
+
+// Bytes LiteralScanner::scan_line stops at
+static constexpr delimiter_scan::Needles<5> delimiters = {'"', '\'', ':', '=', '<'};
+
+// Typical lines: short script lines, long prose and minified JSON
+static std::vector<std::string> make_samples() {
+    std::string minified;
+    for (int i = 0; i < 200; i++) {
+        minified += "{\"id\":" + std::to_string(i) + ",\"text\":\"Line number " + std::to_string(i) +
+                    " of the opening cutscene dialogue\"},";
+    }
+    std::vector<std::string> samples = {
+        "    player.say(\"Hello there\");",
+        "    if (count >= 10) return;",
+        "<text>Welcome to the village</text>",
+        "        // Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod tempor "
+        "incididunt ut labore et dolore magna aliqua. Ut enim ad minim veniam, quis nostrud",
+        minified,
+    };
+    return samples;
+}
+
+// Count every delimiter by jumping from one match to the next
+static size_t count_delimiters(const std::string& line) {
+    size_t count = 0;
+    for (size_t i = delimiter_scan::find_first_of(line, 0, delimiters); i < line.size();
+         i = delimiter_scan::find_first_of(line, i + 1, delimiters)) {
+        count++;
+    }
+    return count;
+}
+
+static double run(const std::vector<std::string>& samples, size_t iterations, size_t& checksum) {
+    size_t bytes = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+        for (const auto& sample : samples) {
+            checksum += count_delimiters(sample);
+            bytes += sample.size();
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    return bytes / std::chrono::duration<double>(end - start).count() / (1024.0 * 1024.0);
+}
+
+int main(int argc, char** argv) {
+    size_t iterations = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 20000;
+    std::vector<std::string> samples = make_samples();
+    const delimiter_scan::Level best = delimiter_scan::detect_level();
+
+    std::vector<delimiter_scan::Level> levels = {delimiter_scan::Level::Scalar};
+    if (best == delimiter_scan::Level::Avx2) {
+        levels.push_back(delimiter_scan::Level::Sse2);
+    }
+    if (best != delimiter_scan::Level::Scalar) {
+        levels.push_back(best);
+    }
+
+    // Every level has to find exactly the same positions
+    std::vector<size_t> expected;
+    for (const auto& sample : samples) {
+        delimiter_scan::set_max_level(delimiter_scan::Level::Scalar);
+        expected.push_back(count_delimiters(sample));
+    }
+    for (auto level : levels) {
+        delimiter_scan::set_max_level(level);
+        for (size_t i = 0; i < samples.size(); i++) {
+            if (count_delimiters(samples[i]) != expected[i]) {
+                std::fprintf(stderr, "Mismatch at level %s on sample %zu\n", delimiter_scan::level_name(level), i);
+                return 1;
+            }
+        }
+    }
+
+    size_t checksum = 0;
+    double scalar_rate = 0;
+    for (auto level : levels) {
+        delimiter_scan::set_max_level(level);
+        double rate = run(samples, iterations, checksum);
+        if (level == delimiter_scan::Level::Scalar) {
+            scalar_rate = rate;
+        }
+        std::printf("%-7s %10.1f MiB/s  (%.1fx)\n", delimiter_scan::level_name(level), rate, rate / scalar_rate);
+    }
+    std::printf("checksum %zu\n", checksum);
+    return 0;
+}
@@ -0,0 +1,407 @@
+// End-to-end benchmark of the extraction pipeline, stage by stage: scan
+// (directory walk), extract, split and save, then all of them at once with
+// extract_to_directory ("pipeline"). Reports files/s, MB/s, chunks/s and
+// peak RSS for each stage.
+//
+// Without directory arguments it generates synthetic game corpora in a
+// temporary directory (many small script files, a few huge single-line
+// JSON files, an XML-heavy tree and a Shift-JIS tree), benchmarks each and
+// removes them again. The generator is seeded, so runs are comparable.
+//
+// Build and run:
+//   c++ -O2 -std=c++17 -pthread benchmark_extraction.cpp -o benchmark_extraction
+//   ./benchmark_extraction [--scale S] [--threads N] [--max-output MB] [--keep] [directory...]
+//   ./benchmark_extraction --generate DIR [--scale S]
+// (add -liconv on macOS)
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "text_extractor.h"
+
+#if defined(_WIN32)
+#include <psapi.h>
+#if defined(_MSC_VER)
+#pragma comment(lib, "psapi.lib")
+#endif
+#else
+#include <sys/resource.h>
+#endif
+
+// Peak resident set size in bytes since the last reset_peak_rss()
+static size_t peak_rss() {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return counters.PeakWorkingSetSize;
+    }
+    return 0;
+#elif defined(__linux__)
+    // VmHWM can be reset, unlike ru_maxrss
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) {
+            return std::strtoull(line.c_str() + 6, nullptr, 10) * 1024;
+        }
+    }
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<size_t>(usage.ru_maxrss);   // Bytes on macOS
+#endif
+}
+
+// Start a new peak, so each stage reports its own. Only Linux can do this;
+// elsewhere the numbers are the peak of the whole run so far.
+static void reset_peak_rss() {
+#if defined(__linux__)
+    std::ofstream clear_refs("/proc/self/clear_refs");
+    clear_refs << "5";
+#endif
+}
+
+// ---- Synthetic corpus generator ----
+
+class CorpusGenerator {
+public:
+    CorpusGenerator(const fs::path& root, double scale) : root(root), scale(scale) {}
+
+    // Each corpus goes into its own subdirectory of root; returns their paths
+    std::vector<fs::path> generate_all() {
+        return {small_files(), huge_json(), xml_heavy(), shift_jis()};
+    }
+
+private:
+    fs::path root;
+    double scale;
+    std::mt19937 rng{20240611};
+
+    size_t scaled(size_t count) const {
+        return std::max<size_t>(1, static_cast<size_t>(count * scale));
+    }
+
+    size_t pick(size_t count) {
+        return std::uniform_int_distribution<size_t>(0, count - 1)(rng);
+    }
+
+    std::string sentence(size_t min_words, size_t max_words) {
+        static const char* const words[] = {
+            "the", "hero", "village", "sword", "ancient", "dragon", "quest", "gold", "merchant", "forest",
+            "castle", "magic", "shadow", "return", "before", "night", "falls", "you", "must", "find",
+            "key", "tower", "north", "guard", "thank", "traveler", "welcome", "danger", "ahead", "potion",
+        };
+        constexpr size_t word_count = sizeof(words) / sizeof(words[0]);
+        size_t length = min_words + pick(max_words - min_words + 1);
+        std::string text;
+        for (size_t i = 0; i < length; i++) {
+            if (i > 0) {
+                text += ' ';
+            }
+            text += words[pick(word_count)];
+        }
+        text[0] = static_cast<char>(std::toupper(static_cast<unsigned char>(text[0])));
+        return text + (pick(4) == 0 ? "!" : ".");
+    }
+
+    static void write_file(const fs::path& path, const std::string& contents) {
+        fs::create_directories(path.parent_path());
+        std::ofstream out(path, std::ios::binary);
+        out << contents;
+    }
+
+    // Script-like sources: a couple of KB each, spread over nested directories
+    fs::path small_files() {
+        fs::path dir = root / "small_files";
+        static const char* const extensions[] = {".lua", ".cs", ".txt", ".py"};
+        for (size_t f = 0; f < scaled(4000); f++) {
+            std::string out;
+            for (size_t line = 0; line < 40; line++) {
+                switch (pick(5)) {
+                    case 0: out += "    npc.say(\"" + sentence(3, 12) + "\")\n"; break;
+                    case 1: out += "    text = \"" + sentence(2, 8) + "\"\n"; break;
+                    case 2: out += "    label: '" + sentence(1, 4) + "'\n"; break;
+                    case 3: out += "    if counter >= 10 then counter = counter + 1 end\n"; break;
+                    default: out += "    -- " + sentence(4, 10) + "\n"; break;
+                }
+            }
+            fs::path path = dir / ("area" + std::to_string(f % 40)) / ("script" + std::to_string(f) + extensions[f % 4]);
+            write_file(path, out);
+        }
+        return dir;
+    }
+
+    // Minified dialogue tables: one line of several MB per file
+    fs::path huge_json() {
+        fs::path dir = root / "huge_json";
+        for (size_t f = 0; f < 3; f++) {
+            std::string out = "[";
+            for (size_t entry = 0; entry < scaled(60000); entry++) {
+                if (entry > 0) {
+                    out += ',';
+                }
+                out += "{\"id\":" + std::to_string(entry) + ",\"speaker\":\"npc_" + std::to_string(pick(50)) +
+                       "\",\"text\":\"" + sentence(4, 20) + "\",\"choices\":[\"" + sentence(1, 3) + "\",\"" +
+                       sentence(1, 3) + "\"]}";
+            }
+            out += "]";
+            write_file(dir / ("dialogue" + std::to_string(f) + ".json"), out);
+        }
+        return dir;
+    }
+
+    // UI layouts and string tables with text in elements and attributes
+    fs::path xml_heavy() {
+        fs::path dir = root / "xml_heavy";
+        for (size_t f = 0; f < scaled(400); f++) {
+            std::string out = "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n<strings>\n";
+            for (size_t entry = 0; entry < 150; entry++) {
+                out += "  <dialog id=\"d" + std::to_string(entry) + "\" title=\"" + sentence(1, 4) + "\">\n";
+                out += "    <text>" + sentence(3, 15) + "</text>\n";
+                out += "    <choice label=\"" + sentence(1, 3) + "\" next=\"d" + std::to_string(entry + 1) + "\"/>\n";
+                out += "  </dialog>\n";
+            }
+            out += "</strings>\n";
+            write_file(dir / ("menu" + std::to_string(f % 20)) / ("strings" + std::to_string(f) + ".xml"), out);
+        }
+        return dir;
+    }
+
+    // Japanese scripts and tables saved as Shift-JIS, as older games ship them
+    fs::path shift_jis() {
+        fs::path dir = root / "shift_jis";
+        static const char* const phrases[] = {
+            "こんにちは、旅の方。", "この先は危険です。", "ありがとうございました！", "村へようこそ。",
+            "剣を手に入れた。", "宿屋に泊まりますか？", "夜になる前に戻りなさい。", "北の塔に鍵がある。",
+        };
+        constexpr size_t phrase_count = sizeof(phrases) / sizeof(phrases[0]);
+        auto japanese = [&](size_t count) {
+            std::string text;
+            for (size_t i = 0; i < count; i++) {
+                text += phrases[pick(phrase_count)];
+            }
+            return text;
+        };
+        for (size_t f = 0; f < scaled(1000); f++) {
+            std::string utf8;
+            if (f % 2 == 0) {
+                for (size_t line = 0; line < 40; line++) {
+                    utf8 += "message: \"" + japanese(1 + pick(3)) + "\"\n";
+                }
+            } else {
+                utf8 = "id,speaker,text\n";
+                for (size_t line = 0; line < 40; line++) {
+                    utf8 += std::to_string(line) + ",npc_" + std::to_string(pick(20)) + ",\"" + japanese(1 + pick(3)) + "\"\n";
+                }
+            }
+            std::string encoded;
+            if (!text_encoding::encode(utf8, text_encoding::Encoding::ShiftJis, encoded)) {
+                encoded = utf8;
+            }
+            write_file(dir / ("scenario" + std::to_string(f % 10)) /
+                           ("event" + std::to_string(f) + (f % 2 == 0 ? ".txt" : ".csv")),
+                       encoded);
+        }
+        return dir;
+    }
+};
+
+// ---- Benchmark ----
+
+struct StageResult {
+    const char* name;
+    double seconds;
+    size_t files;
+    size_t bytes;
+    size_t chunks;
+    size_t peak_rss;
+};
+
+template <typename Function>
+static StageResult run_stage(const char* name, Function&& function) {
+    reset_peak_rss();
+    auto start = std::chrono::steady_clock::now();
+    StageResult result{name, 0, 0, 0, 0, 0};
+    function(result);
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.peak_rss = peak_rss();
+    return result;
+}
+
+// A rate column, or "-" for a count the stage does not have (e.g. bytes for scan)
+static std::string rate(double amount, double seconds, const char* unit, int width, int precision) {
+    char text[64];
+    if (amount == 0) {
+        std::snprintf(text, sizeof(text), "%*s %s", width, "-", unit);
+    } else {
+        std::snprintf(text, sizeof(text), "%*.*f %s", width, precision, amount / std::max(seconds, 1e-9), unit);
+    }
+    return text;
+}
+
+static void print_stage(const StageResult& stage) {
+    std::printf("  %-8s %9.3f s %s %s %s %8.1f MB peak RSS\n", stage.name, stage.seconds,
+                rate(static_cast<double>(stage.files), stage.seconds, "files/s", 9, 0).c_str(),
+                rate(stage.bytes / (1024.0 * 1024.0), stage.seconds, "MB/s", 8, 1).c_str(),
+                rate(static_cast<double>(stage.chunks), stage.seconds, "chunks/s", 10, 0).c_str(),
+                stage.peak_rss / (1024.0 * 1024.0));
+}
+
+// Rough size of what save_extracted_texts writes for `chunks`. The per-file
+// output repeats the whole source line of every text as its context, so for
+// huge single-line files it grows with texts times file size.
+static size_t estimated_output_bytes(const std::vector<TextExtractor::TextChunk>& chunks) {
+    size_t bytes = 0;
+    for (const auto& chunk : chunks) {
+        bytes += chunk.context().size() + chunk.original_text().size() + 2 * chunk.text.size() + 64;
+    }
+    return bytes;
+}
+
+static void benchmark_directory(const fs::path& directory, size_t threads, size_t max_output,
+                                const fs::path& output_dir) {
+    TextExtractor extractor;
+    extractor.set_num_threads(threads);
+
+    std::vector<std::string> files;
+    size_t input_bytes = 0;
+    std::vector<TextExtractor::TextChunk> chunks;
+
+    std::vector<StageResult> stages;
+    stages.push_back(run_stage("scan", [&](StageResult& stage) {
+        files = extractor.scan_directory(directory.string());
+        stage.files = files.size();
+    }));
+    for (const auto& file : files) {
+        std::error_code ec;
+        input_bytes += static_cast<size_t>(fs::file_size(file, ec));
+    }
+    stages.push_back(run_stage("extract", [&](StageResult& stage) {
+        extractor.extract_files_ordered(files, [&](size_t, std::vector<TextExtractor::TextChunk>& file_chunks) {
+            std::move(file_chunks.begin(), file_chunks.end(), std::back_inserter(chunks));
+            return true;
+        });
+        stage.files = files.size();
+        stage.bytes = input_bytes;
+        stage.chunks = chunks.size();
+    }));
+    stages.push_back(run_stage("split", [&](StageResult& stage) {
+        chunks = extractor.split_into_chunks(std::move(chunks));
+        stage.chunks = chunks.size();
+        for (const auto& chunk : chunks) {
+            stage.bytes += chunk.text.size();
+        }
+    }));
+    // Past max_output the writing stages would fill the disk rather than
+    // measure anything
+    const size_t output_bytes = estimated_output_bytes(chunks);
+    const bool write_output = output_bytes <= max_output;
+    if (write_output) {
+        stages.push_back(run_stage("save", [&](StageResult& stage) {
+            extractor.save_extracted_texts(chunks, output_dir.string());
+            std::error_code ec;
+            for (fs::recursive_directory_iterator it(output_dir, ec), end; it != end; it.increment(ec)) {
+                if (it->is_regular_file(ec)) {
+                    stage.files++;
+                    stage.bytes += static_cast<size_t>(it->file_size(ec));
+                }
+            }
+            stage.chunks = chunks.size();
+        }));
+    }
+    const size_t chunk_count = chunks.size();
+    std::vector<TextExtractor::TextChunk>().swap(chunks);
+
+    // Same output as extract + split + save, without holding the chunks
+    std::error_code ec;
+    fs::remove_all(output_dir, ec);
+    if (write_output) {
+        stages.push_back(run_stage("pipeline", [&](StageResult& stage) {
+            auto result = extractor.extract_to_directory(directory.string(), output_dir.string());
+            stage.files = result.total_files_processed;
+            stage.bytes = input_bytes;
+            stage.chunks = result.total_texts_found;
+        }));
+    }
+
+    std::printf("%s: %zu files, %.1f MB, %zu chunks\n", directory.filename().string().c_str(), files.size(),
+                input_bytes / (1024.0 * 1024.0), chunk_count);
+    for (const auto& stage : stages) {
+        print_stage(stage);
+    }
+    if (!write_output) {
+        std::printf("  save and pipeline skipped: about %.0f MB of output, over --max-output %zu MB\n",
+                    output_bytes / (1024.0 * 1024.0), max_output / (1024 * 1024));
+    }
+
+    fs::remove_all(output_dir, ec);
+}
+
+int main(int argc, char** argv) {
+    double scale = 1.0;
+    size_t threads = 0;
+    size_t max_output = size_t(2048) * 1024 * 1024;
+    bool keep = false;
+    std::string generate_dir;
+    std::vector<fs::path> directories;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--scale" && i + 1 < argc) {
+            scale = std::strtod(argv[++i], nullptr);
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threads = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--max-output" && i + 1 < argc) {
+            max_output = std::strtoull(argv[++i], nullptr, 10) * 1024 * 1024;
+        } else if (arg == "--generate" && i + 1 < argc) {
+            generate_dir = argv[++i];
+        } else if (arg == "--keep") {
+            keep = true;
+        } else if (!arg.empty() && arg[0] == '-') {
+            std::fprintf(stderr, "Usage: %s [--scale S] [--threads N] [--max-output MB] [--keep] [directory...]\n"
+                                 "       %s --generate DIR [--scale S]\n", argv[0], argv[0]);
+            return 1;
+        } else {
+            directories.push_back(arg);
+        }
+    }
+    if (!(scale > 0)) {
+        std::fprintf(stderr, "--scale must be positive\n");
+        return 1;
+    }
+
+    if (!generate_dir.empty()) {
+        for (const auto& corpus : CorpusGenerator(generate_dir, scale).generate_all()) {
+            std::printf("generated %s\n", corpus.string().c_str());
+        }
+        return 0;
+    }
+
+    fs::path work = fs::temp_directory_path() / ("gtx_benchmark_" + std::to_string(std::random_device{}()));
+    bool generated = directories.empty();
+    if (generated) {
+        auto start = std::chrono::steady_clock::now();
+        directories = CorpusGenerator(work / "corpus", scale).generate_all();
+        std::printf("generated corpora in %s (%.1f s)\n\n", (work / "corpus").string().c_str(),
+                    std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    for (const auto& directory : directories) {
+        benchmark_directory(directory, threads, max_output, work / "output");
+        std::printf("\n");
+    }
+
+    std::error_code ec;
+    if (generated && keep) {
+        std::printf("kept corpora in %s\n", (work / "corpus").string().c_str());
+    } else {
+        fs::remove_all(work, ec);
+    }
+    return 0;
+}
@@ -28,6 +28,20 @@ if errorlevel 1 (
     echo.
 )
 
+REM Build the benchmarks (optional, needs a C++ compiler on PATH)
+echo Building benchmarks...
+python setup.py build_benchmarks
+if errorlevel 1 (
+    echo Warning: Failed to build benchmarks
+)
+
+REM Build and run the engine tests
+echo Running tests...
+python setup.py test_native
+if errorlevel 1 (
+    echo Warning: Engine tests failed or could not be built
+)
+
 echo.
 echo Build complete!
 echo.
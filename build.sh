@@ -34,6 +34,35 @@ if [ $? -ne 0 ]; then
     echo
 fi
 
+# Build the micro-benchmarks (optional)
+echo "Building benchmarks..."
+${CXX:-c++} -O2 -std=c++17 benchmark_clean_text.cpp -o benchmark_clean_text
+if [ $? -ne 0 ]; then
+    echo "Warning: Failed to build benchmark_clean_text"
+fi
+${CXX:-c++} -O2 -std=c++17 benchmark_delimiter_scan.cpp -o benchmark_delimiter_scan
+if [ $? -ne 0 ]; then
+    echo "Warning: Failed to build benchmark_delimiter_scan"
+fi
+EXTRA_LIBS=""
+if [ "$(uname)" = "Darwin" ]; then
+    EXTRA_LIBS="-liconv"
+fi
+${CXX:-c++} -O2 -std=c++17 -pthread benchmark_extraction.cpp -o benchmark_extraction $EXTRA_LIBS
+if [ $? -ne 0 ]; then
+    echo "Warning: Failed to build benchmark_extraction"
+fi
+
+# Build and run the engine tests
+echo "Running tests..."
+${CXX:-c++} -O2 -std=c++17 -pthread test_extractor.cpp -o test_extractor $EXTRA_LIBS
+if [ $? -ne 0 ]; then
+    echo "Warning: Failed to build test_extractor"
+elif ! ./test_extractor; then
+    echo "Error: Engine tests failed"
+    exit 1
+fi
+
 echo
 echo "Build complete!"
 echo
@@ -0,0 +1,498 @@
+#pragma once
+
+#include <regex>
+
+#include "text_extractor.h"
+
+// Filtering of a ChunkStore as the user types: a substring or regular
+// expression over the texts, a substring of the file path, a line range and
+// untranslated-only. The index keeps the distinct texts, with ASCII letters
+// folded to lower case, in one contiguous buffer, and indexes them by
+// trigram: a substring of three or more bytes only verifies the texts whose
+// posting lists hold all of its trigrams, and a shorter one is found by
+// scanning the buffer. Regular expressions test every distinct text. The
+// file, line and untranslated filters are per chunk and are applied in the
+// pass that lists the matching chunks. Both passes run on the index's
+// thread pool.
+//
+// The index keeps views of the store's texts: the store must outlive it and
+// must not grow after it is built, which search() checks.
+class ChunkSearchIndex {
+public:
+    struct Query {
+        std::string text;              // Substring, or pattern if regex; empty matches every text
+        bool regex = false;
+        bool case_sensitive = false;   // Otherwise ASCII letters match either case
+        std::string file;              // Substring of the file path; empty matches every file
+        size_t first_line = 0;         // Inclusive line range, 0 = unbounded
+        size_t last_line = 0;
+        bool untranslated_only = false;
+    };
+
+    // Index the chunks of `store` on `threads` threads (0 = all cores), which
+    // searches use as well
+    explicit ChunkSearchIndex(const ChunkStore& store, size_t threads = 0)
+        : store(store), chunk_count(store.size()), text_table(store.size()) {
+        if (chunk_count > UINT32_MAX) {
+            throw std::length_error("too many chunks to index");
+        }
+        if (threads == 0) {
+            threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+        }
+        pool = std::make_unique<WorkStealingPool>(threads);
+        index_chunks();
+        fold_texts();
+        index_trigrams();
+        translated.reset(new std::atomic<uint8_t>[text_table.size()]());
+    }
+
+    ChunkSearchIndex(const ChunkSearchIndex&) = delete;
+    ChunkSearchIndex& operator=(const ChunkSearchIndex&) = delete;
+
+    // Indices of the chunks matching every part of `query`, ascending
+    std::vector<uint32_t> search(const Query& query) const {
+        std::lock_guard<std::mutex> lock(search_mutex);
+        if (store.size() != chunk_count) {
+            throw std::logic_error("the chunk store changed after its search index was built");
+        }
+        ChunkFilter filter = chunk_filter(query);
+        if (query.text.empty()) {
+            return filter_chunks(filter, nullptr);
+        }
+        return chunks_of(matching_texts(query), filter);
+    }
+
+    // Mark the chunks with this text as translated or not, for untranslated_only;
+    // false if no chunk has it
+    bool mark_translated(std::string_view text, bool value = true) {
+        uint32_t id = text_table.find(text);
+        if (id == StringInternTable::npos) {
+            return false;
+        }
+        translated[id].store(value, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Replace the translated marks: exactly the chunks with one of `texts`
+    void set_translated(const std::vector<std::string>& texts) {
+        for (size_t id = 0; id < text_table.size(); id++) {
+            translated[id].store(0, std::memory_order_relaxed);
+        }
+        for (const std::string& text : texts) {
+            mark_translated(text);
+        }
+    }
+
+    size_t get_chunk_count() const {
+        return chunk_count;
+    }
+
+    size_t get_text_count() const {
+        return text_table.size();
+    }
+
+    size_t get_file_count() const {
+        return files.size();
+    }
+
+private:
+    static constexpr uint32_t npos = UINT32_MAX;
+    // Work split: distinct texts and chunks per task
+    static constexpr size_t text_block = 4096;
+    static constexpr size_t chunk_block = 65536;
+
+    const ChunkStore& store;
+    size_t chunk_count;
+    std::unique_ptr<WorkStealingPool> pool;
+    mutable std::mutex search_mutex;
+
+    // Distinct texts, and per chunk its text, file and line
+    StringInternTable text_table;
+    std::vector<uint32_t> chunk_text;
+    std::vector<uint32_t> chunk_file;
+    std::vector<uint32_t> chunk_line;
+    std::vector<std::string_view> files;
+    // Chunks of text t: occurrence_chunks[occurrence_offsets[t] .. occurrence_offsets[t + 1])
+    std::vector<uint32_t> occurrence_offsets;
+    std::vector<uint32_t> occurrence_chunks;
+    // Folded text t: folded[folded_offsets[t] .. folded_offsets[t + 1] - 1), each followed by '\0'
+    std::string folded;
+    std::vector<uint64_t> folded_offsets;
+    // Texts with a trigram in bucket b, ascending:
+    // postings[bucket_offsets[b] .. bucket_offsets[b + 1])
+    unsigned bucket_bits = 12;
+    std::vector<uint32_t> bucket_offsets;
+    std::vector<uint32_t> postings;
+    std::unique_ptr<std::atomic<uint8_t>[]> translated;
+
+    struct ChunkFilter {
+        std::vector<uint8_t> file_ok;   // Empty: every file
+        size_t first_line = 0;
+        size_t last_line = 0;
+        bool untranslated_only = false;
+    };
+
+    void index_chunks() {
+        // Read and hash in parallel; interning is sequential
+        std::vector<std::string_view> texts(chunk_count);
+        std::vector<std::string_view> paths(chunk_count);
+        std::vector<uint64_t> hashes(chunk_count);
+        chunk_line.resize(chunk_count);
+        for_blocks(chunk_count, chunk_block, [&](size_t begin, size_t end, size_t) {
+            for (size_t i = begin; i < end; i++) {
+                texts[i] = store.text(i);
+                paths[i] = store.file_path(i);
+                hashes[i] = fnv1a_64(texts[i]);
+                chunk_line[i] = static_cast<uint32_t>(std::min<size_t>(store.line_number(i), UINT32_MAX));
+            }
+        });
+
+        chunk_text.resize(chunk_count);
+        chunk_file.resize(chunk_count);
+        std::unordered_map<std::string_view, uint32_t> file_ids;
+        uint32_t last_file = npos;
+        for (size_t i = 0; i < chunk_count; i++) {
+            chunk_text[i] = text_table.intern(texts[i], hashes[i]).first;
+            // Chunks of one file are usually adjacent
+            if (last_file == npos || paths[i] != files[last_file]) {
+                auto inserted = file_ids.emplace(paths[i], static_cast<uint32_t>(files.size()));
+                if (inserted.second) {
+                    files.push_back(paths[i]);
+                }
+                last_file = inserted.first->second;
+            }
+            chunk_file[i] = last_file;
+        }
+
+        size_t text_count = text_table.size();
+        occurrence_offsets.assign(text_count + 1, 0);
+        for (uint32_t text : chunk_text) {
+            occurrence_offsets[text + 1]++;
+        }
+        for (size_t t = 0; t < text_count; t++) {
+            occurrence_offsets[t + 1] += occurrence_offsets[t];
+        }
+        std::vector<uint32_t> cursor(occurrence_offsets.begin(), occurrence_offsets.end() - 1);
+        occurrence_chunks.resize(chunk_count);
+        for (size_t i = 0; i < chunk_count; i++) {
+            occurrence_chunks[cursor[chunk_text[i]]++] = static_cast<uint32_t>(i);
+        }
+    }
+
+    void fold_texts() {
+        size_t text_count = text_table.size();
+        folded_offsets.assign(text_count + 1, 0);
+        for (size_t t = 0; t < text_count; t++) {
+            folded_offsets[t + 1] = folded_offsets[t] + text_table.at(static_cast<uint32_t>(t)).size() + 1;
+        }
+        folded.assign(folded_offsets[text_count], '\0');
+        for_blocks(text_count, text_block, [&](size_t begin, size_t end, size_t) {
+            for (size_t t = begin; t < end; t++) {
+                std::string_view text = text_table.at(static_cast<uint32_t>(t));
+                char* out = &folded[folded_offsets[t]];
+                for (size_t i = 0; i < text.size(); i++) {
+                    out[i] = static_cast<char>(fold(text[i]));
+                }
+            }
+        });
+    }
+
+    std::string_view folded_text(uint32_t id) const {
+        return std::string_view(folded).substr(folded_offsets[id], folded_offsets[id + 1] - folded_offsets[id] - 1);
+    }
+
+    // Postings are written by counting: each task counts the trigrams of a
+    // contiguous range of texts, then writes them after the previous ranges'
+    // postings of the same bucket, so every list comes out sorted
+    void index_trigrams() {
+        size_t text_count = text_table.size();
+        // About one bucket per text, within 2^12 .. 2^20
+        while (bucket_bits < 20 && (size_t(1) << bucket_bits) < text_count) {
+            bucket_bits++;
+        }
+        size_t buckets = size_t(1) << bucket_bits;
+        size_t parts = std::max<size_t>(std::min(pool->size(), (text_count + text_block - 1) / text_block), 1);
+        auto part_begin = [&](size_t part) { return text_count * part / parts; };
+
+        std::vector<std::vector<uint32_t>> counts(parts);
+        for_blocks(parts, 1, [&](size_t part, size_t, size_t) {
+            counts[part].assign(buckets, 0);
+            std::vector<uint32_t> grams;
+            for (size_t id = part_begin(part); id < part_begin(part + 1); id++) {
+                for (uint32_t gram : text_grams(folded_text(static_cast<uint32_t>(id)), grams)) {
+                    counts[part][gram]++;
+                }
+            }
+        });
+
+        // Counts become each part's write cursors
+        bucket_offsets.assign(buckets + 1, 0);
+        uint64_t total = 0;
+        for (size_t b = 0; b < buckets; b++) {
+            bucket_offsets[b] = static_cast<uint32_t>(total);
+            for (size_t part = 0; part < parts; part++) {
+                uint32_t count = counts[part][b];
+                counts[part][b] = static_cast<uint32_t>(total);
+                total += count;
+            }
+            if (total > UINT32_MAX) {
+                throw std::length_error("too many trigrams to index");
+            }
+        }
+        bucket_offsets[buckets] = static_cast<uint32_t>(total);
+
+        postings.resize(total);
+        for_blocks(parts, 1, [&](size_t part, size_t, size_t) {
+            std::vector<uint32_t> grams;
+            for (size_t id = part_begin(part); id < part_begin(part + 1); id++) {
+                for (uint32_t gram : text_grams(folded_text(static_cast<uint32_t>(id)), grams)) {
+                    postings[counts[part][gram]++] = static_cast<uint32_t>(id);
+                }
+            }
+        });
+    }
+
+    static unsigned char fold(char c) {
+        unsigned char value = static_cast<unsigned char>(c);
+        return value >= 'A' && value <= 'Z' ? static_cast<unsigned char>(value + ('a' - 'A')) : value;
+    }
+
+    static std::string fold(std::string_view text) {
+        std::string result(text.size(), '\0');
+        for (size_t i = 0; i < text.size(); i++) {
+            result[i] = static_cast<char>(fold(text[i]));
+        }
+        return result;
+    }
+
+    // Distinct trigram buckets of folded `text`
+    const std::vector<uint32_t>& text_grams(std::string_view text, std::vector<uint32_t>& grams) const {
+        grams.clear();
+        for (size_t pos = 0; pos + 3 <= text.size(); pos++) {
+            uint32_t gram = uint32_t(static_cast<unsigned char>(text[pos])) << 16 |
+                            uint32_t(static_cast<unsigned char>(text[pos + 1])) << 8 |
+                            static_cast<unsigned char>(text[pos + 2]);
+            grams.push_back((gram * 0x9E3779B1u) >> (32 - bucket_bits));
+        }
+        std::sort(grams.begin(), grams.end());
+        grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+        return grams;
+    }
+
+    static bool contains_folded(std::string_view text, std::string_view needle) {
+        for (size_t pos = 0; pos + needle.size() <= text.size(); pos++) {
+            size_t matched = 0;
+            while (matched < needle.size() && fold(text[pos + matched]) == static_cast<unsigned char>(needle[matched])) {
+                matched++;
+            }
+            if (matched == needle.size()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::vector<uint32_t> matching_texts(const Query& query) const {
+        size_t text_count = text_table.size();
+        auto all_texts = [](size_t i) { return static_cast<uint32_t>(i); };
+        if (query.regex) {
+            auto flags = std::regex::ECMAScript | std::regex::optimize;
+            if (!query.case_sensitive) {
+                flags |= std::regex::icase;
+            }
+            std::regex pattern;
+            try {
+                pattern = std::regex(query.text, flags);
+            } catch (const std::regex_error& e) {
+                throw std::invalid_argument(std::string("invalid regular expression: ") + e.what());
+            }
+            return collect(text_count, text_block, all_texts, [&](uint32_t id) {
+                std::string_view text = text_table.at(id);
+                return std::regex_search(text.data(), text.data() + text.size(), pattern);
+            });
+        }
+
+        // Folded matches first; a case-sensitive query then checks the texts themselves
+        std::string needle = fold(query.text);
+        std::vector<uint32_t> texts;
+        if (needle.size() < 3) {
+            texts = scan_folded(needle);
+        } else {
+            std::vector<uint32_t> candidates = candidate_texts(needle);
+            texts = collect(candidates.size(), text_block, [&](size_t i) { return candidates[i]; }, [&](uint32_t id) {
+                return folded_text(id).find(needle) != std::string_view::npos;
+            });
+        }
+        if (!query.case_sensitive) {
+            return texts;
+        }
+        return collect(texts.size(), text_block, [&](size_t i) { return texts[i]; }, [&](uint32_t id) {
+            return text_table.at(id).find(query.text) != std::string_view::npos;
+        });
+    }
+
+    // Texts whose folded form contains `needle`, by searching the whole buffer
+    // a block of texts at a time
+    std::vector<uint32_t> scan_folded(const std::string& needle) const {
+        size_t text_count = text_table.size();
+        std::vector<std::vector<uint32_t>> found((text_count + text_block - 1) / text_block);
+        for_blocks(text_count, text_block, [&](size_t begin, size_t end, size_t index) {
+            std::string_view block(folded.data() + folded_offsets[begin], folded_offsets[end] - folded_offsets[begin]);
+            size_t pos = block.find(needle);
+            while (pos != std::string_view::npos) {
+                uint64_t offset = folded_offsets[begin] + pos;
+                // The text holding the match, then on to the next text
+                size_t id = std::upper_bound(folded_offsets.begin() + begin, folded_offsets.begin() + end + 1, offset) -
+                            folded_offsets.begin() - 1;
+                found[index].push_back(static_cast<uint32_t>(id));
+                pos = block.find(needle, folded_offsets[id + 1] - folded_offsets[begin]);
+            }
+        });
+        std::vector<uint32_t> result;
+        for (const auto& part : found) {
+            result.insert(result.end(), part.begin(), part.end());
+        }
+        return result;
+    }
+
+    // Texts holding every trigram bucket of `needle`: the shortest posting
+    // list, intersected with the others by galloping
+    std::vector<uint32_t> candidate_texts(std::string_view needle) const {
+        std::vector<uint32_t> grams;
+        text_grams(needle, grams);
+        std::sort(grams.begin(), grams.end(), [&](uint32_t a, uint32_t b) { return bucket_size(a) < bucket_size(b); });
+        const uint32_t* first = postings.data() + bucket_offsets[grams[0]];
+        std::vector<uint32_t> candidates(first, first + bucket_size(grams[0]));
+        for (size_t g = 1; g < grams.size() && !candidates.empty(); g++) {
+            const uint32_t* list = postings.data() + bucket_offsets[grams[g]];
+            size_t size = bucket_size(grams[g]);
+            size_t kept = 0;
+            size_t pos = 0;
+            for (uint32_t id : candidates) {
+                size_t step = 1;
+                while (pos + step < size && list[pos + step] < id) {
+                    step *= 2;
+                }
+                pos = std::lower_bound(list + pos, list + std::min(pos + step + 1, size), id) - list;
+                if (pos == size) {
+                    break;
+                }
+                if (list[pos] == id) {
+                    candidates[kept++] = id;
+                }
+            }
+            candidates.resize(kept);
+        }
+        return candidates;
+    }
+
+    size_t bucket_size(uint32_t bucket) const {
+        return bucket_offsets[bucket + 1] - bucket_offsets[bucket];
+    }
+
+    ChunkFilter chunk_filter(const Query& query) const {
+        ChunkFilter filter;
+        filter.first_line = query.first_line;
+        filter.last_line = query.last_line;
+        filter.untranslated_only = query.untranslated_only;
+        if (!query.file.empty()) {
+            std::string needle = query.case_sensitive ? query.file : fold(query.file);
+            filter.file_ok.resize(files.size());
+            for (size_t f = 0; f < files.size(); f++) {
+                filter.file_ok[f] = query.case_sensitive ? files[f].find(needle) != std::string_view::npos
+                                                         : contains_folded(files[f], needle);
+            }
+        }
+        return filter;
+    }
+
+    bool accepts(const ChunkFilter& filter, uint32_t chunk) const {
+        if (!filter.file_ok.empty() && !filter.file_ok[chunk_file[chunk]]) {
+            return false;
+        }
+        if (filter.first_line || filter.last_line) {
+            uint32_t line = chunk_line[chunk];
+            if (line < filter.first_line || (filter.last_line && line > filter.last_line)) {
+                return false;
+            }
+        }
+        return !filter.untranslated_only || !translated[chunk_text[chunk]].load(std::memory_order_relaxed);
+    }
+
+    // Chunks with one of the (ascending) texts that pass the filter
+    std::vector<uint32_t> chunks_of(const std::vector<uint32_t>& texts, const ChunkFilter& filter) const {
+        size_t occurrences = 0;
+        for (uint32_t text : texts) {
+            occurrences += occurrence_offsets[text + 1] - occurrence_offsets[text];
+        }
+        // Few chunks: gather and sort them; many: mark their texts and filter every chunk
+        if (occurrences * 16 < chunk_count) {
+            std::vector<uint32_t> result;
+            for (uint32_t text : texts) {
+                for (uint32_t o = occurrence_offsets[text]; o < occurrence_offsets[text + 1]; o++) {
+                    if (accepts(filter, occurrence_chunks[o])) {
+                        result.push_back(occurrence_chunks[o]);
+                    }
+                }
+            }
+            std::sort(result.begin(), result.end());
+            return result;
+        }
+        std::vector<uint8_t> matched(text_table.size(), 0);
+        for (uint32_t text : texts) {
+            matched[text] = 1;
+        }
+        return filter_chunks(filter, &matched);
+    }
+
+    std::vector<uint32_t> filter_chunks(const ChunkFilter& filter, const std::vector<uint8_t>* matched_texts) const {
+        return collect(chunk_count, chunk_block, [](size_t i) { return static_cast<uint32_t>(i); }, [&](uint32_t chunk) {
+            return (!matched_texts || (*matched_texts)[chunk_text[chunk]]) && accepts(filter, chunk);
+        });
+    }
+
+    // The ids value(0) .. value(count - 1) that pass `test`, in order, tested in blocks
+    template <typename Value, typename Test>
+    std::vector<uint32_t> collect(size_t count, size_t block, Value value, Test test) const {
+        std::vector<std::vector<uint32_t>> found((count + block - 1) / block);
+        for_blocks(count, block, [&](size_t begin, size_t end, size_t index) {
+            // Write every id and keep it by advancing: no branch on the test
+            std::vector<uint32_t>& kept = found[index];
+            kept.resize(end - begin);
+            size_t size = 0;
+            for (size_t i = begin; i < end; i++) {
+                uint32_t id = value(i);
+                kept[size] = id;
+                size += test(id);
+            }
+            kept.resize(size);
+        });
+        size_t total = 0;
+        for (const auto& part : found) {
+            total += part.size();
+        }
+        std::vector<uint32_t> result;
+        result.reserve(total);
+        for (const auto& part : found) {
+            result.insert(result.end(), part.begin(), part.end());
+        }
+        return result;
+    }
+
+    // body(begin, end, block index) over [0, count) in blocks, on the pool
+    // unless a single block covers it
+    template <typename Body>
+    void for_blocks(size_t count, size_t block, Body body) const {
+        size_t blocks = (count + block - 1) / block;
+        if (blocks <= 1) {
+            if (count) {
+                body(0, count, 0);
+            }
+            return;
+        }
+        for (size_t b = 0; b < blocks; b++) {
+            pool->submit([&body, b, block, count] { body(b * block, std::min(count, (b + 1) * block), b); });
+        }
+        pool->wait();
+    }
+};
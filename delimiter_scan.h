@@ -0,0 +1,232 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define DELIMITER_SCAN_X86 1
+#define DELIMITER_SCAN_TARGET_AVX2 __attribute__((target("avx2")))
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <immintrin.h>
+#include <intrin.h>
+#define DELIMITER_SCAN_X86 1
+#define DELIMITER_SCAN_TARGET_AVX2
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+#include <arm_neon.h>
+#define DELIMITER_SCAN_NEON 1
+#endif
+
+// Vectorized search for the bytes the literal scanner reacts to, so the
+// bytes between string literals are skipped a block at a time instead of
+// being looked at one by one. The instruction set is picked at runtime:
+// AVX2 (64 bytes per step) when the CPU has it, else SSE2 (16 bytes, the
+// x86-64 baseline), NEON on ARM, and a scalar loop everywhere else.
+// Kept free of pybind11 like text_unescape.h.
+
+namespace delimiter_scan {
+
+enum class Level { Scalar, Sse2, Avx2, Neon };
+
+inline const char* level_name(Level level) {
+    switch (level) {
+        case Level::Scalar: return "scalar";
+        case Level::Sse2: return "sse2";
+        case Level::Avx2: return "avx2";
+        case Level::Neon: return "neon";
+    }
+    return "scalar";
+}
+
+inline Level detect_level() {
+#if defined(DELIMITER_SCAN_X86)
+#if defined(_MSC_VER) && !defined(__clang__)
+    // AVX2 needs the CPU feature and OS support for the YMM registers
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] >= 7) {
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        bool avx = (info[2] & (1 << 28)) != 0;
+        if (osxsave && avx && (_xgetbv(0) & 0x6) == 0x6) {
+            __cpuidex(info, 7, 0);
+            if (info[1] & (1 << 5)) {
+                return Level::Avx2;
+            }
+        }
+    }
+#else
+    if (__builtin_cpu_supports("avx2")) {
+        return Level::Avx2;
+    }
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    return Level::Sse2;
+#else
+    return Level::Scalar;
+#endif
+#elif defined(DELIMITER_SCAN_NEON)
+    return Level::Neon;
+#else
+    return Level::Scalar;
+#endif
+}
+
+// Best level of this CPU, capped by set_max_level()
+inline std::atomic<Level>& active_level_storage() {
+    static std::atomic<Level> level{detect_level()};
+    return level;
+}
+
+inline Level active_level() {
+    return active_level_storage().load(std::memory_order_relaxed);
+}
+
+// Cap the level, e.g. Level::Scalar to compare against the plain loop.
+// Not meant to be changed while other threads are scanning.
+inline void set_max_level(Level level) {
+    Level best = detect_level();
+    if (level == Level::Scalar || (level == Level::Sse2 && best == Level::Avx2)) {
+        best = level;
+    }
+    active_level_storage().store(best, std::memory_order_relaxed);
+}
+
+inline unsigned count_trailing_zeros(uint64_t mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanForward64(&index, mask);
+    return static_cast<unsigned>(index);
+#else
+    return static_cast<unsigned>(__builtin_ctzll(mask));
+#endif
+}
+
+template <size_t N>
+using Needles = std::array<char, N>;
+
+template <size_t N>
+inline size_t find_scalar(const char* data, size_t size, size_t pos, const Needles<N>& needles) {
+    for (; pos < size; pos++) {
+        for (char needle : needles) {
+            if (data[pos] == needle) {
+                return pos;
+            }
+        }
+    }
+    return size;
+}
+
+#if defined(DELIMITER_SCAN_X86)
+template <size_t N>
+inline size_t find_sse2(const char* data, size_t size, size_t pos, const Needles<N>& needles) {
+    __m128i splat[N];
+    for (size_t n = 0; n < N; n++) {
+        splat[n] = _mm_set1_epi8(needles[n]);
+    }
+    for (; pos + 16 <= size; pos += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+        __m128i hits = _mm_cmpeq_epi8(block, splat[0]);
+        for (size_t n = 1; n < N; n++) {
+            hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, splat[n]));
+        }
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(hits));
+        if (mask != 0) {
+            return pos + count_trailing_zeros(mask);
+        }
+    }
+    return find_scalar(data, size, pos, needles);
+}
+
+template <size_t N>
+DELIMITER_SCAN_TARGET_AVX2 inline size_t find_avx2(const char* data, size_t size, size_t pos,
+                                                   const Needles<N>& needles) {
+    __m256i splat[N];
+    for (size_t n = 0; n < N; n++) {
+        splat[n] = _mm256_set1_epi8(needles[n]);
+    }
+    // Two 32-byte blocks per step, combined into one 64-bit mask
+    for (; pos + 64 <= size; pos += 64) {
+        __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+        __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos + 32));
+        __m256i low_hits = _mm256_cmpeq_epi8(low, splat[0]);
+        __m256i high_hits = _mm256_cmpeq_epi8(high, splat[0]);
+        for (size_t n = 1; n < N; n++) {
+            low_hits = _mm256_or_si256(low_hits, _mm256_cmpeq_epi8(low, splat[n]));
+            high_hits = _mm256_or_si256(high_hits, _mm256_cmpeq_epi8(high, splat[n]));
+        }
+        uint64_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(low_hits)) |
+                        (static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(high_hits))) << 32);
+        if (mask != 0) {
+            return pos + count_trailing_zeros(mask);
+        }
+    }
+    for (; pos + 32 <= size; pos += 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+        __m256i hits = _mm256_cmpeq_epi8(block, splat[0]);
+        for (size_t n = 1; n < N; n++) {
+            hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(block, splat[n]));
+        }
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(hits));
+        if (mask != 0) {
+            return pos + count_trailing_zeros(mask);
+        }
+    }
+    return find_scalar(data, size, pos, needles);
+}
+#endif
+
+#if defined(DELIMITER_SCAN_NEON)
+template <size_t N>
+inline size_t find_neon(const char* data, size_t size, size_t pos, const Needles<N>& needles) {
+    uint8x16_t splat[N];
+    for (size_t n = 0; n < N; n++) {
+        splat[n] = vdupq_n_u8(static_cast<uint8_t>(needles[n]));
+    }
+    for (; pos + 16 <= size; pos += 16) {
+        uint8x16_t block = vld1q_u8(reinterpret_cast<const uint8_t*>(data + pos));
+        uint8x16_t hits = vceqq_u8(block, splat[0]);
+        for (size_t n = 1; n < N; n++) {
+            hits = vorrq_u8(hits, vceqq_u8(block, splat[n]));
+        }
+        // Narrow each byte to 4 bits to get a 64-bit mask
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(hits), 4)), 0);
+        if (mask != 0) {
+            return pos + count_trailing_zeros(mask) / 4;
+        }
+    }
+    return find_scalar(data, size, pos, needles);
+}
+#endif
+
+// Position of the first byte at or after `pos` that is one of `needles`,
+// or `size` if there is none
+template <size_t N>
+inline size_t find_first_of(const char* data, size_t size, size_t pos, const Needles<N>& needles) {
+    switch (active_level()) {
+#if defined(DELIMITER_SCAN_X86)
+        case Level::Avx2: {
+            // Delimiters are often only a few bytes apart, so look at one
+            // 16-byte block inline before paying for the AVX2 call
+            size_t head_end = pos + 16 <= size ? pos + 16 : size;
+            size_t found = find_sse2(data, head_end, pos, needles);
+            return found < head_end ? found : find_avx2(data, size, head_end, needles);
+        }
+        case Level::Sse2: return find_sse2(data, size, pos, needles);
+#endif
+#if defined(DELIMITER_SCAN_NEON)
+        case Level::Neon: return find_neon(data, size, pos, needles);
+#endif
+        default: return find_scalar(data, size, pos, needles);
+    }
+}
+
+template <size_t N>
+inline size_t find_first_of(std::string_view text, size_t pos, const Needles<N>& needles) {
+    return find_first_of(text.data(), text.size(), pos, needles);
+}
+
+}  // namespace delimiter_scan
@@ -0,0 +1,967 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "delimiter_scan.h"
+#include "text_unescape.h"
+
+// Format-aware extractors. Instead of running the generic text patterns over
+// every line, a file of a known format is tokenized and only the fields that
+// hold texts are reported: JSON string values (not keys), XML text nodes and
+// text attributes, CSV fields below the header row, YAML scalar values, and
+// the text fields of Unity scene/prefab/asset files.
+//
+// Every format also decodes a reported span into its text and encodes a
+// translation back, since each one escapes characters differently.
+// Kept free of pybind11 like text_unescape.h.
+
+namespace format_extract {
+
+// A text found in the scanned file: the text itself (group) and the whole
+// token it was found in (match), as byte ranges of the scanned text
+struct Span {
+    size_t group_start;
+    size_t group_end;
+    size_t match_start;
+    size_t match_end;
+};
+
+inline bool is_space(char ch) {
+    return text_unescape::is_space(static_cast<unsigned char>(ch));
+}
+
+// Remove whitespace around `text`
+inline std::string_view trim(std::string_view text) {
+    size_t begin = 0;
+    size_t end = text.size();
+    while (begin < end && is_space(text[begin])) {
+        begin++;
+    }
+    while (end > begin && is_space(text[end - 1])) {
+        end--;
+    }
+    return text.substr(begin, end - begin);
+}
+
+// Quote character around [begin, end) of `line`, or 0 if the span is not quoted
+inline char enclosing_quote(std::string_view line, size_t begin, size_t end) {
+    if (begin > 0 && end < line.size()) {
+        char before = line[begin - 1];
+        if ((before == '"' || before == '\'') && line[end] == before) {
+            return before;
+        }
+    }
+    return 0;
+}
+
+// Reject values a format stores in text fields that are not meant to be
+// read: numbers, GUIDs, hex colors, file paths and identifiers
+inline bool looks_like_text(std::string_view text) {
+    bool has_letter = false;
+    bool has_space = false;
+    bool has_separator = false;   // '/', '\' or '_', as in paths and identifiers
+    bool has_digit = false;
+    bool hex_only = true;
+    size_t hex_digits = 0;
+    for (char ch : text) {
+        unsigned char byte = static_cast<unsigned char>(ch);
+        if (byte >= 0x80 || (byte >= 'a' && byte <= 'z') || (byte >= 'A' && byte <= 'Z')) {
+            has_letter = true;
+        }
+        if (is_space(ch)) {
+            has_space = true;
+        } else if (ch == '/' || ch == '\\' || ch == '_') {
+            has_separator = true;
+        }
+        if (byte >= '0' && byte <= '9') {
+            has_digit = true;
+        }
+        if (text_unescape::hex_value(ch) >= 0) {
+            hex_digits++;
+        } else if (ch != '-' && ch != '#') {
+            hex_only = false;
+        }
+    }
+    if (!has_letter || has_space) {
+        return has_letter;
+    }
+    return !has_separator && !(hex_only && has_digit && hex_digits >= 6);
+}
+
+// Decodes a reported span into its text and encodes a translation to write
+// back over it. `line` is the source line holding the span [begin, end).
+// The default handles the generic text patterns: backslash escapes, with the
+// enclosing quote character escaped when the span is quoted.
+class TextCodec {
+public:
+    virtual ~TextCodec() = default;
+
+    virtual void decode(std::string_view line, size_t begin, size_t end, std::string& out) const {
+        text_unescape::unescape(line.substr(begin, end - begin), out);
+    }
+
+    virtual void encode(std::string_view text, std::string_view line, size_t begin, size_t end,
+                        std::string& out) const {
+        text_unescape::escape(text, enclosing_quote(line, begin, end), out);
+    }
+};
+
+class FormatExtractor : public TextCodec {
+public:
+    // Name used by TextExtractor::set_format_extractor ("json", "xml", ...)
+    virtual const char* name() const = 0;
+
+    // Append the spans of every text in `data` (UTF-8), in file order
+    virtual void extract(std::string_view data, std::vector<Span>& spans) const = 0;
+};
+
+// Skip a string that opens at `open`, honouring backslash escapes. Returns
+// the position of the closing quote, or npos if the line ends first.
+inline size_t backslash_string_end(std::string_view data, size_t open, char quote) {
+    const delimiter_scan::Needles<3> stops = {quote, '\\', '\n'};
+    size_t pos = delimiter_scan::find_first_of(data, open + 1, stops);
+    while (pos < data.size()) {
+        if (data[pos] == quote) {
+            return pos;
+        }
+        if (data[pos] == '\n' || pos + 1 >= data.size() || data[pos + 1] == '\n') {
+            return std::string_view::npos;
+        }
+        pos = delimiter_scan::find_first_of(data, pos + 2, stops);
+    }
+    return std::string_view::npos;
+}
+
+// Skip a string where the quote is escaped by doubling it (CSV, YAML single
+// quotes). Returns the position of the closing quote, or npos if the scan
+// reaches a newline first and `single_line` is set, or the end of the data.
+inline size_t doubled_quote_string_end(std::string_view data, size_t open, char quote, bool single_line) {
+    const delimiter_scan::Needles<2> stops = {quote, '\n'};
+    size_t pos = delimiter_scan::find_first_of(data, open + 1, stops);
+    while (pos < data.size()) {
+        if (data[pos] == '\n') {
+            if (single_line) {
+                return std::string_view::npos;
+            }
+        } else if (pos + 1 < data.size() && data[pos + 1] == quote) {
+            pos++;
+        } else {
+            return pos;
+        }
+        pos = delimiter_scan::find_first_of(data, pos + 1, stops);
+    }
+    return std::string_view::npos;
+}
+
+// Copy `text` with each doubled `quote` replaced by a single one, trimmed
+inline void undouble_quotes(std::string_view text, char quote, std::string& out) {
+    text = trim(text);
+    out.clear();
+    for (size_t i = 0; i < text.size(); i++) {
+        out.push_back(text[i]);
+        if (text[i] == quote && i + 1 < text.size() && text[i + 1] == quote) {
+            i++;
+        }
+    }
+}
+
+inline void double_quotes(std::string_view text, char quote, std::string& out) {
+    out.clear();
+    for (char ch : text) {
+        if (ch == quote) {
+            out.push_back(quote);
+        }
+        out.push_back(ch);
+    }
+}
+
+// JSON (and JSON with // and /* */ comments): every string value, no keys
+class JsonExtractor : public FormatExtractor {
+public:
+    const char* name() const override {
+        return "json";
+    }
+
+    void extract(std::string_view data, std::vector<Span>& spans) const override {
+        static constexpr delimiter_scan::Needles<2> tokens = {'"', '/'};
+        size_t pos = delimiter_scan::find_first_of(data, 0, tokens);
+        while (pos < data.size()) {
+            if (data[pos] == '/') {
+                pos = skip_comment(data, pos);
+            } else {
+                size_t close = backslash_string_end(data, pos, '"');
+                if (close == std::string_view::npos) {
+                    pos++;
+                } else {
+                    // A string followed by ':' is an object key
+                    size_t next = close + 1;
+                    while (next < data.size() && is_space(data[next])) {
+                        next++;
+                    }
+                    if (next >= data.size() || data[next] != ':') {
+                        spans.push_back({pos + 1, close, pos, close + 1});
+                    }
+                    pos = close + 1;
+                }
+            }
+            pos = delimiter_scan::find_first_of(data, pos, tokens);
+        }
+    }
+
+private:
+    // Position after the comment starting at `pos`, or pos + 1 for a lone '/'
+    static size_t skip_comment(std::string_view data, size_t pos) {
+        if (pos + 1 < data.size() && data[pos + 1] == '/') {
+            size_t end = data.find('\n', pos);
+            return end == std::string_view::npos ? data.size() : end;
+        }
+        if (pos + 1 < data.size() && data[pos + 1] == '*') {
+            size_t end = data.find("*/", pos + 2);
+            return end == std::string_view::npos ? data.size() : end + 2;
+        }
+        return pos + 1;
+    }
+};
+
+// XML: text nodes (one span per line of a node), single-line CDATA sections
+// and the values of text attributes such as text="..." and title="..."
+class XmlExtractor : public FormatExtractor {
+public:
+    const char* name() const override {
+        return "xml";
+    }
+
+    void extract(std::string_view data, std::vector<Span>& spans) const override {
+        size_t pos = 0;
+        while (pos < data.size()) {
+            size_t open = data.find('<', pos);
+            size_t text_end = open == std::string_view::npos ? data.size() : open;
+            add_text_lines(data, pos, text_end, spans);
+            if (open == std::string_view::npos) {
+                break;
+            }
+
+            std::string_view rest = data.substr(open);
+            if (starts_with(rest, "<!--")) {
+                pos = skip_past(data, open + 4, "-->");
+            } else if (starts_with(rest, "<![CDATA[")) {
+                size_t content = open + 9;
+                size_t close = data.find("]]>", content);
+                if (close == std::string_view::npos) {
+                    break;
+                }
+                if (data.find('\n', content) > close) {
+                    add_trimmed(data, content, close, open, close + 3, spans);
+                }
+                pos = close + 3;
+            } else if (starts_with(rest, "<?")) {
+                pos = skip_past(data, open + 2, "?>");
+            } else if (starts_with(rest, "<!") || starts_with(rest, "</")) {
+                pos = skip_past(data, open + 2, ">");
+            } else {
+                pos = parse_start_tag(data, open + 1, spans);
+            }
+        }
+    }
+
+    void decode(std::string_view line, size_t begin, size_t end, std::string& out) const override {
+        if (is_cdata(line, begin)) {
+            out.assign(trim(line.substr(begin, end - begin)));
+            return;
+        }
+        decode_entities(trim(line.substr(begin, end - begin)), out);
+    }
+
+    void encode(std::string_view text, std::string_view line, size_t begin, size_t end,
+                std::string& out) const override {
+        out.clear();
+        if (is_cdata(line, begin)) {
+            // "]]>" cannot appear in CDATA; close and reopen the section around it
+            for (size_t i = 0; i < text.size(); i++) {
+                if (text.compare(i, 3, "]]>") == 0) {
+                    out += "]]]]><![CDATA[>";
+                    i += 2;
+                } else {
+                    out.push_back(text[i]);
+                }
+            }
+            return;
+        }
+        char quote = enclosing_quote(line, begin, end);
+        for (char ch : text) {
+            switch (ch) {
+                case '&': out += "&amp;"; break;
+                case '<': out += "&lt;"; break;
+                case '>': out += "&gt;"; break;
+                case '"': out += quote == '"' ? "&quot;" : "\""; break;
+                case '\'': out += quote == '\'' ? "&apos;" : "'"; break;
+                case '\n': out += quote ? "&#10;" : "\n"; break;
+                default: out.push_back(ch); break;
+            }
+        }
+    }
+
+private:
+    // Attributes whose values are texts; other attributes hold ids and paths
+    static constexpr std::string_view text_attributes[] = {
+        "text", "label", "message", "title", "description", "content",
+        "caption", "tooltip", "hint", "placeholder"
+    };
+
+    static bool starts_with(std::string_view text, std::string_view prefix) {
+        return text.compare(0, prefix.size(), prefix) == 0;
+    }
+
+    static bool is_cdata(std::string_view line, size_t begin) {
+        std::string_view prefix = line.substr(0, begin);
+        size_t open = prefix.rfind("<![CDATA[");
+        return open != std::string_view::npos && trim(prefix.substr(open + 9)).empty();
+    }
+
+    static size_t skip_past(std::string_view data, size_t pos, std::string_view terminator) {
+        size_t end = data.find(terminator, pos);
+        return end == std::string_view::npos ? data.size() : end + terminator.size();
+    }
+
+    static void add_trimmed(std::string_view data, size_t begin, size_t end,
+                            size_t match_start, size_t match_end, std::vector<Span>& spans) {
+        while (begin < end && is_space(data[begin])) {
+            begin++;
+        }
+        while (end > begin && is_space(data[end - 1])) {
+            end--;
+        }
+        if (begin < end) {
+            spans.push_back({begin, end, match_start == std::string_view::npos ? begin : match_start,
+                             match_end == std::string_view::npos ? end : match_end});
+        }
+    }
+
+    // Each line of a text node is reported on its own
+    static void add_text_lines(std::string_view data, size_t begin, size_t end, std::vector<Span>& spans) {
+        while (begin < end) {
+            size_t newline = data.find('\n', begin);
+            size_t line_end = newline == std::string_view::npos || newline > end ? end : newline;
+            add_trimmed(data, begin, line_end, std::string_view::npos, std::string_view::npos, spans);
+            begin = line_end + 1;
+        }
+    }
+
+    static bool is_name_char(char ch) {
+        return !is_space(ch) && ch != '=' && ch != '>' && ch != '/' && ch != '"' && ch != '\'';
+    }
+
+    // Parse the attributes of a start tag; returns the position after its '>'
+    static size_t parse_start_tag(std::string_view data, size_t pos, std::vector<Span>& spans) {
+        while (pos < data.size() && is_name_char(data[pos])) {
+            pos++;
+        }
+        while (pos < data.size()) {
+            char ch = data[pos];
+            if (ch == '>') {
+                return pos + 1;
+            }
+            if (is_space(ch) || ch == '/') {
+                pos++;
+                continue;
+            }
+
+            size_t name_start = pos;
+            while (pos < data.size() && is_name_char(data[pos])) {
+                pos++;
+            }
+            std::string_view name = data.substr(name_start, pos - name_start);
+            while (pos < data.size() && is_space(data[pos])) {
+                pos++;
+            }
+            if (pos >= data.size() || data[pos] != '=') {
+                if (pos == name_start) {
+                    pos++;   // Stray quote or '='
+                }
+                continue;
+            }
+            pos++;
+            while (pos < data.size() && is_space(data[pos])) {
+                pos++;
+            }
+            if (pos >= data.size() || (data[pos] != '"' && data[pos] != '\'')) {
+                continue;
+            }
+            size_t close = data.find(data[pos], pos + 1);
+            if (close == std::string_view::npos) {
+                return data.size();
+            }
+            if (is_text_attribute(name)) {
+                add_trimmed(data, pos + 1, close, name_start, close + 1, spans);
+            }
+            pos = close + 1;
+        }
+        return data.size();
+    }
+
+    static bool is_text_attribute(std::string_view name) {
+        for (std::string_view attribute : text_attributes) {
+            if (name == attribute) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Decode the predefined entities and character references, copying any
+    // other '&' through unchanged
+    static void decode_entities(std::string_view text, std::string& out) {
+        static constexpr std::pair<std::string_view, char> entities[] = {
+            {"lt;", '<'}, {"gt;", '>'}, {"amp;", '&'}, {"quot;", '"'}, {"apos;", '\''}
+        };
+        out.clear();
+        size_t pos = 0;
+        while (pos < text.size()) {
+            size_t amp = text.find('&', pos);
+            if (amp == std::string_view::npos) {
+                out.append(text.substr(pos));
+                break;
+            }
+            out.append(text.substr(pos, amp - pos));
+            pos = amp + 1;
+
+            bool decoded = false;
+            for (const auto& entity : entities) {
+                if (text.compare(pos, entity.first.size(), entity.first) == 0) {
+                    out.push_back(entity.second);
+                    pos += entity.first.size();
+                    decoded = true;
+                    break;
+                }
+            }
+            if (!decoded && pos < text.size() && text[pos] == '#') {
+                bool hex = pos + 1 < text.size() && (text[pos + 1] == 'x' || text[pos + 1] == 'X');
+                size_t digits = pos + (hex ? 2 : 1);
+                uint32_t cp = 0;
+                size_t end = digits;
+                while (end < text.size() && end - digits < 8) {
+                    int digit = hex ? text_unescape::hex_value(text[end])
+                                    : (text[end] >= '0' && text[end] <= '9' ? text[end] - '0' : -1);
+                    if (digit < 0) {
+                        break;
+                    }
+                    cp = cp * (hex ? 16 : 10) + static_cast<uint32_t>(digit);
+                    end++;
+                }
+                if (end > digits && end < text.size() && text[end] == ';' && cp <= 0x10FFFF &&
+                    !(cp >= 0xD800 && cp <= 0xDFFF)) {
+                    text_unescape::append_utf8(out, cp);
+                    pos = end + 1;
+                    decoded = true;
+                }
+            }
+            if (!decoded) {
+                out.push_back('&');
+            }
+        }
+    }
+};
+
+// CSV: every field of every record after the header row, except columns
+// headed "id" or "key". The delimiter (',', ';' or tab) is taken from the
+// header row.
+class CsvExtractor : public FormatExtractor {
+public:
+    const char* name() const override {
+        return "csv";
+    }
+
+    void extract(std::string_view data, std::vector<Span>& spans) const override {
+        const char delimiter = detect_delimiter(data);
+        const delimiter_scan::Needles<2> field_end = {delimiter, '\n'};
+        std::vector<bool> id_columns;
+        size_t record = 0;
+        size_t column = 0;
+        size_t pos = 0;
+        while (pos < data.size()) {
+            size_t field_start = pos;
+            size_t stop;
+            bool wanted = record > 0 && (column >= id_columns.size() || !id_columns[column]);
+            if (data[pos] == '"') {
+                // Quoted fields may span lines; only single-line ones are reported
+                size_t close = doubled_quote_string_end(data, pos, '"', false);
+                if (close == std::string_view::npos) {
+                    break;
+                }
+                if (wanted && data.find('\n', pos) > close) {
+                    add_field(data, pos + 1, close, pos, close + 1, spans);
+                }
+                if (record == 0) {
+                    id_columns.push_back(is_id_header(data.substr(pos + 1, close - pos - 1)));
+                }
+                stop = delimiter_scan::find_first_of(data, close + 1, field_end);
+            } else {
+                stop = delimiter_scan::find_first_of(data, pos, field_end);
+                if (wanted) {
+                    add_field(data, field_start, stop, field_start, stop, spans);
+                }
+                if (record == 0) {
+                    id_columns.push_back(is_id_header(data.substr(field_start, stop - field_start)));
+                }
+            }
+            column++;
+            if (stop < data.size() && data[stop] == '\n') {
+                record++;
+                column = 0;
+            }
+            pos = stop + 1;
+        }
+    }
+
+    void decode(std::string_view line, size_t begin, size_t end, std::string& out) const override {
+        if (enclosing_quote(line, begin, end) == '"') {
+            undouble_quotes(line.substr(begin, end - begin), '"', out);
+        } else {
+            out.assign(trim(line.substr(begin, end - begin)));
+        }
+    }
+
+    void encode(std::string_view text, std::string_view line, size_t begin, size_t end,
+                std::string& out) const override {
+        if (enclosing_quote(line, begin, end) == '"') {
+            double_quotes(text, '"', out);
+            return;
+        }
+        // An unquoted field gets quotes once it holds anything special
+        if (text.find_first_of(",;\t\"\r\n") == std::string_view::npos) {
+            out.assign(text);
+            return;
+        }
+        double_quotes(text, '"', out);
+        out.insert(out.begin(), '"');
+        out.push_back('"');
+    }
+
+private:
+    static char detect_delimiter(std::string_view data) {
+        std::string_view header = data.substr(0, data.find('\n'));
+        size_t commas = 0;
+        size_t semicolons = 0;
+        size_t tabs = 0;
+        bool quoted = false;
+        for (char ch : header) {
+            if (ch == '"') {
+                quoted = !quoted;
+            } else if (!quoted) {
+                commas += ch == ',';
+                semicolons += ch == ';';
+                tabs += ch == '\t';
+            }
+        }
+        if (tabs > commas && tabs >= semicolons) {
+            return '\t';
+        }
+        return semicolons > commas ? ';' : ',';
+    }
+
+    static bool is_id_header(std::string_view name) {
+        name = trim(name);
+        if (name.size() != 2 && name.size() != 3) {
+            return false;
+        }
+        std::string lower(name);
+        std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char ch) {
+            return static_cast<char>(ch >= 'A' && ch <= 'Z' ? ch - 'A' + 'a' : ch);
+        });
+        return lower == "id" || lower == "key";
+    }
+
+    static void add_field(std::string_view data, size_t begin, size_t end,
+                          size_t match_start, size_t match_end, std::vector<Span>& spans) {
+        bool quoted = match_start != begin;
+        while (begin < end && is_space(data[begin])) {
+            begin++;
+        }
+        while (end > begin && is_space(data[end - 1])) {
+            end--;
+        }
+        if (begin < end) {
+            spans.push_back({quoted ? match_start + 1 : begin, quoted ? match_end - 1 : end,
+                             quoted ? match_start : begin, quoted ? match_end : end});
+        }
+    }
+};
+
+// YAML: values of block mappings and sequences, in plain, single- and
+// double-quoted style, plus quoted items of one-line flow collections.
+// Keys, block scalars (| and >) and scalars continued on further lines are
+// not reported.
+class YamlExtractor : public FormatExtractor {
+public:
+    const char* name() const override {
+        return "yaml";
+    }
+
+    void extract(std::string_view data, std::vector<Span>& spans) const override {
+        // Lines indented deeper than this belong to a skipped multi-line value
+        size_t skip_indent = std::string_view::npos;
+        // Span of the last plain value; dropped if the value continues below
+        size_t plain_span = std::string_view::npos;
+        size_t pos = 0;
+        while (pos < data.size()) {
+            size_t newline = data.find('\n', pos);
+            size_t line_end = newline == std::string_view::npos ? data.size() : newline;
+            size_t next = line_end + 1;
+
+            size_t indent_end = pos;
+            while (indent_end < line_end && data[indent_end] == ' ') {
+                indent_end++;
+            }
+            size_t indent = indent_end - pos;
+            bool blank = trim(data.substr(indent_end, line_end - indent_end)).empty() ||
+                         data[indent_end] == '#';
+            if (skip_indent != std::string_view::npos) {
+                if (blank || indent > skip_indent) {
+                    if (!blank && plain_span != std::string_view::npos) {
+                        spans.erase(spans.begin() + plain_span);
+                        plain_span = std::string_view::npos;
+                    }
+                    pos = next;
+                    continue;
+                }
+                skip_indent = std::string_view::npos;
+            }
+            plain_span = std::string_view::npos;
+            if (blank) {
+                pos = next;
+                continue;
+            }
+
+            size_t value_end = parse_line(data, indent_end, line_end, pos, spans, skip_indent, plain_span, next);
+            pos = value_end;
+        }
+    }
+
+    void decode(std::string_view line, size_t begin, size_t end, std::string& out) const override {
+        switch (enclosing_quote(line, begin, end)) {
+            case '"': text_unescape::unescape(line.substr(begin, end - begin), out); break;
+            case '\'': undouble_quotes(line.substr(begin, end - begin), '\'', out); break;
+            default: out.assign(trim(line.substr(begin, end - begin))); break;
+        }
+    }
+
+    void encode(std::string_view text, std::string_view line, size_t begin, size_t end,
+                std::string& out) const override {
+        switch (enclosing_quote(line, begin, end)) {
+            case '"':
+                text_unescape::escape(text, '"', out);
+                break;
+            case '\'':
+                if (text.find_first_of("\r\n") != std::string_view::npos) {
+                    // Line breaks fold to spaces inside single quotes
+                    std::string flat(text);
+                    std::replace(flat.begin(), flat.end(), '\n', ' ');
+                    flat.erase(std::remove(flat.begin(), flat.end(), '\r'), flat.end());
+                    double_quotes(flat, '\'', out);
+                } else {
+                    double_quotes(text, '\'', out);
+                }
+                break;
+            default:
+                if (plain_safe(text)) {
+                    out.assign(text);
+                } else {
+                    // A plain value the translation would break becomes a quoted one
+                    text_unescape::escape(text, '"', out);
+                    out.insert(out.begin(), '"');
+                    out.push_back('"');
+                }
+                break;
+        }
+    }
+
+protected:
+    // Whether values under `key` are reported; "" for sequence items
+    virtual bool wants_key(std::string_view /*key*/) const {
+        return true;
+    }
+
+private:
+    static bool starts_with(std::string_view text, std::string_view prefix) {
+        return text.compare(0, prefix.size(), prefix) == 0;
+    }
+
+    // Handle one non-blank line from the first non-space byte at `begin`.
+    // Returns where the next line starts (later than `next` when a quoted
+    // value runs over several lines).
+    size_t parse_line(std::string_view data, size_t begin, size_t line_end, size_t line_start,
+                      std::vector<Span>& spans, size_t& skip_indent, size_t& plain_span, size_t next) const {
+        std::string_view content = data.substr(begin, line_end - begin);
+        if (starts_with(content, "---") || starts_with(content, "...") || content[0] == '%') {
+            return next;
+        }
+
+        // Sequence entries ("- value", "- key: value", "- - value")
+        size_t pos = begin;
+        bool item = false;
+        while (pos < line_end && data[pos] == '-' &&
+               (pos + 1 >= line_end || data[pos + 1] == ' ' || data[pos + 1] == '\r')) {
+            item = true;
+            pos++;
+            while (pos < line_end && data[pos] == ' ') {
+                pos++;
+            }
+        }
+        if (pos >= line_end || is_space(data[pos])) {
+            return next;
+        }
+
+        // A key ends at the first ':' followed by a space or the line end
+        size_t key_start = pos;
+        std::string_view key;
+        size_t value = pos;
+        if (data[pos] == '"' || data[pos] == '\'') {
+            size_t close = data[pos] == '"' ? backslash_string_end(data, pos, '"')
+                                            : doubled_quote_string_end(data, pos, '\'', true);
+            size_t after = close == std::string_view::npos ? line_end : close + 1;
+            while (after < line_end && data[after] == ' ') {
+                after++;
+            }
+            if (after < line_end && data[after] == ':' && is_value_separator(data, after + 1, line_end)) {
+                key = data.substr(pos + 1, close - pos - 1);
+                value = after + 1;
+            }
+        } else {
+            size_t colon = find_key_colon(data, pos, line_end);
+            if (colon != std::string_view::npos) {
+                key = data.substr(pos, colon - pos);
+                while (!key.empty() && key.back() == ' ') {
+                    key.remove_suffix(1);
+                }
+                value = colon + 1;
+            }
+        }
+        bool keyed = value != key_start;
+        if (!keyed && !item) {
+            return next;   // Continuation of something already skipped
+        }
+        size_t owner_indent = keyed ? key_start - line_start : begin - line_start;
+
+        while (value < line_end && data[value] == ' ') {
+            value++;
+        }
+        // Anchors and tags come before the value itself
+        while (value < line_end && (data[value] == '&' || data[value] == '!')) {
+            while (value < line_end && !is_space(data[value])) {
+                value++;
+            }
+            while (value < line_end && data[value] == ' ') {
+                value++;
+            }
+        }
+        if (value >= line_end || data[value] == '#' || data[value] == '\r') {
+            return next;   // Nested block or empty value
+        }
+
+        bool wanted = wants_key(keyed ? key : std::string_view());
+        char first = data[value];
+        if (first == '"' || first == '\'') {
+            size_t close = first == '"' ? backslash_string_end(data, value, '"')
+                                        : doubled_quote_string_end(data, value, '\'', true);
+            if (close == std::string_view::npos) {
+                // Quoted over several lines: skip to the line holding the closing quote
+                size_t end = first == '"' ? multi_line_string_end(data, value)
+                                          : doubled_quote_string_end(data, value, '\'', false);
+                if (end == std::string_view::npos) {
+                    return data.size();
+                }
+                size_t after = data.find('\n', end);
+                return after == std::string_view::npos ? data.size() : after + 1;
+            }
+            if (wanted && close > value + 1) {
+                spans.push_back({value + 1, close, keyed ? key_start : value, close + 1});
+            }
+            return next;
+        }
+        if (first == '|' || first == '>') {
+            skip_indent = owner_indent;
+            return next;
+        }
+        if (first == '*') {
+            return next;   // Alias
+        }
+        if (first == '[' || first == '{') {
+            if (wanted) {
+                add_flow_items(data, value, line_end, spans);
+            }
+            if (!flow_closed(data, value, line_end)) {
+                skip_indent = owner_indent;
+            }
+            return next;
+        }
+
+        size_t end = plain_end(data, value, line_end);
+        std::string_view plain = data.substr(value, end - value);
+        skip_indent = owner_indent;   // A plain value may continue on deeper lines
+        if (wanted && !is_keyword(plain)) {
+            plain_span = spans.size();
+            spans.push_back({value, end, keyed ? key_start : value, end});
+        }
+        return next;
+    }
+
+    static bool is_value_separator(std::string_view data, size_t pos, size_t line_end) {
+        return pos >= line_end || data[pos] == ' ' || data[pos] == '\t' || data[pos] == '\r';
+    }
+
+    static size_t find_key_colon(std::string_view data, size_t pos, size_t line_end) {
+        for (; pos < line_end; pos++) {
+            char ch = data[pos];
+            if (ch == '#' && pos > 0 && is_space(data[pos - 1])) {
+                return std::string_view::npos;
+            }
+            if (ch == ':' && is_value_separator(data, pos + 1, line_end)) {
+                return pos;
+            }
+        }
+        return std::string_view::npos;
+    }
+
+    // End of a plain value: before a " #" comment and trailing whitespace
+    static size_t plain_end(std::string_view data, size_t pos, size_t line_end) {
+        size_t end = pos;
+        for (size_t i = pos; i < line_end; i++) {
+            if (data[i] == '#' && is_space(data[i - 1])) {
+                break;
+            }
+            if (!is_space(data[i])) {
+                end = i + 1;
+            }
+        }
+        return end;
+    }
+
+    // Closing quote of a double-quoted value that runs over several lines
+    static size_t multi_line_string_end(std::string_view data, size_t open) {
+        for (size_t pos = open + 1; pos < data.size(); pos++) {
+            if (data[pos] == '\\') {
+                pos++;
+            } else if (data[pos] == '"') {
+                return pos;
+            }
+        }
+        return std::string_view::npos;
+    }
+
+    static void add_flow_items(std::string_view data, size_t pos, size_t line_end, std::vector<Span>& spans) {
+        for (; pos < line_end; pos++) {
+            char quote = data[pos];
+            if (quote != '"' && quote != '\'') {
+                continue;
+            }
+            size_t close = quote == '"' ? backslash_string_end(data, pos, '"')
+                                        : doubled_quote_string_end(data, pos, '\'', true);
+            if (close == std::string_view::npos || close >= line_end) {
+                return;
+            }
+            size_t after = close + 1;
+            while (after < line_end && data[after] == ' ') {
+                after++;
+            }
+            if ((after >= line_end || data[after] != ':') && close > pos + 1) {
+                spans.push_back({pos + 1, close, pos, close + 1});
+            }
+            pos = close;
+        }
+    }
+
+    static bool flow_closed(std::string_view data, size_t pos, size_t line_end) {
+        int depth = 0;
+        for (; pos < line_end; pos++) {
+            char ch = data[pos];
+            if (ch == '"' || ch == '\'') {
+                size_t close = ch == '"' ? backslash_string_end(data, pos, '"')
+                                         : doubled_quote_string_end(data, pos, '\'', true);
+                if (close == std::string_view::npos || close >= line_end) {
+                    return false;
+                }
+                pos = close;
+            } else if (ch == '[' || ch == '{') {
+                depth++;
+            } else if (ch == ']' || ch == '}') {
+                depth--;
+            }
+        }
+        return depth <= 0;
+    }
+
+    // Plain values YAML reads as booleans or null rather than strings
+    static bool is_keyword(std::string_view value) {
+        static constexpr std::string_view keywords[] = {
+            "~", "null", "true", "false", "yes", "no", "on", "off"
+        };
+        for (std::string_view keyword : keywords) {
+            if (value.size() == keyword.size() &&
+                std::equal(value.begin(), value.end(), keyword.begin(), [](char a, char b) {
+                    return (a >= 'A' && a <= 'Z' ? a - 'A' + 'a' : a) == b;
+                })) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Whether `text` can be written as a plain value as it is
+    static bool plain_safe(std::string_view text) {
+        if (text.empty() || is_space(text.front()) || is_space(text.back()) || is_keyword(text) ||
+            std::string_view("-?:,[]{}#&*!|>'\"%@`").find(text.front()) != std::string_view::npos) {
+            return false;
+        }
+        return text.find(": ") == std::string_view::npos && text.find(" #") == std::string_view::npos &&
+               text.find_first_of("\r\n") == std::string_view::npos && text.back() != ':';
+    }
+};
+
+// Unity serialized assets (.unity, .prefab, .asset): only the fields that
+// hold UI texts (UI Text, TextMeshPro and Localization string tables), not
+// object names, GUIDs or property paths
+class UnityYamlExtractor : public YamlExtractor {
+public:
+    const char* name() const override {
+        return "unity";
+    }
+
+protected:
+    bool wants_key(std::string_view key) const override {
+        static constexpr std::string_view text_fields[] = {"m_Text", "m_text", "m_Localized"};
+        for (std::string_view field : text_fields) {
+            if (key == field) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+// Shared, stateless extractor for `name`, or nullptr if there is none
+inline const FormatExtractor* find_extractor(std::string_view name) {
+    static const JsonExtractor json;
+    static const XmlExtractor xml;
+    static const CsvExtractor csv;
+    static const YamlExtractor yaml;
+    static const UnityYamlExtractor unity;
+    static const FormatExtractor* const extractors[] = {&json, &xml, &csv, &yaml, &unity};
+    for (const FormatExtractor* extractor : extractors) {
+        if (name == extractor->name()) {
+            return extractor;
+        }
+    }
+    return nullptr;
+}
+
+// Codec for files scanned with the generic text patterns
+inline const TextCodec& pattern_codec() {
+    static const TextCodec codec;
+    return codec;
+}
+
+}  // namespace format_extract
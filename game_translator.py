@@ -8,11 +8,14 @@ import os
 import sys
 import tkinter as tk
 from tkinter import ttk, filedialog, messagebox, scrolledtext
+import tkinter.font as tkfont
 import threading
 import json
 import time
 from pathlib import Path
 import re
+import string
+from types import SimpleNamespace
 
 # Try to import the C++ module, fallback to pure Python if not available
 try:
@@ -23,6 +26,13 @@ except ImportError:
     CPP_AVAILABLE = False
     print("C++ module not available - using pure Python processing")
 
+# Binary index saved next to the extracted texts, reopened with "Open Index"
+INDEX_FILE_NAME = "extraction_index.gtxi"
+# Fuzzy-match index of a translation file, saved next to it as <file>.gtxm
+TRANSLATION_MEMORY_SUFFIX = ".gtxm"
+# The filter bar ignores case for A-Z only, like ChunkSearchIndex
+ASCII_LOWER = str.maketrans(string.ascii_uppercase, string.ascii_lowercase)
+
 class GameTranslator:
     def __init__(self, root):
         self.root = root
@@ -31,9 +41,22 @@ class GameTranslator:
         
         # Data storage
         self.extracted_texts = []
+        self.chunk_store = None  # ChunkStore of the C++ module; used instead of extracted_texts when set
         self.translations = {}
         self.current_directory = ""
         self.output_directory = ""
+        self.cancel_event = threading.Event()  # Set by the Cancel button
+        self.cancel_token = None  # CancellationToken of the running C++ extraction
+        self.translation_memory = None  # TranslationMemory of self.translations, for suggestions
+        self.tm_building = False
+        self.tm_dirty = False  # Translations changed while the memory was being built
+        self.suggestions = []
+        self.list_top = 0  # Index of the text in the first row of the list
+        self.list_selected = None  # Index of the selected text
+        self.list_row_height = None
+        self.list_view = None  # Indices of the texts the filter bar matches; None shows all
+        self.search_index = None  # ChunkSearchIndex of chunk_store, built after extraction
+        self.filter_job = None
         
         self.setup_ui()
         
@@ -103,6 +126,14 @@ class GameTranslator:
                                    command=self.apply_translations_threaded, state=tk.DISABLED)
         self.apply_btn.grid(row=0, column=3, padx=5)
         
+        self.open_index_btn = ttk.Button(button_frame, text="Open Index", 
+                                        command=self.open_index)
+        self.open_index_btn.grid(row=0, column=4, padx=5)
+        
+        self.cancel_btn = ttk.Button(button_frame, text="Cancel", 
+                                    command=self.cancel_extraction, state=tk.DISABLED)
+        self.cancel_btn.grid(row=0, column=5, padx=5)
+        
         # Progress bar
         self.progress_var = tk.DoubleVar()
         self.progress_bar = ttk.Progressbar(main_frame, variable=self.progress_var, 
@@ -122,19 +153,45 @@ class GameTranslator:
         self.texts_frame = ttk.Frame(notebook)
         notebook.add(self.texts_frame, text="Extracted Texts")
         
+        # Filter bar: the list shows only the matching texts
+        filter_frame = ttk.Frame(self.texts_frame)
+        filter_frame.pack(fill=tk.X, padx=5, pady=(5, 0))
+        
+        ttk.Label(filter_frame, text="Search:").pack(side=tk.LEFT)
+        self.search_var = tk.StringVar()
+        ttk.Entry(filter_frame, textvariable=self.search_var, width=40).pack(side=tk.LEFT, padx=(5, 10))
+        ttk.Label(filter_frame, text="File:").pack(side=tk.LEFT)
+        self.file_filter_var = tk.StringVar()
+        ttk.Entry(filter_frame, textvariable=self.file_filter_var, width=25).pack(side=tk.LEFT, padx=(5, 10))
+        self.regex_var = tk.BooleanVar()
+        ttk.Checkbutton(filter_frame, text="Regex", variable=self.regex_var).pack(side=tk.LEFT)
+        self.untranslated_var = tk.BooleanVar()
+        ttk.Checkbutton(filter_frame, text="Untranslated only",
+                        variable=self.untranslated_var).pack(side=tk.LEFT, padx=10)
+        for var in (self.search_var, self.file_filter_var, self.regex_var, self.untranslated_var):
+            var.trace_add('write', lambda *args: self.schedule_filter())
+        
         # Text list with scrollbar
         list_frame = ttk.Frame(self.texts_frame)
         list_frame.pack(fill=tk.BOTH, expand=True, padx=5, pady=5)
         
-        self.text_listbox = tk.Listbox(list_frame, height=15)
-        scrollbar = ttk.Scrollbar(list_frame, orient=tk.VERTICAL, command=self.text_listbox.yview)
-        self.text_listbox.configure(yscrollcommand=scrollbar.set)
+        # The list holds only the visible rows; the scrollbar moves over all texts
+        self.text_listbox = tk.Listbox(list_frame, height=15, exportselection=False)
+        self.text_scrollbar = ttk.Scrollbar(list_frame, orient=tk.VERTICAL, command=self.scroll_text_list)
         
         self.text_listbox.pack(side=tk.LEFT, fill=tk.BOTH, expand=True)
-        scrollbar.pack(side=tk.RIGHT, fill=tk.Y)
+        self.text_scrollbar.pack(side=tk.RIGHT, fill=tk.Y)
         
-        # Bind selection event
+        # Bind selection, resize, wheel and arrow keys
         self.text_listbox.bind('<<ListboxSelect>>', self.on_text_select)
+        self.text_listbox.bind('<Configure>', lambda event: self.render_text_list())
+        self.text_listbox.bind('<MouseWheel>', self.on_text_list_wheel)
+        self.text_listbox.bind('<Button-4>', self.on_text_list_wheel)
+        self.text_listbox.bind('<Button-5>', self.on_text_list_wheel)
+        self.text_listbox.bind('<Up>', lambda event: self.move_selection(-1))
+        self.text_listbox.bind('<Down>', lambda event: self.move_selection(1))
+        self.text_listbox.bind('<Prior>', lambda event: self.move_selection(-self.visible_rows()))
+        self.text_listbox.bind('<Next>', lambda event: self.move_selection(self.visible_rows()))
         
         # Translation tab
         self.translation_frame = ttk.Frame(notebook)
@@ -155,6 +212,12 @@ class GameTranslator:
         ttk.Button(editor_frame, text="Save Translation", 
                   command=self.save_current_translation).pack(anchor=tk.W)
         
+        # Earlier translations of similar texts; double-click to use one
+        ttk.Label(editor_frame, text="Suggestions:").pack(anchor=tk.W, pady=(10, 0))
+        self.suggestion_listbox = tk.Listbox(editor_frame, height=5)
+        self.suggestion_listbox.pack(fill=tk.X)
+        self.suggestion_listbox.bind('<Double-Button-1>', self.use_suggestion)
+        
         # Statistics tab
         self.stats_frame = ttk.Frame(notebook)
         notebook.add(self.stats_frame, text="Statistics")
@@ -221,6 +284,9 @@ class GameTranslator:
             
         # Disable buttons during extraction
         self.extract_btn.config(state=tk.DISABLED)
+        self.cancel_btn.config(state=tk.NORMAL)
+        self.cancel_event.clear()
+        self.progress_var.set(0)
         self.status_var.set(f"Extracting texts from files with extensions: {', '.join(extensions)}...")
         
         # Run extraction in separate thread
@@ -237,22 +303,42 @@ class GameTranslator:
                 # Set the supported extensions
                 allowed_extensions = self.get_file_extensions()
                 extractor.set_supported_extensions(allowed_extensions)
+                self.cancel_token = text_extractor.CancellationToken()
+                if self.cancel_event.is_set():
+                    self.cancel_token.cancel()
+                extractor.set_cancel_token(self.cancel_token)
                 
-                result = extractor.extract_texts(self.current_directory)
-                
-                # Convert C++ result to Python format
+                # Stream batches of chunks so the list fills while extraction runs.
+                # The chunks stay in C++; the list only asks for its visible rows.
+                start_time = time.time()
+                store = text_extractor.ChunkStore()
                 self.extracted_texts = []
-                for chunk in result.chunks:
-                    self.extracted_texts.append({
-                        'text': chunk.text,
-                        'file_path': chunk.file_path,
-                        'line_number': chunk.line_number,
-                        'context': chunk.context,
-                        'original_text': chunk.original_text
-                    })
+                self.chunk_store = store
+                self.search_index = None
+                self.list_view = None
+                self.root.after(0, self.update_text_list)
+                stream = extractor.extract_iter(self.current_directory, 1000)
+                while stream.read_into(store):
+                    self.root.after(0, self.render_text_list)
+                    self.root.after(0, self.status_var.set,
+                                    f"Extracting... {stream.texts_found} texts from "
+                                    f"{stream.files_processed}/{stream.total_files} files")
+                    if stream.total_files:
+                        self.root.after(0, self.progress_var.set,
+                                        100.0 * stream.files_processed / stream.total_files)
+                
+                if self.cancel_token.cancelled:
+                    self.root.after(0, self.extraction_cancelled, stream.files_processed)
+                    return
+                
+                result = SimpleNamespace(total_files_processed=stream.files_processed,
+                                         total_texts_found=len(store),
+                                         processing_time=time.time() - start_time)
                 
                 # Save extracted texts
-                extractor.save_extracted_texts(result.chunks, self.output_directory)
+                extractor.save_extracted_texts(store, self.output_directory)
+                extractor.save_index(store, os.path.join(self.output_directory, INDEX_FILE_NAME),
+                                     self.current_directory)
                 
                 # Update UI in main thread
                 self.root.after(0, self.extraction_complete, result)
@@ -261,7 +347,9 @@ class GameTranslator:
                 self.extract_texts_python()
                 
         except Exception as e:
-            self.root.after(0, lambda: messagebox.showerror("Error", f"Extraction failed: {str(e)}"))
+            # Errors of the streaming producer are raised by read_into once
+            # the batches before them have been stored
+            self.root.after(0, messagebox.showerror, "Error", f"Extraction failed: {e}")
             self.root.after(0, self.extraction_error)
             
     def extract_texts_python(self):
@@ -284,15 +372,26 @@ class GameTranslator:
         ]
         
         self.extracted_texts = []
+        self.chunk_store = None
+        self.search_index = None
+        self.list_view = None
         files_processed = 0
         
         for root, dirs, files in os.walk(self.current_directory):
+            if self.cancel_event.is_set():
+                break
             for file in files:
+                if self.cancel_event.is_set():
+                    break
                 # Check if file has one of the allowed extensions
                 file_lower = file.lower()
                 if any(file_lower.endswith(ext) for ext in allowed_extensions):
                     file_path = os.path.join(root, file)
                     try:
+                        # Skip binary files such as binary-serialized Unity assets
+                        with open(file_path, 'rb') as f:
+                            if b'\0' in f.read(4096):
+                                continue
                         with open(file_path, 'r', encoding='utf-8', errors='ignore') as f:
                             for line_num, line in enumerate(f, 1):
                                 for pattern in text_patterns:
@@ -316,16 +415,22 @@ class GameTranslator:
                                                 for i, chunk in enumerate(chunks):
                                                     self.extracted_texts.append({
                                                         'text': chunk,
-                                                        'file_path': f"{file_path}_chunk_{i}",
+                                                        'file_path': file_path,
                                                         'line_number': line_num,
                                                         'context': line.strip(),
-                                                        'original_text': match.group(0)
+                                                        'original_text': match.group(0),
+                                                        'part_index': i,
+                                                        'part_count': len(chunks)
                                                     })
                         files_processed += 1
                     except Exception as e:
                         print(f"Error processing {file_path}: {e}")
         
         # Update UI
+        if self.cancel_event.is_set():
+            self.root.after(0, self.update_text_list)
+            self.root.after(0, self.extraction_cancelled, files_processed)
+            return
         self.root.after(0, self.extraction_complete_python, files_processed)
         
     def split_text_into_chunks(self, text, max_chunk_size):
@@ -354,63 +459,324 @@ class GameTranslator:
         
         return chunks
         
+    def cancel_extraction(self):
+        """Stop the running extraction after the files in progress"""
+        self.cancel_event.set()
+        if self.cancel_token is not None:
+            self.cancel_token.cancel()
+        self.cancel_btn.config(state=tk.DISABLED)
+        self.status_var.set("Cancelling...")
+        
+    def extraction_cancelled(self, files_processed):
+        # Partial results are listed and can be filtered, but are not saved
+        self.render_text_list()
+        self.build_search_index()
+        self.extract_btn.config(state=tk.NORMAL)
+        self.cancel_btn.config(state=tk.DISABLED)
+        self.save_btn.config(state=tk.DISABLED)
+        self.apply_btn.config(state=tk.DISABLED)
+        self.status_var.set(f"Extraction cancelled after {files_processed} files; nothing was saved")
+        
     def extraction_complete(self, result):
-        self.update_text_list()
+        # Streaming extraction has already filled the list
+        self.render_text_list()
+        self.build_search_index()
         self.update_statistics(result.total_files_processed, result.total_texts_found, result.processing_time)
         self.extract_btn.config(state=tk.NORMAL)
+        self.cancel_btn.config(state=tk.DISABLED)
+        self.progress_var.set(100)
         self.save_btn.config(state=tk.NORMAL)
         self.apply_btn.config(state=tk.NORMAL)
         self.status_var.set(f"Extraction complete! Found {result.total_texts_found} texts in {result.total_files_processed} files")
         
     def extraction_complete_python(self, files_processed):
-        self.update_text_list()
+        self.apply_filter()
         self.update_statistics(files_processed, len(self.extracted_texts), 0)
         self.extract_btn.config(state=tk.NORMAL)
+        self.cancel_btn.config(state=tk.DISABLED)
         self.save_btn.config(state=tk.NORMAL)
         self.apply_btn.config(state=tk.NORMAL)
         self.status_var.set(f"Extraction complete! Found {len(self.extracted_texts)} texts in {files_processed} files")
         
     def extraction_error(self):
+        # Chunks streamed before the error stay listed, as after a cancel
+        self.render_text_list()
+        self.build_search_index()
         self.extract_btn.config(state=tk.NORMAL)
+        self.cancel_btn.config(state=tk.DISABLED)
         self.status_var.set("Extraction failed")
         
     def update_text_list(self):
-        self.text_listbox.delete(0, tk.END)
-        for i, text_data in enumerate(self.extracted_texts):
-            # Show more characters for preview, especially for large texts
-            text_length = len(text_data['text'])
-            if text_length > 100:
-                preview = text_data['text'][:100] + "..."
-                # Add length indicator for large texts
-                preview += f" [{text_length} chars]"
+        self.list_top = 0
+        self.list_selected = None
+        self.render_text_list()
+        
+    # Positions below are rows of the list; with a filter, row i shows text list_view[i]
+    def text_count(self):
+        if self.list_view is not None:
+            return len(self.list_view)
+        if self.chunk_store is not None:
+            return len(self.chunk_store)
+        return len(self.extracted_texts)
+        
+    def text_index(self, position):
+        if self.list_view is not None:
+            return int(self.list_view[position])
+        return position
+        
+    def text_at(self, position):
+        index = self.text_index(position)
+        if self.chunk_store is not None:
+            return self.chunk_store.text(index)
+        return self.extracted_texts[index]['text']
+        
+    def text_previews(self, start, count):
+        """List lines for the texts at positions [start, start + count)"""
+        if self.list_view is not None:
+            indices = [int(index) for index in self.list_view[start:start + count]]
+        else:
+            indices = None
+        if self.chunk_store is not None:
+            if indices is not None:
+                return self.chunk_store.previews_of(indices, 100)
+            return self.chunk_store.previews(start, count, 100)
+        if indices is None:
+            indices = range(start, min(start + count, len(self.extracted_texts)))
+        previews = []
+        for index in indices:
+            # Show more characters for preview, with a length indicator for large texts
+            text = self.extracted_texts[index]['text']
+            if len(text) > 100:
+                previews.append(text[:100] + f"... [{len(text)} chars]")
             else:
-                preview = text_data['text']
-            self.text_listbox.insert(tk.END, f"{i+1}. {preview}")
+                previews.append(text)
+        return previews
+        
+    def schedule_filter(self):
+        """Filter after a short pause in typing rather than on every key"""
+        if self.filter_job is not None:
+            self.root.after_cancel(self.filter_job)
+        self.filter_job = self.root.after(150, self.apply_filter)
+        
+    def filter_active(self):
+        return bool(self.search_var.get() or self.file_filter_var.get() or self.untranslated_var.get())
+        
+    def apply_filter(self):
+        """Show only the texts matching the filter bar"""
+        self.filter_job = None
+        if not self.filter_active():
+            self.list_view = None
+        elif self.chunk_store is not None:
+            if self.search_index is None:
+                # search_index_ready filters again
+                self.status_var.set("Filtering once the search index is built...")
+                return
+            try:
+                self.list_view = self.search_index.search(self.search_var.get(), regex=self.regex_var.get(),
+                                                          file=self.file_filter_var.get(),
+                                                          untranslated_only=self.untranslated_var.get())
+            except ValueError as e:
+                self.status_var.set(str(e))
+                return
+        else:
+            try:
+                self.list_view = self.filter_texts_python()
+            except re.error as e:
+                self.status_var.set(f"invalid regular expression: {e}")
+                return
+        self.update_text_list()
+        if self.list_view is not None:
+            total = len(self.chunk_store) if self.chunk_store is not None else len(self.extracted_texts)
+            self.status_var.set(f"{len(self.list_view)} of {total} texts match the filter")
             
+    def filter_texts_python(self):
+        search = self.search_var.get()
+        file_filter = self.file_filter_var.get().translate(ASCII_LOWER)
+        untranslated = self.untranslated_var.get()
+        if self.regex_var.get():
+            pattern = re.compile(search, re.IGNORECASE | re.ASCII)
+            matches = lambda text: pattern.search(text) is not None
+        else:
+            search = search.translate(ASCII_LOWER)
+            matches = lambda text: search in text.translate(ASCII_LOWER)
+        return [index for index, text_data in enumerate(self.extracted_texts)
+                if matches(text_data['text']) and file_filter in text_data['file_path'].translate(ASCII_LOWER)
+                and not (untranslated and text_data['text'] in self.translations)]
+        
+    def build_search_index(self):
+        """Index chunk_store for the filter bar in the background"""
+        self.search_index = None
+        if self.chunk_store is None:
+            return
+        thread = threading.Thread(target=self.index_chunk_store, args=(self.chunk_store,))
+        thread.daemon = True
+        thread.start()
+        
+    def index_chunk_store(self, store):
+        index = None
+        try:
+            index = text_extractor.ChunkSearchIndex(store)
+        except Exception as e:
+            print(f"Could not build search index: {e}")
+        self.root.after(0, self.search_index_ready, store, index)
+        
+    def search_index_ready(self, store, index):
+        if store is not self.chunk_store or index is None:
+            # A newer extraction replaced the store
+            return
+        index.set_translated(list(self.translations))
+        self.search_index = index
+        if self.filter_active():
+            self.apply_filter()
+        
+    def visible_rows(self):
+        """Number of rows the text list has room for"""
+        listbox = self.text_listbox
+        height = listbox.winfo_height()
+        if height <= 1:
+            # Not drawn yet
+            return int(listbox.cget('height'))
+        if self.list_row_height is None:
+            # Row height as Tk computes it for a listbox
+            font = tkfont.Font(font=listbox.cget('font'))
+            self.list_row_height = font.metrics('linespace') + 1 + 2 * int(listbox.cget('selectborderwidth'))
+        border = 2 * (int(listbox.cget('borderwidth')) + int(listbox.cget('highlightthickness')))
+        return max(1, (height - border) // self.list_row_height)
+        
+    def render_text_list(self):
+        """Fill the list with the rows from list_top, fetching only those texts"""
+        total = self.text_count()
+        rows = self.visible_rows()
+        self.list_top = max(0, min(self.list_top, total - rows))
+        lines = self.text_previews(self.list_top, rows)
+        self.text_listbox.delete(0, tk.END)
+        for offset, line in enumerate(lines):
+            self.text_listbox.insert(tk.END, f"{self.text_index(self.list_top + offset) + 1}. {line}")
+        if self.list_selected is not None and self.list_top <= self.list_selected < self.list_top + len(lines):
+            self.text_listbox.selection_set(self.list_selected - self.list_top)
+        if total:
+            self.text_scrollbar.set(self.list_top / total, (self.list_top + len(lines)) / total)
+        else:
+            self.text_scrollbar.set(0, 1)
+            
+    def scroll_text_list(self, *args):
+        """Scrollbar command: ('moveto', fraction) or ('scroll', n, 'units' or 'pages')"""
+        if args[0] == 'moveto':
+            self.list_top = int(float(args[1]) * self.text_count())
+        elif args[0] == 'scroll':
+            step = int(args[1])
+            if args[2] == 'pages':
+                step *= self.visible_rows()
+            self.list_top += step
+        self.render_text_list()
+        
+    def on_text_list_wheel(self, event):
+        up = event.num == 4 or event.delta > 0
+        self.scroll_text_list('scroll', -3 if up else 3, 'units')
+        return "break"
+        
+    def move_selection(self, step):
+        total = self.text_count()
+        if total:
+            if self.list_selected is None:
+                index = self.list_top
+            else:
+                index = min(max(self.list_selected + step, 0), total - 1)
+            rows = self.visible_rows()
+            if index < self.list_top:
+                self.list_top = index
+            elif index >= self.list_top + rows:
+                self.list_top = index - rows + 1
+            self.list_selected = index
+            self.render_text_list()
+            self.show_text(index)
+        return "break"
+        
     def on_text_select(self, event):
         selection = self.text_listbox.curselection()
         if selection:
-            index = selection[0]
-            text_data = self.extracted_texts[index]
+            self.list_selected = self.list_top + selection[0]
+            self.show_text(self.list_selected)
             
-            # Update translation editor
-            self.original_text.delete(1.0, tk.END)
-            self.original_text.insert(1.0, text_data['text'])
+    def show_text(self, index):
+        text = self.text_at(index)
+        
+        # Update translation editor
+        self.original_text.delete(1.0, tk.END)
+        self.original_text.insert(1.0, text)
+        
+        # Load existing translation if available
+        translation = self.translations.get(text, "")
+        self.translation_text.delete(1.0, tk.END)
+        self.translation_text.insert(1.0, translation)
+        
+        self.show_suggestions(text)
+        
+    def show_suggestions(self, text):
+        self.suggestion_listbox.delete(0, tk.END)
+        self.suggestions = []
+        if self.translation_memory is None:
+            return
+        self.suggestions = self.translation_memory.lookup(text, 5, 0.6)
+        for match in self.suggestions:
+            self.suggestion_listbox.insert(tk.END, f"{match.score:.0%}  {match.source} -> {match.translation}")
             
-            # Load existing translation if available
-            translation = self.translations.get(text_data['text'], "")
+    def use_suggestion(self, event):
+        selection = self.suggestion_listbox.curselection()
+        if selection:
             self.translation_text.delete(1.0, tk.END)
-            self.translation_text.insert(1.0, translation)
+            self.translation_text.insert(1.0, self.suggestions[selection[0]].translation)
+            
+    def refresh_translation_memory(self, translation_file=None):
+        """Rebuild the suggestion index in the background; with a translation file,
+        reuse its saved index when that is newer, or save the new one next to it"""
+        if not CPP_AVAILABLE:
+            return
+        if self.tm_building:
+            self.tm_dirty = True
+            return
+        self.tm_building = True
+        self.tm_dirty = False
+        thread = threading.Thread(target=self.build_translation_memory,
+                                  args=(dict(self.translations), translation_file))
+        thread.daemon = True
+        thread.start()
+        
+    def build_translation_memory(self, translations, translation_file):
+        memory = None
+        try:
+            cache_path = translation_file + TRANSLATION_MEMORY_SUFFIX if translation_file else None
+            if cache_path and os.path.exists(cache_path) and \
+                    os.path.getmtime(cache_path) >= os.path.getmtime(translation_file):
+                try:
+                    memory = text_extractor.TranslationMemory(cache_path)
+                except Exception as e:
+                    print(f"Rebuilding {cache_path}: {e}")
+            if memory is None:
+                memory = text_extractor.TranslationMemory.build(translations)
+                if cache_path:
+                    memory.save(cache_path)
+        except Exception as e:
+            print(f"Could not build translation memory: {e}")
+        self.root.after(0, self.translation_memory_ready, memory)
+        
+    def translation_memory_ready(self, memory):
+        self.tm_building = False
+        if memory is not None:
+            self.translation_memory = memory
+        if self.tm_dirty:
+            self.refresh_translation_memory()
             
     def save_current_translation(self):
-        selection = self.text_listbox.curselection()
-        if selection:
-            index = selection[0]
-            text_data = self.extracted_texts[index]
+        if self.list_selected is not None:
+            text = self.text_at(self.list_selected)
             translation = self.translation_text.get(1.0, tk.END).strip()
             
             if translation:
-                self.translations[text_data['text']] = translation
+                self.translations[text] = translation
+                if self.search_index is not None:
+                    self.search_index.mark_translated(text)
+                self.refresh_translation_memory()
                 messagebox.showinfo("Success", "Translation saved!")
             else:
                 messagebox.showwarning("Warning", "Please enter a translation")
@@ -429,6 +795,7 @@ class GameTranslator:
             try:
                 with open(filename, 'w', encoding='utf-8') as f:
                     json.dump(self.translations, f, ensure_ascii=False, indent=2)
+                self.refresh_translation_memory(filename)
                 messagebox.showinfo("Success", f"Translations saved to {filename}")
             except Exception as e:
                 messagebox.showerror("Error", f"Failed to save translations: {str(e)}")
@@ -442,10 +809,48 @@ class GameTranslator:
             try:
                 with open(filename, 'r', encoding='utf-8') as f:
                     self.translations = json.load(f)
+                if self.search_index is not None:
+                    self.search_index.set_translated(list(self.translations))
+                if self.untranslated_var.get():
+                    self.apply_filter()
+                self.refresh_translation_memory(filename)
                 messagebox.showinfo("Success", f"Translations loaded from {filename}")
             except Exception as e:
                 messagebox.showerror("Error", f"Failed to load translations: {str(e)}")
                 
+    def open_index(self):
+        """Reopen a previous extraction from its binary index instead of extracting again"""
+        if not CPP_AVAILABLE:
+            messagebox.showwarning("Warning", "Opening an extraction index requires the C++ module")
+            return
+            
+        filename = filedialog.askopenfilename(
+            filetypes=[("Extraction index", "*.gtxi"), ("All files", "*.*")]
+        )
+        
+        if filename:
+            try:
+                # Texts are read from the mapped index as the list shows them
+                index = text_extractor.ExtractionIndex(filename)
+                self.chunk_store = text_extractor.ChunkStore.from_index(filename)
+                self.extracted_texts = []
+                self.list_view = None
+                self.build_search_index()
+                
+                self.current_directory = index.source_root
+                self.dir_var.set(index.source_root)
+                if not self.output_directory:
+                    self.output_directory = os.path.dirname(filename)
+                    self.output_var.set(self.output_directory)
+                
+                self.update_text_list()
+                self.update_statistics(index.file_count, len(self.chunk_store), 0)
+                self.save_btn.config(state=tk.NORMAL)
+                self.apply_btn.config(state=tk.NORMAL)
+                self.status_var.set(f"Opened index with {len(self.chunk_store)} texts from {index.file_count} files")
+            except Exception as e:
+                messagebox.showerror("Error", f"Failed to open index: {str(e)}")
+                
     def apply_translations_threaded(self):
         if not self.translations:
             messagebox.showwarning("Warning", "No translations to apply")
@@ -460,11 +865,14 @@ class GameTranslator:
         try:
             self.root.after(0, lambda: self.status_var.set("Applying translations..."))
             
-            if CPP_AVAILABLE:
-                # Use C++ module for fast application
+            if CPP_AVAILABLE and self.chunk_store is not None and len(self.chunk_store):
+                # Use C++ module for fast application; translated copies of the
+                # source files are written below the output directory
                 extractor = text_extractor.TextExtractor()
-                # Note: This would need to be implemented in the C++ module
-                pass
+                translated_dir = os.path.join(self.output_directory, "translated")
+                applied = extractor.apply_translation_map(self.chunk_store, self.translations, translated_dir)
+                self.root.after(0, lambda: messagebox.showinfo(
+                    "Success", f"Applied {applied} translations. Translated files saved to {translated_dir}"))
             else:
                 # Pure Python implementation
                 self.apply_translations_python()
@@ -485,8 +893,20 @@ class GameTranslator:
                 
     def update_statistics(self, files_processed, texts_found, processing_time):
         # Calculate statistics for large texts
-        large_texts = [text for text in self.extracted_texts if len(text['text']) > 1000]
-        very_large_texts = [text for text in self.extracted_texts if len(text['text']) > 10000]
+        if self.chunk_store is not None:
+            summary = self.chunk_store.length_summary([1000, 10000])
+            large_texts, very_large_texts = summary.longer_than
+            max_length = summary.max_chars
+            total_length = summary.total_chars
+            text_count = len(self.chunk_store)
+        else:
+            lengths = [len(text['text']) for text in self.extracted_texts]
+            large_texts = sum(1 for length in lengths if length > 1000)
+            very_large_texts = sum(1 for length in lengths if length > 10000)
+            max_length = max(lengths) if lengths else 0
+            total_length = sum(lengths)
+            # All texts, not the filtered list view
+            text_count = len(lengths)
         
         # Get current extensions for display
         current_extensions = self.get_file_extensions()
@@ -502,10 +922,10 @@ File Extensions Processed: {', '.join(current_extensions)}
 
 TEXT SIZE STATISTICS
 ===================
-Large Texts (>1000 chars): {len(large_texts)}
-Very Large Texts (>10000 chars): {len(very_large_texts)}
-Maximum Text Length: {max(len(text['text']) for text in self.extracted_texts) if self.extracted_texts else 0} chars
-Average Text Length: {sum(len(text['text']) for text in self.extracted_texts)/len(self.extracted_texts) if self.extracted_texts else 0:.1f} chars
+Large Texts (>1000 chars): {large_texts}
+Very Large Texts (>10000 chars): {very_large_texts}
+Maximum Text Length: {max_length} chars
+Average Text Length: {total_length/text_count if text_count else 0:.1f} chars
 
 TRANSLATION STATISTICS
 =====================
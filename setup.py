@@ -4,10 +4,11 @@ Setup script for Game Text Translator
 Builds the C++ extension module using pybind11
 """
 
-from setuptools import setup, Extension
+from setuptools import setup, Extension, Command
 from pybind11.setup_helpers import Pybind11Extension, build_ext
 from pybind11 import get_cmake_dir
 import pybind11
+import subprocess
 import sys
 import os
 
@@ -22,11 +23,79 @@ ext_modules = [
             # Path to pybind11 headers
             pybind11.get_include(),
         ],
+        # The engine lives in headers; rebuild when any of them changes
+        depends=[
+            "text_extractor.h",
+            "async_io.h",
+            "chunk_search.h",
+            "delimiter_scan.h",
+            "format_extractors.h",
+            "text_encoding.h",
+            "text_unescape.h",
+            "translation_memory.h",
+        ],
+        # Shift-JIS conversion uses iconv, which is part of libc except on macOS
+        libraries=["iconv"] if sys.platform == "darwin" else [],
         language='c++',
         cxx_std=17,
     ),
 ]
 
+# Native benchmarks, built with: python setup.py build_benchmarks
+benchmarks = [
+    "benchmark_clean_text.cpp",
+    "benchmark_delimiter_scan.cpp",
+    "benchmark_extraction.cpp",
+]
+
+
+# Native tests of the engine, built and run with: python setup.py test_native
+tests = [
+    "test_extractor.cpp",
+]
+
+
+class BuildBenchmarks(Command):
+    description = "build the C++ benchmark executables next to the extension"
+    user_options = []
+    sources = benchmarks
+
+    def initialize_options(self):
+        pass
+
+    def finalize_options(self):
+        pass
+
+    def run(self):
+        for source in self.sources:
+            self.compile(source)
+
+    def compile(self, source):
+        """Build one executable next to its source; returns its path"""
+        cxx = os.environ.get("CXX", "cl" if sys.platform == "win32" else "c++")
+        msvc = os.path.splitext(os.path.basename(cxx))[0].lower() == "cl"
+        target = os.path.splitext(source)[0]
+        if msvc:
+            target += ".exe"
+            command = [cxx, "/nologo", "/O2", "/std:c++17", "/EHsc", "/utf-8", source, "/Fe" + target]
+        else:
+            command = [cxx, "-O2", "-std=c++17", "-pthread", source, "-o", target]
+            if sys.platform == "darwin":
+                command.append("-liconv")
+        self.announce(" ".join(command), level=2)
+        subprocess.check_call(command)
+        return target
+
+
+class TestNative(BuildBenchmarks):
+    description = "build and run the C++ engine tests"
+    sources = tests
+
+    def run(self):
+        for source in self.sources:
+            subprocess.check_call([os.path.abspath(self.compile(source))])
+
+
 # Define the package
 setup(
     name="game-text-translator",
@@ -36,7 +105,7 @@ setup(
     long_description=open("README.md").read() if os.path.exists("README.md") else "",
     long_description_content_type="text/markdown",
     ext_modules=ext_modules,
-    cmdclass={"build_ext": build_ext},
+    cmdclass={"build_ext": build_ext, "build_benchmarks": BuildBenchmarks, "test_native": TestNative},
     zip_safe=False,
     python_requires=">=3.6",
     install_requires=[
@@ -0,0 +1,844 @@
+// Tests of the extraction engine that need no Python: each one writes a
+// small tree into a temporary directory, runs the engine on it and compares
+// the results with a second way of getting the same answer (the regex
+// engine, a single extraction of the whole tree, the source files with the
+// translations spliced in by hand).
+//
+// Build and run:
+//   c++ -O2 -std=c++17 -pthread test_extractor.cpp -o test_extractor
+//   ./test_extractor
+// (add -liconv on macOS). Exits with 1 if any check fails.
+
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "chunk_search.h"
+#include "text_extractor.h"
+#include "translation_memory.h"
+
+static size_t checks_failed = 0;
+
+#define CHECK(condition)                                                               \
+    do {                                                                               \
+        if (!(condition)) {                                                            \
+            std::printf("  %s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            checks_failed++;                                                           \
+        }                                                                              \
+    } while (0)
+
+// Temporary directory, removed again when the test is done
+class TempDir {
+public:
+    explicit TempDir(const std::string& name)
+        : root(fs::temp_directory_path() / ("gtx_test_" + name + "_" + std::to_string(std::random_device{}()))) {
+        fs::create_directories(root);
+    }
+
+    ~TempDir() {
+        std::error_code error;
+        fs::remove_all(root, error);
+    }
+
+    TempDir(const TempDir&) = delete;
+    TempDir& operator=(const TempDir&) = delete;
+
+    std::string path(const std::string& relative = std::string()) const {
+        return relative.empty() ? root.string() : (root / relative).string();
+    }
+
+private:
+    fs::path root;
+};
+
+static void write_file(const fs::path& path, const std::string& contents) {
+    fs::create_directories(path.parent_path());
+    std::ofstream out(path, std::ios::binary);
+    out << contents;
+}
+
+static std::string read_file(const fs::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+// Every regular file below `directory` by relative path, with its contents
+static std::map<std::string, std::string> read_tree(const fs::path& directory) {
+    std::map<std::string, std::string> tree;
+    for (const auto& entry : fs::recursive_directory_iterator(directory)) {
+        if (entry.is_regular_file()) {
+            tree[fs::relative(entry.path(), directory).generic_string()] = read_file(entry.path());
+        }
+    }
+    return tree;
+}
+
+// Everything a chunk reports, one line per chunk, for comparing two runs
+static std::string dump(const std::vector<TextExtractor::TextChunk>& chunks) {
+    std::string out;
+    for (const auto& chunk : chunks) {
+        out += chunk.file_path + "|" + std::to_string(chunk.line_number) + "|" +
+               std::to_string(chunk.column_start) + "|" + std::to_string(chunk.column_end) + "|" +
+               std::to_string(chunk.part_index) + "/" + std::to_string(chunk.part_count) + "|" + chunk.text + "|" +
+               std::string(chunk.original_text()) + "|" + std::string(chunk.context()) + "\n";
+    }
+    return out;
+}
+
+// Texts of `chunks` by file name, in order
+static std::map<std::string, std::vector<std::string>> texts_by_file(
+    const std::vector<TextExtractor::TextChunk>& chunks) {
+    std::map<std::string, std::vector<std::string>> texts;
+    for (const auto& chunk : chunks) {
+        texts[fs::path(chunk.file_path).filename().string()].push_back(chunk.text);
+    }
+    return texts;
+}
+
+// A tree of script, JSON and XML files under `root`, so walks, format
+// extractors and the master file all have something to do. Every text is
+// unique and free of escapes, which the apply test relies on.
+static void write_project(const std::string& root, size_t files) {
+    for (size_t f = 0; f < files; f++) {
+        std::string id = std::to_string(f);
+        std::string dir = "chapter" + std::to_string(f % 4) + "/scene" + std::to_string(f % 3);
+        write_file(fs::path(root) / dir / ("script" + id + ".lua"),
+                   "-- script " + id + "\n"
+                   "say(\"Welcome to town number " + id + "\")\n"
+                   "local label = 'Open the gate " + id + "'\n"
+                   "menu { text = \"Start game " + id + "\", help = \"Ends the turn " + id + "\" }\n");
+        write_file(fs::path(root) / dir / ("dialogue" + id + ".json"),
+                   "{\"name\": \"Guard " + id + "\", \"lines\": [\"Halt, traveller " + id +
+                   "\", \"Move along " + id + "\"]}\n");
+        if (f % 2 == 0) {
+            write_file(fs::path(root) / dir / ("strings" + id + ".xml"),
+                       "<strings>\n  <text>Inventory is full " + id + "</text>\n  <title>Chapter title " + id +
+                       "</title>\n</strings>\n");
+        }
+    }
+    // Shared texts, for the deduplicated master file
+    write_file(fs::path(root) / "common.lua", "say(\"Yes\")\nsay(\"Welcome to town number 0\")\n");
+}
+
+// ---- Scanner vs. regex engine ----
+
+// Random lines built from the pieces the patterns care about: quotes,
+// escapes, keys with either separator and open and close tags, so partial
+// and overlapping matches come up often
+static std::string random_source(std::mt19937& rng, size_t lines) {
+    static const char* pieces[] = {
+        "\"", "'", "\\", "\\\"", "\\'", " ", "  ", "\t", ":", "=", " = ", ": ", "text", "label", "name",
+        "Title", "value", "content", "<text>", "</text>", "<title>", "</title>", "<name>", "</name>",
+        "<", ">", "</", "Hello world", "abc", "x", "\xC3\xA9t\xC3\xA9", "\xE3\x81\x82\xE3\x81\x84", "{", "}",
+        ",", ";", "(", ")", "text:\"", "label='", "<value>Done</value>",
+    };
+    std::uniform_int_distribution<size_t> piece(0, sizeof(pieces) / sizeof(pieces[0]) - 1);
+    std::uniform_int_distribution<size_t> length(0, 24);
+    std::string out;
+    for (size_t l = 0; l < lines; l++) {
+        for (size_t n = length(rng); n > 0; n--) {
+            out += pieces[piece(rng)];
+        }
+        out += '\n';
+    }
+    return out;
+}
+
+static void test_scanner_matches_regex() {
+    TempDir dir("scanner");
+    std::mt19937 rng{20240611};
+    for (size_t f = 0; f < 40; f++) {
+        write_file(dir.path("f" + std::to_string(f) + (f % 2 ? ".txt" : ".lua")), random_source(rng, 200));
+    }
+
+    auto extract = [&](const std::string& engine, const std::vector<std::string>& keys,
+                       const std::vector<std::string>& tags) {
+        TextExtractor extractor;
+        extractor.set_scan_engine(engine);
+        if (!keys.empty()) {
+            extractor.set_text_keys(keys);
+            extractor.set_text_tags(tags);
+        }
+        return dump(extractor.extract_texts(dir.path()).chunks);
+    };
+    std::string scanner = extract("scanner", {}, {});
+    CHECK(!scanner.empty());
+    CHECK(scanner == extract("regex", {}, {}));
+    // Keys that are prefixes of each other share trie nodes
+    std::vector<std::string> keys = {"text", "te", "title", "Title", "label"};
+    std::vector<std::string> tags = {"text", "t", "name", "value"};
+    CHECK(extract("scanner", keys, tags) == extract("regex", keys, tags));
+}
+
+// Which keys and tags are configured decides what matches, on both engines
+static void test_custom_keys_and_tags() {
+    TempDir dir("keywords");
+    write_file(dir.path("menu.lua"), "<line>Good morning</line>\nsubtitle: \"Sub line\"\n");
+    for (const char* engine : {"scanner", "regex"}) {
+        TextExtractor extractor;
+        extractor.set_scan_engine(engine);
+        auto count = [&](const std::string& text) {
+            size_t n = 0;
+            for (const auto& chunk : extractor.extract_texts(dir.path()).chunks) {
+                n += chunk.text == text;
+            }
+            return n;
+        };
+        // A key also matches at the end of a longer word; the quoted value
+        // is a chunk of its own as well
+        extractor.set_text_keys({"title"});
+        extractor.set_text_tags({"line"});
+        CHECK(count("Good morning") == 1);
+        CHECK(count("Sub line") == 2);
+        extractor.set_text_keys({"name"});
+        extractor.set_text_tags({"text"});
+        CHECK(count("Good morning") == 0);
+        CHECK(count("Sub line") == 1);
+
+        // Names that would need escaping are rejected and change nothing
+        for (const char* bad : {"bad key", "a|b", "(", ""}) {
+            bool rejected = false;
+            try {
+                extractor.set_text_keys({bad});
+            } catch (const std::invalid_argument&) {
+                rejected = true;
+            }
+            CHECK(rejected);
+        }
+        CHECK(extractor.get_text_keys() == std::vector<std::string>{"name"});
+    }
+}
+
+// ---- Apply round trip ----
+
+// Fill in every translation of a master file as "TR " + the original
+static void translate_master_file(const std::string& path) {
+    std::istringstream in(read_file(path));
+    std::string out, line, original;
+    while (std::getline(in, line)) {
+        if (line.compare(0, 10, "Original: ") == 0) {
+            original = line.substr(10);
+        } else if (line.compare(0, 13, "Translation: ") == 0) {
+            line = "Translation: TR " + original;
+        }
+        out += line + "\n";
+    }
+    write_file(path, out);
+}
+
+static void test_apply_round_trip() {
+    for (bool deduplicate : {false, true}) {
+        TempDir dir("apply");
+        write_project(dir.path("game"), 6);
+        TextExtractor extractor;
+        extractor.set_deduplicate(deduplicate);
+        auto result = extractor.extract_texts(dir.path("game"));
+        extractor.save_extracted_texts(result.chunks, dir.path("texts"));
+        translate_master_file(dir.path("texts/master_translation.txt"));
+
+        size_t applied = extractor.apply_translations(dir.path("texts/master_translation.txt"), dir.path("out"));
+
+        // A text matched by two patterns (`label = '...'`) is one chunk per
+        // pattern at the same place, and is replaced once
+        std::set<std::tuple<std::string, size_t, size_t>> locations;
+        for (const auto& chunk : result.chunks) {
+            locations.emplace(chunk.file_path, chunk.line_number, chunk.column_start);
+        }
+        CHECK(applied == locations.size());
+
+        // The output is the source with each original text prefixed in place
+        std::map<std::string, std::string> expected = read_tree(dir.path("game"));
+        for (const auto& [file_path, line_number, column_start] : locations) {
+            std::string relative = fs::relative(file_path, dir.path("game")).generic_string();
+            std::string& contents = expected[relative];
+            size_t line_start = 0;
+            for (size_t line = 1; line < line_number; line++) {
+                line_start = contents.find('\n', line_start) + 1;
+            }
+            // Later texts of the line have moved by the prefixes before them
+            size_t shift = 0;
+            for (const auto& [other_path, other_line, other_column] : locations) {
+                if (other_path == file_path && other_line == line_number && other_column < column_start) {
+                    shift += 3;
+                }
+            }
+            contents.insert(line_start + column_start + shift, "TR ");
+        }
+        CHECK(read_tree(dir.path("out")) == expected);
+
+        // The translated tree extracts to the translations on the same lines
+        auto translated = extractor.extract_texts(dir.path("out"));
+        CHECK(translated.chunks.size() == result.chunks.size());
+        for (size_t i = 0; i < std::min(translated.chunks.size(), result.chunks.size()); i++) {
+            CHECK(translated.chunks[i].text == "TR " + result.chunks[i].text);
+            CHECK(translated.chunks[i].line_number == result.chunks[i].line_number);
+        }
+    }
+}
+
+// ---- Encodings ----
+
+// UTF-8 text of characters below U+10000 as UTF-16
+static std::string utf16(const std::string& utf8, bool big_endian) {
+    std::string out;
+    for (size_t i = 0; i < utf8.size();) {
+        unsigned char lead = static_cast<unsigned char>(utf8[i]);
+        uint32_t cp = lead;
+        size_t length = lead < 0x80 ? 1 : lead < 0xE0 ? 2 : 3;
+        if (length == 2) {
+            cp = (lead & 0x1F) << 6 | (utf8[i + 1] & 0x3F);
+        } else if (length == 3) {
+            cp = (lead & 0x0F) << 12 | (utf8[i + 1] & 0x3F) << 6 | (utf8[i + 2] & 0x3F);
+        }
+        char high = static_cast<char>(cp >> 8);
+        char low = static_cast<char>(cp & 0xFF);
+        out += big_endian ? high : low;
+        out += big_endian ? low : high;
+        i += length;
+    }
+    return out;
+}
+
+// The same script in each supported encoding extracts to the same UTF-8
+// texts, with columns in bytes of the file, and applies back in its encoding
+static void test_encodings() {
+    using text_encoding::Encoding;
+    TempDir dir("encodings");
+    // "こんにちは" in UTF-8 and in Shift-JIS
+    const std::string hello_utf8 = "\xE3\x81\x93\xE3\x82\x93\xE3\x81\xAB\xE3\x81\xA1\xE3\x81\xAF";
+    const std::string hello_sjis = "\x82\xB1\x82\xF1\x82\xC9\x82\xBF\x82\xCD";
+    auto script = [](const std::string& prefix, const std::string& hello) {
+        return "say(\"" + prefix + "Hello there\")\nsay(\"" + prefix + hello + "\")\n";
+    };
+
+    struct Case {
+        std::string name;
+        Encoding encoding;
+        size_t unit;   // Bytes per ASCII character
+        std::function<std::string(const std::string&)> encode;
+    };
+    std::vector<Case> cases = {
+        {"utf8.lua", Encoding::Utf8, 1, [&](const std::string& p) { return script(p, hello_utf8); }},
+        {"utf8_bom.lua", Encoding::Utf8Bom, 1,
+         [&](const std::string& p) { return "\xEF\xBB\xBF" + script(p, hello_utf8); }},
+        {"utf16le.lua", Encoding::Utf16LE, 2,
+         [&](const std::string& p) { return "\xFF\xFE" + utf16(script(p, hello_utf8), false); }},
+        {"utf16be.lua", Encoding::Utf16BE, 2,
+         [&](const std::string& p) { return "\xFE\xFF" + utf16(script(p, hello_utf8), true); }},
+        {"utf16le_no_bom.lua", Encoding::Utf16LE, 2,
+         [&](const std::string& p) { return utf16(script(p, hello_utf8), false); }},
+    };
+    if (text_encoding::ShiftJisTable::instance().available()) {
+        cases.push_back({"shift_jis.lua", Encoding::ShiftJis, 1,
+                         [&](const std::string& p) { return script(p, hello_sjis); }});
+    }
+    for (const Case& c : cases) {
+        write_file(dir.path("game/" + c.name), c.encode(""));
+        CHECK(text_encoding::detect(c.encode("")) == c.encoding);
+    }
+
+    TextExtractor extractor;
+    auto result = extractor.extract_texts(dir.path("game"));
+    auto texts = texts_by_file(result.chunks);
+    CHECK(texts.size() == cases.size());
+    for (const Case& c : cases) {
+        CHECK((texts[c.name] == std::vector<std::string>{"Hello there", hello_utf8}));
+    }
+    for (const auto& chunk : result.chunks) {
+        for (const Case& c : cases) {
+            if (fs::path(chunk.file_path).filename() == c.name && chunk.line_number == 2) {
+                CHECK(chunk.column_start == 5 * c.unit);
+            }
+        }
+    }
+
+    extractor.save_extracted_texts(result.chunks, dir.path("texts"));
+    translate_master_file(dir.path("texts/master_translation.txt"));
+    extractor.apply_translations(dir.path("texts/master_translation.txt"), dir.path("out"));
+    for (const Case& c : cases) {
+        CHECK(read_file(dir.path("out/" + c.name)) == c.encode("TR "));
+    }
+
+    bool rejected = false;
+    try {
+        extractor.set_input_encoding("latin-9");
+    } catch (const std::invalid_argument&) {
+        rejected = true;
+    }
+    CHECK(rejected);
+    CHECK(extractor.get_input_encoding() == "auto");
+}
+
+// ---- Format extractors ----
+
+// Each format reports its texts and leaves out keys, ids, numbers, colors
+// and paths; applying escapes the translations the way the format does
+static void test_format_extractors() {
+    TempDir dir("formats");
+    write_file(dir.path("game/dialogue.json"),
+               "{\n"
+               "  // Opening scene\n"
+               "  \"title\": \"Brave knight\",\n"
+               "  \"id\": \"3f2b8c1e-9d4a-4e7b-8c2d-1a5f6e7d8c9b\",\n"
+               "  \"color\": \"#ff00aa\",\n"
+               "  \"icon\": \"textures/ui/knight.png\",\n"
+               "  \"lines\": [\"Where am I?\", \"Go home\"]\n"
+               "}\n");
+    write_file(dir.path("game/dialogue.xml"),
+               "<dialog>\n"
+               "  <line speaker=\"guard_01\" text=\"Open the door\">Bread &amp; water</line>\n"
+               "  <count>12</count>\n"
+               "</dialog>\n");
+    write_file(dir.path("game/strings.csv"),
+               "id,english,notes\n"
+               "menu_start,Start game,\"Shown on the title, in caps\"\n");
+    write_file(dir.path("game/config.yaml"),
+               "title: Dragon tales\n"
+               "version: 1.2\n"
+               "items:\n"
+               "  - Healing potion\n"
+               "  - 'Magic sword'\n"
+               "description: |\n"
+               "  Block scalars are not written back\n");
+    write_file(dir.path("game/button.prefab"),
+               "MonoBehaviour:\n"
+               "  m_Name: StartButton\n"
+               "  m_Text: Press start\n");
+
+    std::map<std::string, std::vector<std::string>> expected = {
+        {"dialogue.json", {"Brave knight", "Where am I?", "Go home"}},
+        {"dialogue.xml", {"Open the door", "Bread & water"}},
+        {"strings.csv", {"Start game", "Shown on the title, in caps"}},
+        {"config.yaml", {"Dragon tales", "Healing potion", "Magic sword"}},
+        {"button.prefab", {"Press start"}},
+    };
+    TextExtractor extractor;
+    auto result = extractor.extract_texts(dir.path("game"));
+    CHECK(texts_by_file(result.chunks) == expected);
+
+    extractor.save_extracted_texts(result.chunks, dir.path("texts"));
+    translate_master_file(dir.path("texts/master_translation.txt"));
+    extractor.apply_translations(dir.path("texts/master_translation.txt"), dir.path("out"));
+    for (auto& [file, texts] : expected) {
+        for (std::string& text : texts) {
+            text = "TR " + text;
+        }
+    }
+    CHECK(texts_by_file(extractor.extract_texts(dir.path("out")).chunks) == expected);
+    CHECK(read_file(dir.path("out/dialogue.xml")).find(">TR Bread &amp; water<") != std::string::npos);
+    CHECK(read_file(dir.path("out/strings.csv")).find(",\"TR Shown on the title, in caps\"") != std::string::npos);
+}
+
+// ---- Index write and merge ----
+
+static void test_index_round_trip() {
+    TempDir dir("index");
+    write_project(dir.path("game"), 12);
+    TextExtractor extractor;
+    auto result = extractor.extract_texts(dir.path("game"));
+    CHECK(ExtractionIndex::write(dir.path("full.gtxi"), result.chunks, dir.path("game")));
+
+    ExtractionIndex index(dir.path("full.gtxi"));
+    CHECK(index.source_root() == dir.path("game"));
+    CHECK(index.get_chunk_count() == result.chunks.size());
+    CHECK(dump(index.chunks()) == dump(result.chunks));
+}
+
+static void test_index_merge() {
+    TempDir dir("merge");
+    write_project(dir.path("game"), 12);
+    const std::string root = dir.path("game");
+    TextExtractor full;
+    auto all = full.extract_texts(root);
+    CHECK(ExtractionIndex::write(dir.path("full.gtxi"), all.chunks, root));
+
+    const size_t shards = 3;
+    std::vector<std::string> parts;
+    for (size_t s = 0; s < shards; s++) {
+        TextExtractor extractor;
+        extractor.set_shard(s, shards);
+        auto part = extractor.extract_texts(root);
+        parts.push_back(dir.path("part" + std::to_string(s) + ".gtxi"));
+        CHECK(ExtractionIndex::write(parts.back(), part.chunks, root));
+    }
+    // An input given twice only counts as duplicate files
+    parts.push_back(parts[1]);
+    auto merged = ExtractionIndex::merge(dir.path("merged.gtxi"), parts);
+    CHECK(merged.chunks == all.chunks.size());
+    CHECK(merged.duplicate_files > 0);
+    CHECK(read_file(dir.path("merged.gtxi")) == read_file(dir.path("full.gtxi")));
+
+    // The master file and per-file output of the merge match a single run
+    ExtractionIndex index(dir.path("merged.gtxi"));
+    for (bool deduplicate : {false, true}) {
+        TextExtractor saver;
+        saver.set_deduplicate(deduplicate);
+        std::string suffix = deduplicate ? "_dedup" : "";
+        saver.save_extracted_texts(all.chunks, dir.path("full" + suffix));
+        saver.save_extracted_texts(index.chunks(), dir.path("merged" + suffix));
+        CHECK(read_tree(dir.path("merged" + suffix)) == read_tree(dir.path("full" + suffix)));
+    }
+}
+
+// Indexes saved without a root record the deepest directory of their own
+// files, which differs between shards; merging them used to rebase paths
+// onto the wrong directory. Empty shards have no root at all.
+static void test_index_merge_roots() {
+    TempDir dir("merge_roots");
+    write_project(dir.path("game"), 2);
+    const std::string root = dir.path("game");
+    TextExtractor full;
+    auto all = full.extract_texts(root);
+    CHECK(ExtractionIndex::write(dir.path("full.gtxi"), all.chunks, root));
+
+    // Many more shards than files, so most are empty; the empty ones go first
+    const size_t shards = 16;
+    std::vector<std::pair<size_t, std::string>> parts;
+    for (size_t s = 0; s < shards; s++) {
+        TextExtractor extractor;
+        extractor.set_shard(s, shards);
+        auto part = extractor.extract_texts(root);
+        parts.emplace_back(part.chunks.size(), dir.path("part" + std::to_string(s) + ".gtxi"));
+        CHECK(ExtractionIndex::write(parts.back().second, part.chunks, root));
+    }
+    std::stable_sort(parts.begin(), parts.end());
+    CHECK(parts.front().first == 0);
+    std::vector<std::string> inputs;
+    for (const auto& part : parts) {
+        inputs.push_back(part.second);
+    }
+    ExtractionIndex::merge(dir.path("merged.gtxi"), inputs);
+    CHECK(read_file(dir.path("merged.gtxi")) == read_file(dir.path("full.gtxi")));
+
+    // An empty index saved without a root does not take part in the root check
+    CHECK(ExtractionIndex::write(dir.path("empty.gtxi"), {}, ""));
+    inputs.insert(inputs.begin(), dir.path("empty.gtxi"));
+    ExtractionIndex::merge(dir.path("merged.gtxi"), inputs);
+    CHECK(read_file(dir.path("merged.gtxi")) == read_file(dir.path("full.gtxi")));
+
+    // Without roots, an input with only chapter0/scene0 and one with the
+    // whole tree get different roots and are rejected
+    std::vector<TextExtractor::TextChunk> scene;
+    for (const auto& chunk : all.chunks) {
+        if (chunk.file_path.find("scene0") != std::string::npos) {
+            scene.push_back(chunk);
+        }
+    }
+    CHECK(!scene.empty() && all.chunks.size() > scene.size());
+    CHECK(ExtractionIndex::write(dir.path("scene.gtxi"), scene, ""));
+    CHECK(ExtractionIndex::write(dir.path("tree.gtxi"), all.chunks, ""));
+    CHECK(ExtractionIndex(dir.path("scene.gtxi")).source_root() !=
+          ExtractionIndex(dir.path("tree.gtxi")).source_root());
+    bool rejected = false;
+    try {
+        ExtractionIndex::merge(dir.path("bad.gtxi"), {dir.path("scene.gtxi"), dir.path("tree.gtxi")});
+    } catch (const std::invalid_argument&) {
+        rejected = true;
+    }
+    CHECK(rejected);
+    CHECK(!fs::exists(dir.path("bad.gtxi")));
+}
+
+// ---- Size limit ----
+
+// Files over max_file_size are listed as skipped without being read, with
+// every way of reading files
+static void test_size_limit() {
+    TempDir dir("size");
+    const std::string small = "say(\"Small file\")\n";
+    std::string large;
+    for (int i = 0; i < 100; i++) {
+        large += "say(\"Large file line " + std::to_string(i) + "\")\n";
+    }
+    write_file(dir.path("game/a.lua"), small);
+    write_file(dir.path("game/b.lua"), large);
+    for (const char* mode : {"sync", "threads", "cache"}) {
+        TextExtractor extractor;
+        extractor.set_max_file_size(small.size() * 2);
+        if (std::string(mode) == "cache") {
+            extractor.set_cache_file(dir.path("cache.bin"));
+        } else {
+            extractor.set_io_backend(mode);
+        }
+        auto result = extractor.extract_texts(dir.path("game"));
+        CHECK(result.chunks.size() == 1);
+        CHECK(result.stats.files_read == 1);
+        CHECK(result.stats.bytes_read == small.size());
+        CHECK(result.stats.skipped_files.size() == 1);
+        if (result.stats.skipped_files.size() == 1) {
+            const auto& skipped = result.stats.skipped_files[0];
+            CHECK(fs::path(skipped.file_path).filename() == "b.lua");
+            CHECK(skipped.reason == "size");
+            CHECK(skipped.bytes == large.size());
+        }
+    }
+}
+
+// ---- extract_to_directory ----
+
+static void test_extract_to_directory() {
+    TempDir dir("stream");
+    write_project(dir.path("game"), 30);
+    for (bool deduplicate : {false, true}) {
+        for (size_t threads : {1, 4}) {
+            TextExtractor extractor;
+            extractor.set_deduplicate(deduplicate);
+            extractor.set_num_threads(threads);
+            auto result = extractor.extract_texts(dir.path("game"));
+            extractor.save_extracted_texts(result.chunks, dir.path("saved"));
+
+            auto streamed = extractor.extract_to_directory(dir.path("game"), dir.path("streamed"));
+            CHECK(streamed.total_texts_found == result.chunks.size());
+            CHECK(streamed.total_files_processed == result.total_files_processed);
+            CHECK(!fs::exists(dir.path("streamed/.extracting")));
+            CHECK(read_tree(dir.path("streamed")) == read_tree(dir.path("saved")));
+
+            fs::remove_all(dir.path("saved"));
+            fs::remove_all(dir.path("streamed"));
+        }
+    }
+}
+
+// A throwing prepare used to leave its slot unfilled, and the consumer
+// waited for it forever
+static void test_ordered_extraction_rethrows() {
+    TempDir dir("ordered");
+    write_project(dir.path("game"), 30);
+    for (size_t threads : {1, 4}) {
+        TextExtractor extractor;
+        extractor.set_num_threads(threads);
+        std::vector<std::string> files = extractor.scan_directory(dir.path("game"));
+        const size_t failing = files.size() / 2;
+        size_t emitted = 0;
+        bool thrown = false;
+        try {
+            extractor.extract_files_ordered(files, [&](size_t i, std::vector<TextExtractor::TextChunk>&) {
+                CHECK(i == emitted);
+                emitted++;
+                return true;
+            }, [&](size_t i, std::vector<TextExtractor::TextChunk>&) {
+                if (i == failing) {
+                    throw std::runtime_error("prepare failed");
+                }
+            });
+        } catch (const std::runtime_error& e) {
+            thrown = std::string(e.what()) == "prepare failed";
+        }
+        CHECK(thrown);
+        CHECK(emitted == failing);
+    }
+}
+
+// ---- Translation memory ----
+
+// Edit distance between two ASCII texts
+static size_t edit_distance(const std::string& a, const std::string& b) {
+    std::vector<size_t> row(b.size() + 1);
+    for (size_t j = 0; j <= b.size(); j++) {
+        row[j] = j;
+    }
+    for (size_t i = 1; i <= a.size(); i++) {
+        size_t diagonal = row[0];
+        row[0] = i;
+        for (size_t j = 1; j <= b.size(); j++) {
+            size_t above = row[j];
+            row[j] = std::min({row[j] + 1, row[j - 1] + 1, diagonal + (a[i - 1] != b[j - 1])});
+            diagonal = above;
+        }
+    }
+    return row[b.size()];
+}
+
+// Lookups in a small memory find the best match a brute-force scan finds,
+// and a saved memory answers the same as the one it was saved from
+static void test_translation_memory() {
+    TempDir dir("memory");
+    std::unordered_map<std::string, std::string> translations;
+    const char* items[] = {"Potion", "Ether", "Phoenix down", "Iron sword", "Leather boots"};
+    for (const char* item : items) {
+        for (int n = 1; n <= 9; n += 2) {
+            std::string source = std::string(item) + " x" + std::to_string(n);
+            translations[source] = "TR " + source;
+        }
+    }
+    for (int n = 0; n < 40; n++) {
+        std::string source = "Open the gate of town number " + std::to_string(n * 7);
+        translations[source] = "TR " + source;
+    }
+    auto memory = TranslationMemory::build(translations, 2);
+    CHECK(memory->size() == translations.size());
+    for (size_t i = 0; i < memory->size(); i++) {
+        CHECK(translations[std::string(memory->source(i))] == memory->translation(i));
+    }
+    CHECK(memory->save(dir.path("memory.gtxm")));
+    TranslationMemory opened(dir.path("memory.gtxm"));
+    CHECK(opened.size() == memory->size());
+
+    const std::vector<std::string> queries = {
+        "Potion x1", "Potion x2", "Ether x4", "Phoenix downs", "Iron swords x3", "Open the gate of town number 15",
+        "open the gate of town number 14", "Leather", "Something else entirely",
+    };
+    for (const std::string& query : queries) {
+        double best = 0;
+        for (const auto& [source, translation] : translations) {
+            double score = 1.0 - double(edit_distance(query, source)) / std::max(query.size(), source.size());
+            best = std::max(best, score);
+        }
+        auto matches = memory->lookup(query, 3, 0.6);
+        if (best < 0.6) {
+            CHECK(matches.empty());
+            continue;
+        }
+        CHECK(!matches.empty() && matches.size() <= 3);
+        CHECK(!matches.empty() && std::abs(matches.front().score - best) < 1e-9);
+        for (size_t m = 0; m < matches.size(); m++) {
+            CHECK(matches[m].score >= 0.6);
+            CHECK(m == 0 || matches[m - 1].score >= matches[m].score);
+            CHECK(matches[m].translation == translations[matches[m].source]);
+        }
+
+        auto reopened = opened.lookup(query, 3, 0.6);
+        CHECK(reopened.size() == matches.size());
+        for (size_t m = 0; m < std::min(reopened.size(), matches.size()); m++) {
+            CHECK(reopened[m].source == matches[m].source);
+            CHECK(reopened[m].score == matches[m].score);
+        }
+    }
+    CHECK(memory->lookup("Potion x1", 1, 1.0).front().translation == "TR Potion x1");
+}
+
+// ---- Chunk search ----
+
+static std::string fold_ascii(std::string text) {
+    for (char& ch : text) {
+        if (ch >= 'A' && ch <= 'Z') {
+            ch = static_cast<char>(ch - 'A' + 'a');
+        }
+    }
+    return text;
+}
+
+// Every query of the index gives the chunks a plain loop over them accepts
+static void test_chunk_search() {
+    TempDir dir("search");
+    write_project(dir.path("game"), 30);
+    TextExtractor extractor;
+    auto chunks = extractor.extract_texts(dir.path("game")).chunks;
+    ChunkStore store(chunks);
+    ChunkSearchIndex index(store, 2);
+    std::set<std::string> translated = {"Yes", "Start game 3", "Move along 12"};
+    index.set_translated(std::vector<std::string>(translated.begin(), translated.end()));
+
+    auto brute_force = [&](const ChunkSearchIndex::Query& query) {
+        std::vector<uint32_t> found;
+        auto flags = std::regex::ECMAScript | (query.case_sensitive ? std::regex::flag_type() : std::regex::icase);
+        std::regex pattern(query.regex ? query.text : "", flags);
+        for (size_t i = 0; i < chunks.size(); i++) {
+            const auto& chunk = chunks[i];
+            bool text_ok = query.regex ? std::regex_search(chunk.text, pattern)
+                           : query.case_sensitive
+                               ? chunk.text.find(query.text) != std::string::npos
+                               : fold_ascii(chunk.text).find(fold_ascii(query.text)) != std::string::npos;
+            bool file_ok = query.case_sensitive ? chunk.file_path.find(query.file) != std::string::npos
+                                                : fold_ascii(chunk.file_path).find(fold_ascii(query.file)) !=
+                                                      std::string::npos;
+            bool line_ok = chunk.line_number >= query.first_line &&
+                           (query.last_line == 0 || chunk.line_number <= query.last_line);
+            if (text_ok && file_ok && line_ok && !(query.untranslated_only && translated.count(chunk.text))) {
+                found.push_back(static_cast<uint32_t>(i));
+            }
+        }
+        return found;
+    };
+
+    size_t queries = 0;
+    for (const char* text : {"", "e", "Ga", "gate", "GATE 1", "number 2", "Welcome to town", "zzz"}) {
+        for (bool case_sensitive : {false, true}) {
+            for (const char* file : {"", "SCENE1", "dialogue"}) {
+                for (size_t last_line : {0, 2}) {
+                    for (bool untranslated_only : {false, true}) {
+                        ChunkSearchIndex::Query query;
+                        query.text = text;
+                        query.case_sensitive = case_sensitive;
+                        query.file = file;
+                        query.first_line = last_line ? 2 : 0;
+                        query.last_line = last_line;
+                        query.untranslated_only = untranslated_only;
+                        CHECK(index.search(query) == brute_force(query));
+                        queries++;
+                    }
+                }
+            }
+        }
+    }
+    for (const char* pattern : {"^Start game [0-9]$", "gate (1|2)", "TOWN"}) {
+        for (bool case_sensitive : {false, true}) {
+            ChunkSearchIndex::Query query;
+            query.text = pattern;
+            query.regex = true;
+            query.case_sensitive = case_sensitive;
+            CHECK(index.search(query) == brute_force(query));
+            queries++;
+        }
+    }
+    CHECK(queries > 0);
+
+    // A chunk marked translated leaves the untranslated list, and comes back
+    ChunkSearchIndex::Query untranslated;
+    untranslated.untranslated_only = true;
+    size_t before = index.search(untranslated).size();
+    CHECK(index.mark_translated("Halt, traveller 4"));
+    CHECK(index.search(untranslated).size() == before - 1);
+    CHECK(index.mark_translated("Halt, traveller 4", false));
+    CHECK(index.search(untranslated).size() == before);
+    CHECK(!index.mark_translated("not a text of the store"));
+
+    bool rejected = false;
+    ChunkSearchIndex::Query bad;
+    bad.text = "(";
+    bad.regex = true;
+    try {
+        index.search(bad);
+    } catch (const std::invalid_argument&) {
+        rejected = true;
+    }
+    CHECK(rejected);
+}
+
+int main() {
+    struct Test {
+        const char* name;
+        void (*run)();
+    };
+    const Test tests[] = {
+        {"scanner_matches_regex", test_scanner_matches_regex},
+        {"custom_keys_and_tags", test_custom_keys_and_tags},
+        {"apply_round_trip", test_apply_round_trip},
+        {"encodings", test_encodings},
+        {"format_extractors", test_format_extractors},
+        {"index_round_trip", test_index_round_trip},
+        {"index_merge", test_index_merge},
+        {"index_merge_roots", test_index_merge_roots},
+        {"size_limit", test_size_limit},
+        {"extract_to_directory", test_extract_to_directory},
+        {"ordered_extraction_rethrows", test_ordered_extraction_rethrows},
+        {"translation_memory", test_translation_memory},
+        {"chunk_search", test_chunk_search},
+    };
+    for (const Test& test : tests) {
+        size_t failed_before = checks_failed;
+        std::printf("%s\n", test.name);
+        test.run();
+        if (checks_failed != failed_before) {
+            std::printf("  FAILED\n");
+        }
+    }
+    std::printf("%zu check(s) failed\n", checks_failed);
+    return checks_failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,575 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TEXT_ENCODING_SSE2 1
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+#include <arm_neon.h>
+#define TEXT_ENCODING_NEON 1
+#endif
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <iconv.h>
+#endif
+
+// Detection of a file's text encoding and conversion to UTF-8 before
+// scanning. Conversions keep a map from UTF-8 offsets back to byte offsets
+// in the original file, so positions can be reported in original bytes.
+// Kept free of pybind11 like text_unescape.h.
+
+namespace text_encoding {
+
+enum class Encoding {
+    Utf8,       // Also used for anything not recognised; scanned as is
+    Utf8Bom,
+    Utf16LE,
+    Utf16BE,
+    ShiftJis,   // Windows code page 932, the Shift-JIS variant games use
+};
+
+inline const char* encoding_name(Encoding encoding) {
+    switch (encoding) {
+        case Encoding::Utf8: return "utf-8";
+        case Encoding::Utf8Bom: return "utf-8-sig";
+        case Encoding::Utf16LE: return "utf-16le";
+        case Encoding::Utf16BE: return "utf-16be";
+        case Encoding::ShiftJis: return "shift_jis";
+    }
+    return "utf-8";
+}
+
+// Length of the run of ASCII bytes at the start of `data`
+inline size_t ascii_prefix(const char* data, size_t size) {
+    size_t pos = 0;
+#if defined(TEXT_ENCODING_SSE2)
+    for (; pos + 16 <= size; pos += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+        int high_bits = _mm_movemask_epi8(block);
+        if (high_bits != 0) {
+            for (int bit = 0; bit < 16; bit++) {
+                if (high_bits & (1 << bit)) {
+                    return pos + bit;
+                }
+            }
+        }
+    }
+#elif defined(TEXT_ENCODING_NEON)
+    for (; pos + 16 <= size; pos += 16) {
+        uint8x16_t block = vld1q_u8(reinterpret_cast<const uint8_t*>(data + pos));
+        if (vmaxvq_u8(block) >= 0x80) {
+            break;
+        }
+    }
+#else
+    for (; pos + 8 <= size; pos += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + pos, 8);
+        if (word & 0x8080808080808080ULL) {
+            break;
+        }
+    }
+#endif
+    while (pos < size && static_cast<unsigned char>(data[pos]) < 0x80) {
+        pos++;
+    }
+    return pos;
+}
+
+// Length of the run of ASCII code units at the start of UTF-16 `data`
+// (in bytes, always even)
+inline size_t ascii_prefix_utf16(const char* data, size_t size, bool big_endian) {
+    size_t pos = 0;
+#if defined(TEXT_ENCODING_SSE2)
+    // A unit is ASCII when its high byte is zero and its low byte is below 0x80
+    const __m128i mask = big_endian ? _mm_set1_epi16(static_cast<short>(0x80FF))
+                                    : _mm_set1_epi16(static_cast<short>(0xFF80));
+    for (; pos + 16 <= size; pos += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+        __m128i bad = _mm_and_si128(block, mask);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(bad, _mm_setzero_si128())) != 0xFFFF) {
+            break;
+        }
+    }
+#else
+    const uint64_t mask = big_endian ? 0x80FF80FF80FF80FFULL : 0xFF80FF80FF80FF80ULL;
+    for (; pos + 8 <= size; pos += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + pos, 8);
+        if (word & mask) {
+            break;
+        }
+    }
+#endif
+    while (pos + 2 <= size) {
+        unsigned char high = static_cast<unsigned char>(data[pos + (big_endian ? 0 : 1)]);
+        unsigned char low = static_cast<unsigned char>(data[pos + (big_endian ? 1 : 0)]);
+        if (high != 0 || low >= 0x80) {
+            break;
+        }
+        pos += 2;
+    }
+    return pos;
+}
+
+// Length of the UTF-8 sequence starting at `data[pos]`, 0 if it is invalid
+inline size_t utf8_sequence_length(std::string_view data, size_t pos) {
+    unsigned char lead = static_cast<unsigned char>(data[pos]);
+    size_t length;
+    uint32_t min;
+    if (lead < 0x80) {
+        return 1;
+    } else if (lead >= 0xC2 && lead <= 0xDF) {
+        length = 2;
+        min = 0x80;
+    } else if (lead >= 0xE0 && lead <= 0xEF) {
+        length = 3;
+        min = 0x800;
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+        length = 4;
+        min = 0x10000;
+    } else {
+        return 0;
+    }
+    if (pos + length > data.size()) {
+        return 0;
+    }
+    uint32_t cp = lead & (0x7F >> length);
+    for (size_t i = 1; i < length; i++) {
+        unsigned char ch = static_cast<unsigned char>(data[pos + i]);
+        if ((ch & 0xC0) != 0x80) {
+            return 0;
+        }
+        cp = (cp << 6) | (ch & 0x3F);
+    }
+    if (cp < min || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) {
+        return 0;
+    }
+    return length;
+}
+
+inline bool is_valid_utf8(std::string_view data) {
+    size_t pos = 0;
+    while (pos < data.size()) {
+        pos += ascii_prefix(data.data() + pos, data.size() - pos);
+        if (pos >= data.size()) {
+            break;
+        }
+        size_t length = utf8_sequence_length(data, pos);
+        if (length == 0) {
+            return false;
+        }
+        pos += length;
+    }
+    return true;
+}
+
+inline void append_utf8(std::string& out, uint32_t cp) {
+    if (cp < 0x80) {
+        out.push_back(static_cast<char>(cp));
+    } else if (cp < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else {
+        out.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+}
+
+// Code page 932 tables, built once from the platform converter (iconv or
+// MultiByteToWideChar) so decoding is a table lookup per character
+class ShiftJisTable {
+public:
+    static const ShiftJisTable& instance() {
+        static const ShiftJisTable table;
+        return table;
+    }
+
+    bool available() const {
+        return loaded;
+    }
+
+    static bool is_lead_byte(unsigned char ch) {
+        return (ch >= 0x81 && ch <= 0x9F) || (ch >= 0xE0 && ch <= 0xFC);
+    }
+
+    static bool is_trail_byte(unsigned char ch) {
+        return ch >= 0x40 && ch <= 0xFC && ch != 0x7F;
+    }
+
+    // Code point of a two-byte character, 0 if unmapped
+    uint16_t decode_pair(unsigned char lead, unsigned char trail) const {
+        return double_byte[(static_cast<size_t>(lead) << 8) | trail];
+    }
+
+    // Code point of a single byte, 0 if it is not a character on its own
+    static uint16_t decode_single(unsigned char ch) {
+        if (ch < 0x80) {
+            return ch;
+        }
+        if (ch >= 0xA1 && ch <= 0xDF) {
+            return static_cast<uint16_t>(0xFF61 + (ch - 0xA1));   // Half-width katakana
+        }
+        return 0;
+    }
+
+    // Bytes for `cp`, or an empty string if code page 932 has no such character
+    std::string encode(uint32_t cp) const {
+        if (cp < 0x80) {
+            return std::string(1, static_cast<char>(cp));
+        }
+        if (cp >= 0xFF61 && cp <= 0xFF9F) {
+            return std::string(1, static_cast<char>(0xA1 + (cp - 0xFF61)));
+        }
+        auto found = reverse.find(cp);
+        if (found == reverse.end()) {
+            return std::string();
+        }
+        char bytes[2] = {static_cast<char>(found->second >> 8), static_cast<char>(found->second & 0xFF)};
+        return std::string(bytes, 2);
+    }
+
+private:
+    std::vector<uint16_t> double_byte;
+    std::unordered_map<uint32_t, uint16_t> reverse;
+    bool loaded = false;
+
+    ShiftJisTable() : double_byte(65536, 0) {
+#ifdef _WIN32
+        auto convert = [](const char* bytes) -> uint16_t {
+            wchar_t wide[2];
+            int length = MultiByteToWideChar(932, MB_ERR_INVALID_CHARS, bytes, 2, wide, 2);
+            return length == 1 ? static_cast<uint16_t>(wide[0]) : 0;
+        };
+#else
+        iconv_t cd = iconv_open("UTF-32LE", "CP932");
+        if (cd == reinterpret_cast<iconv_t>(-1)) {
+            cd = iconv_open("UTF-32LE", "SHIFT_JIS");
+        }
+        if (cd == reinterpret_cast<iconv_t>(-1)) {
+            return;
+        }
+        auto convert = [cd](const char* bytes) -> uint16_t {
+            char in_bytes[2] = {bytes[0], bytes[1]};
+            unsigned char out_bytes[8];
+            char* in = in_bytes;
+            char* out = reinterpret_cast<char*>(out_bytes);
+            size_t in_left = 2;
+            size_t out_left = sizeof(out_bytes);
+            iconv(cd, nullptr, nullptr, nullptr, nullptr);
+            if (iconv(cd, &in, &in_left, &out, &out_left) == static_cast<size_t>(-1) ||
+                sizeof(out_bytes) - out_left != 4) {
+                return 0;
+            }
+            uint32_t cp = out_bytes[0] | (out_bytes[1] << 8) | (out_bytes[2] << 16) |
+                          (static_cast<uint32_t>(out_bytes[3]) << 24);
+            return cp < 0x10000 ? static_cast<uint16_t>(cp) : 0;
+        };
+#endif
+        for (unsigned lead = 0x81; lead <= 0xFC; lead++) {
+            if (!is_lead_byte(static_cast<unsigned char>(lead))) {
+                continue;
+            }
+            for (unsigned trail = 0x40; trail <= 0xFC; trail++) {
+                if (!is_trail_byte(static_cast<unsigned char>(trail))) {
+                    continue;
+                }
+                char bytes[2] = {static_cast<char>(lead), static_cast<char>(trail)};
+                uint16_t cp = convert(bytes);
+                if (cp != 0) {
+                    uint16_t code = static_cast<uint16_t>((lead << 8) | trail);
+                    double_byte[code] = cp;
+                    // Several codes share a character (NEC and IBM extensions); keep the first
+                    reverse.emplace(cp, code);
+                }
+            }
+        }
+#ifndef _WIN32
+        iconv_close(cd);
+#endif
+        loaded = true;
+    }
+};
+
+// Maps offsets in converted UTF-8 text back to byte offsets in the original.
+// Anchors are recorded after every non-ASCII character; between anchors each
+// ASCII byte stands for `unit` source bytes (1, or 2 for UTF-16).
+class OffsetMap {
+public:
+    OffsetMap() = default;
+    OffsetMap(size_t source_start, size_t unit) : unit(unit) {
+        anchors.emplace_back(0, source_start);
+    }
+
+    void add(size_t utf8_offset, size_t source_offset) {
+        anchors.emplace_back(utf8_offset, source_offset);
+    }
+
+    // `utf8_offset` must be on a character boundary
+    size_t to_source(size_t utf8_offset) const {
+        if (anchors.empty()) {
+            return utf8_offset;
+        }
+        // Last anchor at or before the offset
+        size_t low = 0;
+        size_t high = anchors.size();
+        while (high - low > 1) {
+            size_t mid = (low + high) / 2;
+            if (anchors[mid].first <= utf8_offset) {
+                low = mid;
+            } else {
+                high = mid;
+            }
+        }
+        return anchors[low].second + (utf8_offset - anchors[low].first) * unit;
+    }
+
+    // Inverse of to_source(); `source_offset` must be on a character boundary
+    size_t to_utf8(size_t source_offset) const {
+        if (anchors.empty()) {
+            return source_offset;
+        }
+        size_t low = 0;
+        size_t high = anchors.size();
+        while (high - low > 1) {
+            size_t mid = (low + high) / 2;
+            if (anchors[mid].second <= source_offset) {
+                low = mid;
+            } else {
+                high = mid;
+            }
+        }
+        if (source_offset < anchors[low].second) {
+            return 0;
+        }
+        return anchors[low].first + (source_offset - anchors[low].second) / unit;
+    }
+
+private:
+    std::vector<std::pair<size_t, size_t>> anchors;
+    size_t unit = 1;
+};
+
+// Guess the encoding: a BOM decides; otherwise BOM-less UTF-16 (many zero
+// bytes on one side), then valid UTF-8, then Shift-JIS if every byte
+// sequence is a valid code page 932 character.
+inline Encoding detect(std::string_view data) {
+    if (data.size() >= 3 && data.compare(0, 3, "\xEF\xBB\xBF") == 0) {
+        return Encoding::Utf8Bom;
+    }
+    if (data.size() >= 2 && data.compare(0, 2, "\xFF\xFE") == 0) {
+        return Encoding::Utf16LE;
+    }
+    if (data.size() >= 2 && data.compare(0, 2, "\xFE\xFF") == 0) {
+        return Encoding::Utf16BE;
+    }
+    // ASCII-heavy UTF-16 has a zero in every other byte (which is valid
+    // UTF-8, so this is checked first)
+    if (data.size() % 2 == 0 && !data.empty()) {
+        size_t sample = std::min<size_t>(data.size(), 4096);
+        size_t even_zeros = 0;
+        size_t odd_zeros = 0;
+        for (size_t i = 0; i < sample; i++) {
+            if (data[i] == 0) {
+                (i % 2 == 0 ? even_zeros : odd_zeros)++;
+            }
+        }
+        size_t pairs = sample / 2;
+        if (odd_zeros * 10 > pairs * 4 && even_zeros * 10 < pairs) {
+            return Encoding::Utf16LE;
+        }
+        if (even_zeros * 10 > pairs * 4 && odd_zeros * 10 < pairs) {
+            return Encoding::Utf16BE;
+        }
+    }
+    if (is_valid_utf8(data)) {
+        return Encoding::Utf8;
+    }
+
+    const ShiftJisTable& sjis = ShiftJisTable::instance();
+    if (sjis.available()) {
+        size_t pos = 0;
+        bool valid = true;
+        while (pos < data.size() && valid) {
+            pos += ascii_prefix(data.data() + pos, data.size() - pos);
+            if (pos >= data.size()) {
+                break;
+            }
+            unsigned char ch = static_cast<unsigned char>(data[pos]);
+            if (ShiftJisTable::decode_single(ch) != 0) {
+                pos++;
+            } else if (ShiftJisTable::is_lead_byte(ch) && pos + 1 < data.size() &&
+                       sjis.decode_pair(ch, static_cast<unsigned char>(data[pos + 1])) != 0) {
+                pos += 2;
+            } else {
+                valid = false;
+            }
+        }
+        if (valid) {
+            return Encoding::ShiftJis;
+        }
+    }
+    return Encoding::Utf8;
+}
+
+// Result of converting a file to UTF-8
+struct DecodedText {
+    std::string utf8;
+    OffsetMap map;
+};
+
+// Convert `data` (including any BOM) to UTF-8. Invalid sequences become
+// U+FFFD. Must not be called for Encoding::Utf8, which needs no conversion.
+inline void decode(std::string_view data, Encoding encoding, DecodedText& out) {
+    out.utf8.clear();
+    out.utf8.reserve(data.size() + data.size() / 2);
+    const char* bytes = data.data();
+    size_t pos = 0;
+
+    if (encoding == Encoding::Utf8Bom) {
+        pos = data.size() >= 3 && data.compare(0, 3, "\xEF\xBB\xBF") == 0 ? 3 : 0;
+        out.map = OffsetMap(pos, 1);
+        out.utf8.append(bytes + pos, data.size() - pos);
+        return;
+    }
+
+    if (encoding == Encoding::Utf16LE || encoding == Encoding::Utf16BE) {
+        bool big_endian = encoding == Encoding::Utf16BE;
+        if (data.size() >= 2 && data.compare(0, 2, big_endian ? "\xFE\xFF" : "\xFF\xFE") == 0) {
+            pos = 2;
+        }
+        out.map = OffsetMap(pos, 2);
+        auto unit_at = [&](size_t at) -> uint32_t {
+            unsigned char first = static_cast<unsigned char>(bytes[at]);
+            unsigned char second = static_cast<unsigned char>(bytes[at + 1]);
+            return big_endian ? (first << 8) | second : (second << 8) | first;
+        };
+        while (pos + 2 <= data.size()) {
+            // Copy ASCII runs by narrowing the units
+            size_t run = ascii_prefix_utf16(bytes + pos, data.size() - pos, big_endian);
+            for (size_t i = 0; i < run; i += 2) {
+                out.utf8.push_back(bytes[pos + i + (big_endian ? 1 : 0)]);
+            }
+            pos += run;
+            if (pos + 2 > data.size()) {
+                break;
+            }
+
+            uint32_t cp = unit_at(pos);
+            pos += 2;
+            if (cp >= 0xD800 && cp <= 0xDBFF && pos + 2 <= data.size()) {
+                uint32_t low = unit_at(pos);
+                if (low >= 0xDC00 && low <= 0xDFFF) {
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                    pos += 2;
+                } else {
+                    cp = 0xFFFD;
+                }
+            } else if (cp >= 0xD800 && cp <= 0xDFFF) {
+                cp = 0xFFFD;
+            }
+            append_utf8(out.utf8, cp);
+            out.map.add(out.utf8.size(), pos);
+        }
+        if (pos < data.size()) {
+            append_utf8(out.utf8, 0xFFFD);   // Odd trailing byte
+            out.map.add(out.utf8.size(), data.size());
+        }
+        return;
+    }
+
+    // Shift-JIS
+    const ShiftJisTable& sjis = ShiftJisTable::instance();
+    out.map = OffsetMap(0, 1);
+    while (pos < data.size()) {
+        size_t run = ascii_prefix(bytes + pos, data.size() - pos);
+        out.utf8.append(bytes + pos, run);
+        pos += run;
+        if (pos >= data.size()) {
+            break;
+        }
+        unsigned char ch = static_cast<unsigned char>(bytes[pos]);
+        uint32_t cp = ShiftJisTable::decode_single(ch);
+        size_t length = 1;
+        if (cp == 0 && ShiftJisTable::is_lead_byte(ch) && pos + 1 < data.size()) {
+            cp = sjis.decode_pair(ch, static_cast<unsigned char>(bytes[pos + 1]));
+            length = cp != 0 ? 2 : 1;
+        }
+        append_utf8(out.utf8, cp != 0 ? cp : 0xFFFD);
+        pos += length;
+        out.map.add(out.utf8.size(), pos);
+    }
+}
+
+// Convert UTF-8 text back to `encoding`, without a BOM. Returns false if a
+// character cannot be represented (only possible for Shift-JIS).
+inline bool encode(std::string_view utf8, Encoding encoding, std::string& out) {
+    out.clear();
+    if (encoding == Encoding::Utf8 || encoding == Encoding::Utf8Bom) {
+        out.assign(utf8.data(), utf8.size());
+        return true;
+    }
+    const ShiftJisTable* sjis = encoding == Encoding::ShiftJis ? &ShiftJisTable::instance() : nullptr;
+    bool big_endian = encoding == Encoding::Utf16BE;
+    auto put_unit = [&](uint32_t unit) {
+        char high = static_cast<char>(unit >> 8);
+        char low = static_cast<char>(unit & 0xFF);
+        out.push_back(big_endian ? high : low);
+        out.push_back(big_endian ? low : high);
+    };
+
+    size_t pos = 0;
+    while (pos < utf8.size()) {
+        size_t length = utf8_sequence_length(utf8, pos);
+        if (length == 0) {
+            return false;
+        }
+        uint32_t cp = static_cast<unsigned char>(utf8[pos]);
+        if (length > 1) {
+            cp &= 0x7F >> length;
+            for (size_t i = 1; i < length; i++) {
+                cp = (cp << 6) | (static_cast<unsigned char>(utf8[pos + i]) & 0x3F);
+            }
+        }
+        pos += length;
+
+        if (sjis) {
+            std::string bytes = sjis->encode(cp);
+            if (bytes.empty()) {
+                return false;
+            }
+            out += bytes;
+        } else if (cp >= 0x10000) {
+            cp -= 0x10000;
+            put_unit(0xD800 + (cp >> 10));
+            put_unit(0xDC00 + (cp & 0x3FF));
+        } else {
+            put_unit(cp);
+        }
+    }
+    return true;
+}
+
+}  // namespace text_encoding
@@ -1,372 +1,531 @@
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 #include <pybind11/numpy.h>
-#include <filesystem>
-#include <fstream>
-#include <string>
-#include <vector>
-#include <regex>
-#include <unordered_map>
-#include <chrono>
-#include <iostream>
-#include <algorithm>
+#include <pybind11/functional.h>
 
-namespace py = pybind11;
-namespace fs = std::filesystem;
+#include "text_extractor.h"
+#include "chunk_search.h"
+#include "translation_memory.h"
 
-class TextExtractor {
-private:
-    // Common text patterns in game files
-    std::vector<std::regex> text_patterns = {
-        std::regex(R"("([^"\\]*(\\.[^"\\]*)*)")"),  // Double quoted strings
-        std::regex(R"('([^'\\]*(\\.[^'\\]*)*)')"),  // Single quoted strings
-        std::regex(R"(text\s*[:=]\s*["']([^"']+)["'])"),  // text: "value"
-        std::regex(R"(label\s*[:=]\s*["']([^"']+)["'])"),  // label: "value"
-        std::regex(R"(message\s*[:=]\s*["']([^"']+)["'])"), // message: "value"
-        std::regex(R"(title\s*[:=]\s*["']([^"']+)["'])"),  // title: "value"
-        std::regex(R"(description\s*[:=]\s*["']([^"']+)["'])"), // description: "value"
-        std::regex(R"(name\s*[:=]\s*["']([^"']+)["'])"),   // name: "value"
-        std::regex(R"(value\s*[:=]\s*["']([^"']+)["'])"),  // value: "value"
-        std::regex(R"(content\s*[:=]\s*["']([^"']+)["'])"), // content: "value"
-        std::regex(R"(<text>([^<]+)</text>)"),  // XML-style text tags
-        std::regex(R"(<string>([^<]+)</string>)"), // XML string tags
-        std::regex(R"(<message>([^<]+)</message>)"), // XML message tags
-        std::regex(R"(<label>([^<]+)</label>)"), // XML label tags
-        std::regex(R"(<title>([^<]+)</title>)"), // XML title tags
-        std::regex(R"(<description>([^<]+)</description>)"), // XML description tags
-        std::regex(R"(<name>([^<]+)</name>)"), // XML name tags
-        std::regex(R"(<value>([^<]+)</value>)"), // XML value tags
-        std::regex(R"(<content>([^<]+)</content>)") // XML content tags
-    };
-    
-    // File extensions to process (can be set dynamically)
-    std::vector<std::string> supported_extensions = {
-        ".csv", ".erb", ".erh", ".py", ".cpp", ".c", ".h", ".hpp", ".cs", ".java", ".js", ".ts", ".jsx", ".tsx",
-        ".xml", ".json", ".yaml", ".yml", ".ini", ".cfg", ".txt", ".lua", ".rpy",
-        ".unity", ".prefab", ".asset", ".scene", ".csproj", ".sln"
-    };
-    
-    // Minimum text length to extract
-    size_t min_text_length = 3;
-    
-    // Maximum text length per chunk
-    size_t max_chunk_size = 50000;
+namespace py = pybind11;
 
-public:
-    // Method to set supported file extensions
-    void set_supported_extensions(const std::vector<std::string>& extensions) {
-        supported_extensions = extensions;
+// str from UTF-8 bytes; invalid sequences (e.g. raw Shift-JIS) become U+FFFD instead of raising
+static py::str to_py_str(std::string_view value) {
+    PyObject* obj = PyUnicode_DecodeUTF8(value.data(), static_cast<Py_ssize_t>(value.size()), "replace");
+    if (!obj) {
+        throw py::error_already_set();
     }
+    return py::reinterpret_steal<py::str>(obj);
+}
+
+// Convert chunks to a list of dicts in one pass. Chunks from the same file
+// share one path object and chunks from the same line share one context
+// object, so the list costs little more than the texts themselves.
+static py::list chunks_to_dicts(const std::vector<TextExtractor::TextChunk>& chunks) {
+    const py::str text_key("text"), file_key("file_path"), line_key("line_number"),
+        start_key("column_start"), end_key("column_end"), context_key("context"), original_key("original_text"),
+        part_key("part_index"), part_count_key("part_count");
     
-    // Method to get current supported extensions
-    std::vector<std::string> get_supported_extensions() const {
-        return supported_extensions;
-    }
-    
-    struct TextChunk {
-        std::string text;
-        std::string file_path;
-        size_t line_number;
-        size_t column_start;
-        size_t column_end;
-        std::string context;
-        std::string original_text;
-    };
-    
-    struct ExtractionResult {
-        std::vector<TextChunk> chunks;
-        size_t total_files_processed;
-        size_t total_texts_found;
-        double processing_time;
-    };
+    py::list result(chunks.size());
+    py::str file_path;
+    const std::string* last_path = nullptr;
+    py::str context;
+    const TextExtractor::SourceText* last_source = nullptr;
+    size_t last_context_offset = 0;
     
-    // Fast file scanning with C++ filesystem
-    std::vector<std::string> scan_directory(const std::string& directory_path) {
-        std::vector<std::string> files;
-        
-        try {
-            for (const auto& entry : fs::recursive_directory_iterator(directory_path)) {
-                if (entry.is_regular_file()) {
-                    std::string file_path = entry.path().string();
-                    std::string extension = entry.path().extension().string();
-                    
-                    // Convert to lowercase for comparison
-                    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
-                    
-                    if (std::find(supported_extensions.begin(), supported_extensions.end(), extension) != supported_extensions.end()) {
-                        files.push_back(file_path);
-                    }
-                }
-            }
-        } catch (const std::exception& e) {
-            std::cerr << "Error scanning directory: " << e.what() << std::endl;
+    for (size_t i = 0; i < chunks.size(); i++) {
+        const auto& chunk = chunks[i];
+        if (!last_path || *last_path != chunk.file_path) {
+            file_path = to_py_str(chunk.file_path);
+            last_path = &chunk.file_path;
         }
-        
-        return files;
-    }
-    
-    // Fast text extraction from a single file
-    std::vector<TextChunk> extract_from_file(const std::string& file_path) {
-        std::vector<TextChunk> chunks;
-        
-        try {
-            std::ifstream file(file_path);
-            if (!file.is_open()) {
-                return chunks;
-            }
-            
-            std::string line;
-            size_t line_number = 0;
-            
-            while (std::getline(file, line)) {
-                line_number++;
-                
-                for (const auto& pattern : text_patterns) {
-                    std::sregex_iterator iter(line.begin(), line.end(), pattern);
-                    std::sregex_iterator end;
-                    
-                    for (; iter != end; ++iter) {
-                        std::smatch match = *iter;
-                        std::string text = match[1].str();
-                        
-                        // Clean up the text
-                        text = clean_text(text);
-                        
-                        if (text.length() >= min_text_length) {
-                            TextChunk chunk;
-                            chunk.text = text;
-                            chunk.file_path = file_path;
-                            chunk.line_number = line_number;
-                            chunk.column_start = match.position(1);
-                            chunk.column_end = match.position(1) + match.length(1);
-                            chunk.context = line;
-                            chunk.original_text = match.str();
-                            
-                            chunks.push_back(chunk);
-                        }
-                    }
-                }
-            }
-            
-            file.close();
-        } catch (const std::exception& e) {
-            std::cerr << "Error reading file " << file_path << ": " << e.what() << std::endl;
+        if (!last_source || last_source != chunk.source.get() || last_context_offset != chunk.context_offset) {
+            context = to_py_str(chunk.context());
+            last_source = chunk.source.get();
+            last_context_offset = chunk.context_offset;
         }
         
-        return chunks;
+        py::dict item;
+        item[text_key] = to_py_str(chunk.text);
+        item[file_key] = file_path;
+        item[line_key] = chunk.line_number;
+        item[start_key] = chunk.column_start;
+        item[end_key] = chunk.column_end;
+        item[context_key] = context;
+        item[original_key] = to_py_str(chunk.original_text());
+        item[part_key] = chunk.part_index;
+        item[part_count_key] = chunk.part_count;
+        result[i] = std::move(item);
     }
+    return result;
+}
+
+// Columnar export: NumPy arrays for the numeric fields, a file table, and
+// all texts in one contiguous UTF-8 buffer addressed by text_offsets
+// (text i is text_data[text_offsets[i]:text_offsets[i + 1]])
+static py::dict chunks_to_columns(const std::vector<TextExtractor::TextChunk>& chunks) {
+    const size_t count = chunks.size();
+    py::array_t<uint32_t> file_index(count);
+    py::array_t<uint64_t> line_number(count);
+    py::array_t<uint64_t> column_start(count);
+    py::array_t<uint64_t> column_end(count);
+    py::array_t<uint32_t> part_index(count);
+    py::array_t<uint32_t> part_count(count);
+    py::array_t<uint64_t> text_offsets(count + 1);
     
-    // Split text into chunks of specified size
-    std::vector<TextChunk> split_into_chunks(const std::vector<TextChunk>& chunks) {
-        std::vector<TextChunk> result;
-        
-        for (const auto& chunk : chunks) {
-            if (chunk.text.length() <= max_chunk_size) {
-                result.push_back(chunk);
-            } else {
-                // Split long text into smaller chunks
-                std::string text = chunk.text;
-                size_t start = 0;
-                size_t chunk_id = 0;
-                
-                while (start < text.length()) {
-                    size_t end = std::min(start + max_chunk_size, text.length());
-                    
-                    // Try to break at word boundary
-                    if (end < text.length()) {
-                        size_t last_space = text.rfind(' ', end);
-                        if (last_space != std::string::npos && last_space > start) {
-                            end = last_space;
-                        }
-                    }
-                    
-                    TextChunk new_chunk = chunk;
-                    new_chunk.text = text.substr(start, end - start);
-                    new_chunk.file_path += "_chunk_" + std::to_string(chunk_id);
-                    result.push_back(new_chunk);
-                    
-                    start = end;
-                    if (start < text.length() && text[start] == ' ') {
-                        start++; // Skip the space
-                    }
-                    chunk_id++;
-                }
-            }
-        }
-        
-        return result;
+    size_t text_bytes = 0;
+    for (const auto& chunk : chunks) {
+        text_bytes += chunk.text.size();
     }
+    py::array_t<uint8_t> text_data(text_bytes);
     
-    // Main extraction function
-    ExtractionResult extract_texts(const std::string& directory_path) {
-        auto start_time = std::chrono::high_resolution_clock::now();
-        
-        ExtractionResult result;
-        
-        // Scan directory for files
-        std::vector<std::string> files = scan_directory(directory_path);
-        result.total_files_processed = files.size();
-        
-        // Extract texts from all files
-        for (const auto& file_path : files) {
-            std::vector<TextChunk> file_chunks = extract_from_file(file_path);
-            result.chunks.insert(result.chunks.end(), file_chunks.begin(), file_chunks.end());
-        }
-        
-        // Split into manageable chunks
-        result.chunks = split_into_chunks(result.chunks);
-        result.total_texts_found = result.chunks.size();
-        
-        auto end_time = std::chrono::high_resolution_clock::now();
-        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
-        result.processing_time = duration.count() / 1000.0;
-        
-        return result;
-    }
+    uint32_t* file_out = file_index.mutable_data();
+    uint64_t* line_out = line_number.mutable_data();
+    uint64_t* start_out = column_start.mutable_data();
+    uint64_t* end_out = column_end.mutable_data();
+    uint32_t* part_out = part_index.mutable_data();
+    uint32_t* part_count_out = part_count.mutable_data();
+    uint64_t* offset_out = text_offsets.mutable_data();
+    uint8_t* data_out = text_data.mutable_data();
     
-    // Save extracted texts to files
-    void save_extracted_texts(const std::vector<TextChunk>& chunks, const std::string& output_dir) {
-        try {
-            fs::create_directories(output_dir);
-            
-            std::unordered_map<std::string, std::vector<TextChunk>> grouped_chunks;
-            
-            // Group chunks by file
-            for (const auto& chunk : chunks) {
-                grouped_chunks[chunk.file_path].push_back(chunk);
-            }
-            
-            // Save each file's chunks
-            for (const auto& pair : grouped_chunks) {
-                std::string filename = fs::path(pair.first).filename().string();
-                std::string output_file = output_dir + "/" + filename + "_extracted.txt";
-                
-                std::ofstream file(output_file);
-                if (file.is_open()) {
-                    file << "=== EXTRACTED TEXTS FROM: " << pair.first << " ===\n\n";
-                    
-                    for (const auto& chunk : pair.second) {
-                        file << "Line " << chunk.line_number << ":\n";
-                        file << "Context: " << chunk.context << "\n";
-                        file << "Text: " << chunk.text << "\n";
-                        file << "Original: " << chunk.original_text << "\n";
-                        file << "---\n\n";
-                    }
-                    
-                    file.close();
-                }
-            }
-            
-            // Save master translation file
-            std::string master_file = output_dir + "/master_translation.txt";
-            std::ofstream master(master_file);
-            if (master.is_open()) {
-                master << "=== MASTER TRANSLATION FILE ===\n\n";
-                
-                for (size_t i = 0; i < chunks.size(); i++) {
-                    master << "ID: " << i + 1 << "\n";
-                    master << "File: " << chunks[i].file_path << "\n";
-                    master << "Line: " << chunks[i].line_number << "\n";
-                    master << "Original: " << chunks[i].text << "\n";
-                    master << "Translation: \n";
-                    master << "---\n\n";
-                }
-                
-                master.close();
-            }
-            
-        } catch (const std::exception& e) {
-            std::cerr << "Error saving extracted texts: " << e.what() << std::endl;
+    py::list files;
+    std::unordered_map<std::string_view, uint32_t> file_ids;
+    size_t offset = 0;
+    for (size_t i = 0; i < count; i++) {
+        const auto& chunk = chunks[i];
+        auto inserted = file_ids.emplace(chunk.file_path, static_cast<uint32_t>(file_ids.size()));
+        if (inserted.second) {
+            files.append(to_py_str(chunk.file_path));
         }
-    }
-    
-    // Apply translations back to files
-    void apply_translations(const std::string& translation_file, const std::string& output_dir) {
-        try {
-            std::ifstream file(translation_file);
-            if (!file.is_open()) {
-                std::cerr << "Could not open translation file: " << translation_file << std::endl;
-                return;
-            }
-            
-            std::unordered_map<std::string, std::string> translations;
-            std::string line;
-            std::string current_id;
-            std::string current_original;
-            std::string current_translation;
-            
-            while (std::getline(file, line)) {
-                if (line.find("ID: ") == 0) {
-                    current_id = line.substr(4);
-                } else if (line.find("Original: ") == 0) {
-                    current_original = line.substr(10);
-                } else if (line.find("Translation: ") == 0) {
-                    current_translation = line.substr(13);
-                    if (!current_translation.empty() && current_translation != " ") {
-                        translations[current_original] = current_translation;
-                    }
-                }
-            }
-            
-            file.close();
-            
-            // Apply translations to files
-            for (const auto& pair : translations) {
-                std::cout << "Applying translation: " << pair.first << " -> " << pair.second << std::endl;
-            }
-            
-        } catch (const std::exception& e) {
-            std::cerr << "Error applying translations: " << e.what() << std::endl;
+        file_out[i] = inserted.first->second;
+        line_out[i] = chunk.line_number;
+        start_out[i] = chunk.column_start;
+        end_out[i] = chunk.column_end;
+        part_out[i] = static_cast<uint32_t>(chunk.part_index);
+        part_count_out[i] = static_cast<uint32_t>(chunk.part_count);
+        offset_out[i] = offset;
+        if (!chunk.text.empty()) {
+            std::memcpy(data_out + offset, chunk.text.data(), chunk.text.size());
         }
+        offset += chunk.text.size();
     }
+    offset_out[count] = offset;
+    
+    py::dict columns;
+    columns["files"] = files;
+    columns["file_index"] = file_index;
+    columns["line_number"] = line_number;
+    columns["column_start"] = column_start;
+    columns["column_end"] = column_end;
+    columns["part_index"] = part_index;
+    columns["part_count"] = part_count;
+    columns["text_offsets"] = text_offsets;
+    columns["text_data"] = text_data;
+    return columns;
+}
 
-private:
-    std::string clean_text(const std::string& text) {
-        std::string cleaned = text;
-        
-        // Remove escape sequences
-        cleaned = std::regex_replace(cleaned, std::regex(R"(\\n)"), "\n");
-        cleaned = std::regex_replace(cleaned, std::regex(R"(\\t)"), "\t");
-        cleaned = std::regex_replace(cleaned, std::regex(R"(\\r)"), "\r");
-        cleaned = std::regex_replace(cleaned, std::regex(R"(\\")"), "\"");
-        cleaned = std::regex_replace(cleaned, std::regex(R"(\\')"), "'");
-        cleaned = std::regex_replace(cleaned, std::regex(R"(\\\\)"), "\\");
-        
-        // Trim whitespace
-        cleaned.erase(cleaned.begin(), std::find_if(cleaned.begin(), cleaned.end(), [](unsigned char ch) {
-            return !std::isspace(ch);
-        }));
-        cleaned.erase(std::find_if(cleaned.rbegin(), cleaned.rend(), [](unsigned char ch) {
-            return !std::isspace(ch);
-        }).base(), cleaned.end());
-        
-        return cleaned;
+// A shard's own files do not tell where the tree starts, and indexes with
+// differing roots cannot be merged
+static void check_index_root(const TextExtractor& extractor, const std::string& source_root) {
+    if (extractor.get_shard_count() > 1 && source_root.empty()) {
+        throw std::invalid_argument("save_index of a sharded extraction needs source_root (the scanned directory)");
     }
-};
+}
 
 PYBIND11_MODULE(text_extractor, m) {
     m.doc() = "Fast text extraction and translation management for game localization";
     
     py::class_<TextExtractor>(m, "TextExtractor")
         .def(py::init<>())
-        .def("extract_texts", &TextExtractor::extract_texts, "Extract texts from directory")
-        .def("save_extracted_texts", &TextExtractor::save_extracted_texts, "Save extracted texts to files")
-        .def("apply_translations", &TextExtractor::apply_translations, "Apply translations to files")
+        .def("extract_texts", &TextExtractor::extract_texts, py::call_guard<py::gil_scoped_release>(),
+             "Extract texts from directory")
+        // ChunkStore overloads come first so that a store is never read as a sequence of chunks
+        .def("save_extracted_texts", [](TextExtractor& self, const ChunkStore& store, const std::string& output_dir) {
+                 self.save_extracted_texts(store.chunks(), output_dir);
+             }, py::arg("chunks"), py::arg("output_dir"), py::call_guard<py::gil_scoped_release>(),
+             "Save the texts of a ChunkStore to files")
+        .def("save_extracted_texts", &TextExtractor::save_extracted_texts, py::call_guard<py::gil_scoped_release>(),
+             "Save extracted texts to files")
+        .def("extract_to_directory", &TextExtractor::extract_to_directory, py::call_guard<py::gil_scoped_release>(),
+             "extract_texts followed by save_extracted_texts, writing each file as it is done; the result has no chunks",
+             py::arg("directory_path"), py::arg("output_dir"))
+        .def("save_index", [](TextExtractor& self, const ChunkStore& store, const std::string& index_file,
+                              const std::string& source_root) {
+                 check_index_root(self, source_root);
+                 return ExtractionIndex::write(index_file, store.chunks(), source_root);
+             }, py::arg("chunks"), py::arg("index_file"), py::arg("source_root") = std::string(),
+             py::call_guard<py::gil_scoped_release>(),
+             "Save the chunks of a ChunkStore to a binary index")
+        .def("save_index", [](TextExtractor& self, const std::vector<TextExtractor::TextChunk>& chunks,
+                              const std::string& index_file, const std::string& source_root) {
+                 check_index_root(self, source_root);
+                 return ExtractionIndex::write(index_file, chunks, source_root);
+             }, py::arg("chunks"), py::arg("index_file"), py::arg("source_root") = std::string(),
+             py::call_guard<py::gil_scoped_release>(),
+             "Save chunks to a binary index that ExtractionIndex opens without parsing")
+        .def("apply_translations", &TextExtractor::apply_translations, py::call_guard<py::gil_scoped_release>(),
+             "Write copies of the source files with the translations from a master file applied; returns texts applied")
+        .def("apply_translation_map", [](TextExtractor& self, const ChunkStore& store,
+                                         const std::unordered_map<std::string, std::string>& translations,
+                                         const std::string& output_dir) {
+                 return self.apply_translation_map(store.chunks(), translations, output_dir);
+             }, py::arg("chunks"), py::arg("translations"), py::arg("output_dir"),
+             py::call_guard<py::gil_scoped_release>(),
+             "apply_translation_map for the chunks of a ChunkStore")
+        .def("apply_translation_map", &TextExtractor::apply_translation_map, py::call_guard<py::gil_scoped_release>(),
+             py::arg("chunks"), py::arg("translations"), py::arg("output_dir"),
+             "Write copies of the chunks' source files with {original: translation} applied; returns texts applied")
         .def("set_supported_extensions", &TextExtractor::set_supported_extensions, "Set supported file extensions")
-        .def("get_supported_extensions", &TextExtractor::get_supported_extensions, "Get current supported file extensions");
+        .def("get_supported_extensions", &TextExtractor::get_supported_extensions, "Get current supported file extensions")
+        .def("set_excluded_directories", &TextExtractor::set_excluded_directories,
+             "Set directory glob patterns to skip (e.g. ['.git', 'Library', 'Assets/*/Temp'])")
+        .def("get_excluded_directories", &TextExtractor::get_excluded_directories, "Get excluded directory patterns")
+        .def("scan_directory", &TextExtractor::scan_directory, py::call_guard<py::gil_scoped_release>(),
+             "List supported files under a directory in walk order")
+        .def("set_deduplicate", &TextExtractor::set_deduplicate,
+             "List each distinct text once (with all its locations) in the master translation file")
+        .def("get_deduplicate", &TextExtractor::get_deduplicate, "Get whether the master file is deduplicated")
+        .def("set_input_encoding", &TextExtractor::set_input_encoding,
+             "Set input encoding: 'auto' (default), 'utf-8', 'utf-8-sig', 'utf-16le', 'utf-16be' or 'shift_jis'")
+        .def("get_input_encoding", &TextExtractor::get_input_encoding, "Get input encoding setting")
+        .def("detect_encoding", [](const TextExtractor&, const std::string& data) {
+                 return std::string(text_encoding::encoding_name(text_encoding::detect(data)));
+             }, "Guess the encoding of raw file contents (bytes)")
+        .def("set_text_keys", &TextExtractor::set_text_keys,
+             "Set the keys matched as key: \"value\" (e.g. add 'dialogue', 'tooltip')")
+        .def("get_text_keys", &TextExtractor::get_text_keys, "Get the keys matched as key: \"value\"")
+        .def("set_text_tags", &TextExtractor::set_text_tags, "Set the element names matched as <tag>value</tag>")
+        .def("get_text_tags", &TextExtractor::get_text_tags, "Get the element names matched as <tag>value</tag>")
+        .def("set_format_extractor", &TextExtractor::set_format_extractor,
+             "Set the extractor for an extension: 'json', 'xml', 'csv', 'yaml', 'unity' or 'patterns'",
+             py::arg("extension"), py::arg("format"))
+        .def("get_format_extractor", &TextExtractor::get_format_extractor,
+             "Get the extractor used for an extension ('patterns' if none)", py::arg("extension"))
+        .def("get_format_extractors", &TextExtractor::get_format_extractors,
+             "Get a dict of every extension with a format extractor and the extractor's name")
+        .def("set_scan_engine", &TextExtractor::set_scan_engine,
+             "Set matching engine for files without a format extractor: 'scanner' (default) or 'regex'")
+        .def("get_scan_engine", &TextExtractor::get_scan_engine, "Get current matching engine")
+        .def("set_num_threads", &TextExtractor::set_num_threads, "Set extraction worker threads (0 = all cores)")
+        .def("get_num_threads", &TextExtractor::get_num_threads, "Get extraction worker threads setting")
+        .def("set_mmap_threshold", &TextExtractor::set_mmap_threshold, "Set file size (bytes) from which files are memory-mapped")
+        .def("get_mmap_threshold", &TextExtractor::get_mmap_threshold, "Get memory-mapping file size threshold")
+        .def("set_io_backend", &TextExtractor::set_io_backend,
+             "How extract_texts reads files: 'sync', 'auto', 'io_uring', 'iocp' or 'threads'")
+        .def("get_io_backend", &TextExtractor::get_io_backend, "Get the file read backend ('auto' resolved)")
+        .def("set_io_depth", &TextExtractor::set_io_depth, "Set how many files asynchronous reads keep in flight")
+        .def("get_io_depth", &TextExtractor::get_io_depth, "Get asynchronous read depth")
+        .def("set_cache_file", &TextExtractor::set_cache_file, "Enable incremental extraction with a cache file ('' disables)")
+        .def("get_cache_file", &TextExtractor::get_cache_file, "Get incremental extraction cache file")
+        .def("set_cache_content_hash", &TextExtractor::set_cache_content_hash, "Also match cached files by content hash")
+        .def("get_cache_content_hash", &TextExtractor::get_cache_content_hash, "Get whether cached files are matched by content hash")
+        .def("set_progress_callback", &TextExtractor::set_progress_callback,
+             "Call callback(ExtractionProgress) every interval seconds during extract_texts (None disables)",
+             py::arg("callback"), py::arg("interval") = 0.5)
+        .def("get_progress_interval", &TextExtractor::get_progress_interval, "Get progress report interval in seconds")
+        .def("set_cancel_token", &TextExtractor::set_cancel_token,
+             "Stop extract_texts, extract_iter and scan_directory at the next file once the token is cancelled (None disables)")
+        .def("get_cancel_token", &TextExtractor::get_cancel_token, "Get the cancellation token")
+        .def("set_skip_binary_files", &TextExtractor::set_skip_binary_files,
+             "Skip files with NUL bytes, mostly control characters or a binary Unity header")
+        .def("get_skip_binary_files", &TextExtractor::get_skip_binary_files, "Get whether binary files are skipped")
+        .def("set_max_file_size", &TextExtractor::set_max_file_size, "Skip files larger than this many bytes (0 = no limit)")
+        .def("get_max_file_size", &TextExtractor::get_max_file_size, "Get maximum file size in bytes")
+        .def("set_max_line_length", &TextExtractor::set_max_line_length,
+             "Scan only the first this many bytes of longer lines (0 = no limit)")
+        .def("get_max_line_length", &TextExtractor::get_max_line_length, "Get maximum scanned line length in bytes")
+        .def("set_shard", &TextExtractor::set_shard, py::arg("index"), py::arg("count"),
+             "Walk only shard index of count: the files whose relative path hashes to it")
+        .def("get_shard_index", &TextExtractor::get_shard_index, "Get the shard this extractor walks")
+        .def("get_shard_count", &TextExtractor::get_shard_count, "Get the number of shards the tree is split into")
+        .def_static("shard_of", &TextExtractor::shard_of, py::arg("relative_path"), py::arg("count"),
+                    "Shard of a file from its '/'-separated path relative to the scanned directory")
+        .def("set_slowest_files", &TextExtractor::set_slowest_files, "Number of files listed in ExtractionStats.slowest_files")
+        .def("get_slowest_files", &TextExtractor::get_slowest_files, "Get number of slowest files reported")
+        .def("set_trace_file", &TextExtractor::set_trace_file,
+             "Write a Chrome trace (chrome://tracing, Perfetto) of every extract_texts to this file ('' disables)")
+        .def("get_trace_file", &TextExtractor::get_trace_file, "Get Chrome trace output file")
+        .def("extract_iter", [](TextExtractor& self, const std::string& directory_path, size_t batch_size) {
+                 return std::make_unique<ExtractionStream>(self, directory_path, batch_size);
+             }, py::arg("directory"), py::arg("batch_size") = 1000, py::keep_alive<0, 1>(),
+             "Iterate over extracted chunks in batches of batch_size (0 = one batch per file)");
     
+    py::class_<ExtractionStream>(m, "ExtractionStream")
+        .def("__iter__", [](py::object self) { return self; })
+        .def("__next__", [](ExtractionStream& self) {
+            std::vector<TextExtractor::TextChunk> batch;
+            bool has_batch;
+            {
+                py::gil_scoped_release release;
+                has_batch = self.next_batch(batch);
+            }
+            if (!has_batch) {
+                throw py::stop_iteration();
+            }
+            return batch;
+        })
+        .def("read_into", [](ExtractionStream& self, ChunkStore& store) {
+            std::vector<TextExtractor::TextChunk> batch;
+            bool has_batch;
+            {
+                py::gil_scoped_release release;
+                has_batch = self.next_batch(batch);
+            }
+            size_t count = batch.size();
+            if (has_batch) {
+                store.append(std::move(batch));
+            }
+            return count;
+        }, py::arg("store"), "Move the next batch into a ChunkStore; returns its size, 0 once extraction is finished")
+        .def("close", &ExtractionStream::close, py::call_guard<py::gil_scoped_release>(), "Stop extraction early")
+        .def_property_readonly("total_files", &ExtractionStream::get_total_files)
+        .def_property_readonly("files_processed", &ExtractionStream::get_files_processed)
+        .def_property_readonly("texts_found", &ExtractionStream::get_texts_found);
+    
+    // Strings are decoded like chunks_to_dicts, so invalid UTF-8 does not raise
     py::class_<TextExtractor::TextChunk>(m, "TextChunk")
-        .def_readonly("text", &TextExtractor::TextChunk::text)
-        .def_readonly("file_path", &TextExtractor::TextChunk::file_path)
+        .def_property_readonly("text", [](const TextExtractor::TextChunk& chunk) { return to_py_str(chunk.text); })
+        .def_property_readonly("file_path",
+                               [](const TextExtractor::TextChunk& chunk) { return to_py_str(chunk.file_path); })
         .def_readonly("line_number", &TextExtractor::TextChunk::line_number)
         .def_readonly("column_start", &TextExtractor::TextChunk::column_start)
         .def_readonly("column_end", &TextExtractor::TextChunk::column_end)
-        .def_readonly("context", &TextExtractor::TextChunk::context)
-        .def_readonly("original_text", &TextExtractor::TextChunk::original_text);
+        .def_readonly("part_index", &TextExtractor::TextChunk::part_index)
+        .def_readonly("part_count", &TextExtractor::TextChunk::part_count)
+        .def_property_readonly("context", [](const TextExtractor::TextChunk& chunk) { return to_py_str(chunk.context()); })
+        .def_property_readonly("original_text",
+                               [](const TextExtractor::TextChunk& chunk) { return to_py_str(chunk.original_text()); });
+    
+    py::class_<CancellationToken, std::shared_ptr<CancellationToken>>(m, "CancellationToken")
+        .def(py::init<>())
+        .def("cancel", &CancellationToken::cancel, "Ask the extraction using this token to stop at the next file")
+        .def("reset", &CancellationToken::reset, "Clear the token so it can be used for another extraction")
+        .def_property_readonly("cancelled", &CancellationToken::is_cancelled);
+    
+    py::class_<TextExtractor::ExtractionProgress>(m, "ExtractionProgress")
+        .def_readonly("files_found", &TextExtractor::ExtractionProgress::files_found)
+        .def_readonly("files_processed", &TextExtractor::ExtractionProgress::files_processed)
+        .def_readonly("bytes_read", &TextExtractor::ExtractionProgress::bytes_read)
+        .def_readonly("chunks_found", &TextExtractor::ExtractionProgress::chunks_found)
+        .def_readonly("elapsed_seconds", &TextExtractor::ExtractionProgress::elapsed_seconds)
+        .def_readonly("eta_seconds", &TextExtractor::ExtractionProgress::eta_seconds)
+        .def_readonly("finished", &TextExtractor::ExtractionProgress::finished);
+    
+    py::class_<TextExtractor::StageTime>(m, "StageTime")
+        .def_readonly("name", &TextExtractor::StageTime::name)
+        .def_readonly("wall_seconds", &TextExtractor::StageTime::wall_seconds)
+        .def_readonly("cpu_seconds", &TextExtractor::StageTime::cpu_seconds);
+    
+    py::class_<TextExtractor::FileTime>(m, "FileTime")
+        .def_readonly("file_path", &TextExtractor::FileTime::file_path)
+        .def_readonly("seconds", &TextExtractor::FileTime::seconds)
+        .def_readonly("bytes", &TextExtractor::FileTime::bytes)
+        .def_readonly("chunks", &TextExtractor::FileTime::chunks);
+    
+    py::class_<TextExtractor::SkippedFile>(m, "SkippedFile")
+        .def_readonly("file_path", &TextExtractor::SkippedFile::file_path)
+        .def_readonly("reason", &TextExtractor::SkippedFile::reason)
+        .def_readonly("bytes", &TextExtractor::SkippedFile::bytes);
+    
+    py::class_<TextExtractor::ThreadTime>(m, "ThreadTime")
+        .def_readonly("busy_seconds", &TextExtractor::ThreadTime::busy_seconds)
+        .def_readonly("files", &TextExtractor::ThreadTime::files)
+        .def_readonly("utilisation", &TextExtractor::ThreadTime::utilisation);
+    
+    py::class_<TextExtractor::ExtractionStats>(m, "ExtractionStats")
+        .def_readonly("stages", &TextExtractor::ExtractionStats::stages)
+        .def_readonly("walk_seconds", &TextExtractor::ExtractionStats::walk_seconds)
+        .def_readonly("read_seconds", &TextExtractor::ExtractionStats::read_seconds)
+        .def_readonly("decode_seconds", &TextExtractor::ExtractionStats::decode_seconds)
+        .def_readonly("scan_seconds", &TextExtractor::ExtractionStats::scan_seconds)
+        .def_readonly("bytes_read", &TextExtractor::ExtractionStats::bytes_read)
+        .def_readonly("files_read", &TextExtractor::ExtractionStats::files_read)
+        .def_readonly("pattern_matches", &TextExtractor::ExtractionStats::pattern_matches)
+        .def_readonly("format_matches", &TextExtractor::ExtractionStats::format_matches)
+        .def_readonly("slowest_files", &TextExtractor::ExtractionStats::slowest_files)
+        .def_readonly("skipped_files", &TextExtractor::ExtractionStats::skipped_files)
+        .def_readonly("lines_truncated", &TextExtractor::ExtractionStats::lines_truncated)
+        .def_readonly("threads", &TextExtractor::ExtractionStats::threads);
     
     py::class_<TextExtractor::ExtractionResult>(m, "ExtractionResult")
         .def_readonly("chunks", &TextExtractor::ExtractionResult::chunks)
         .def_readonly("total_files_processed", &TextExtractor::ExtractionResult::total_files_processed)
         .def_readonly("total_texts_found", &TextExtractor::ExtractionResult::total_texts_found)
-        .def_readonly("processing_time", &TextExtractor::ExtractionResult::processing_time);
+        .def_readonly("processing_time", &TextExtractor::ExtractionResult::processing_time)
+        .def_readonly("files_from_cache", &TextExtractor::ExtractionResult::files_from_cache)
+        .def_readonly("unique_texts_found", &TextExtractor::ExtractionResult::unique_texts_found)
+        .def_readonly("cancelled", &TextExtractor::ExtractionResult::cancelled)
+        .def_readonly("stats", &TextExtractor::ExtractionResult::stats)
+        .def("to_dicts", [](const TextExtractor::ExtractionResult& self) { return chunks_to_dicts(self.chunks); },
+             "Convert all chunks to a list of dicts in one pass")
+        .def("to_columns", [](const TextExtractor::ExtractionResult& self) { return chunks_to_columns(self.chunks); },
+             "Export chunks as NumPy columns plus one contiguous UTF-8 text buffer");
+    
+    py::class_<ExtractionIndex>(m, "ExtractionIndex")
+        .def(py::init<const std::string&>(), py::arg("path"), "Open (memory-map) a binary index written by save_index")
+        .def("__len__", &ExtractionIndex::get_chunk_count)
+        .def("__getitem__", [](const ExtractionIndex& self, long long index) {
+            if (index < 0) {
+                index += static_cast<long long>(self.get_chunk_count());
+            }
+            if (index < 0) {
+                throw py::index_error("index out of range");
+            }
+            return self.chunk(static_cast<size_t>(index));
+        })
+        .def_property_readonly("chunk_count", &ExtractionIndex::get_chunk_count)
+        .def_property_readonly("file_count", &ExtractionIndex::get_file_count)
+        .def_property_readonly("source_root", [](const ExtractionIndex& self) { return to_py_str(self.source_root()); })
+        .def("file_path", [](const ExtractionIndex& self, size_t index) { return to_py_str(self.file_path(index)); },
+             "Path of file i of the file table")
+        .def("text", [](const ExtractionIndex& self, size_t index) { return to_py_str(self.record(index).text); },
+             "Text of chunk i, without building a TextChunk")
+        .def("chunks", &ExtractionIndex::chunks, py::call_guard<py::gil_scoped_release>(),
+             "Load all chunks as TextChunk objects")
+        .def_static("merge", &ExtractionIndex::merge, py::arg("path"), py::arg("inputs"),
+                    py::arg("source_root") = std::string(), py::call_guard<py::gil_scoped_release>(),
+                    "Merge the indexes of the shards of one tree into one, in the order of a single extraction");
+    
+    py::class_<ExtractionIndex::MergeResult>(m, "IndexMergeResult")
+        .def_readonly("files", &ExtractionIndex::MergeResult::files)
+        .def_readonly("chunks", &ExtractionIndex::MergeResult::chunks)
+        .def_readonly("duplicate_files", &ExtractionIndex::MergeResult::duplicate_files);
+    
+    py::class_<ChunkStore>(m, "ChunkStore")
+        .def(py::init<>())
+        .def(py::init<std::vector<TextExtractor::TextChunk>>(), py::arg("chunks"), "Store a list of TextChunk")
+        .def_static("from_index", [](const std::string& path) {
+            return std::make_unique<ChunkStore>(std::make_shared<const ExtractionIndex>(path));
+        }, py::arg("path"), "Open a binary index as a store; chunks are read from the mapped file on demand")
+        .def("append", [](ChunkStore& self, std::vector<TextExtractor::TextChunk> batch) {
+            self.append(std::move(batch));
+        }, py::arg("chunks"), "Add a list of TextChunk")
+        .def("__len__", &ChunkStore::size)
+        .def("text", [](const ChunkStore& self, size_t index) { return to_py_str(self.text(index)); },
+             "Text of chunk i, without building a TextChunk")
+        .def("chunk", &ChunkStore::chunk, py::arg("index"), "Chunk i as a TextChunk")
+        .def("get_range", &ChunkStore::get_range, py::arg("start"), py::arg("count"),
+             "Chunks [start, start + count) as TextChunk objects, fewer at the end of the store")
+        .def("previews", [](const ChunkStore& self, size_t start, size_t count, size_t max_chars) {
+            std::vector<std::string> lines = self.previews(start, count, max_chars);
+            py::list result(lines.size());
+            for (size_t i = 0; i < lines.size(); i++) {
+                result[i] = to_py_str(lines[i]);
+            }
+            return result;
+        }, py::arg("start"), py::arg("count"), py::arg("max_chars") = 100,
+           "List lines for chunks [start, start + count): texts longer than max_chars are cut and show their length")
+        .def("previews_of", [](const ChunkStore& self, const std::vector<size_t>& indices, size_t max_chars) {
+            std::vector<std::string> lines = self.previews_of(indices, max_chars);
+            py::list result(lines.size());
+            for (size_t i = 0; i < lines.size(); i++) {
+                result[i] = to_py_str(lines[i]);
+            }
+            return result;
+        }, py::arg("indices"), py::arg("max_chars") = 100, "previews for a list of chunk indices, e.g. search results")
+        .def("length_summary", &ChunkStore::length_summary, py::arg("thresholds") = std::vector<size_t>(),
+             py::call_guard<py::gil_scoped_release>(),
+             "Longest and total text length in characters, and the number of texts longer than each threshold")
+        .def("chunks", &ChunkStore::chunks, "All chunks as a list of TextChunk");
+    
+    py::class_<ChunkStore::LengthSummary>(m, "LengthSummary")
+        .def_readonly("max_chars", &ChunkStore::LengthSummary::max_chars)
+        .def_readonly("total_chars", &ChunkStore::LengthSummary::total_chars)
+        .def_readonly("longer_than", &ChunkStore::LengthSummary::longer_than);
+    
+    // The index keeps views of the store's texts, so it keeps the store alive
+    py::class_<ChunkSearchIndex>(m, "ChunkSearchIndex")
+        .def(py::init<const ChunkStore&, size_t>(), py::arg("store"), py::arg("threads") = 0, py::keep_alive<1, 2>(),
+             py::call_guard<py::gil_scoped_release>(),
+             "Index the chunks of a ChunkStore for search (threads 0 = all cores); the store must not grow afterwards")
+        .def("search", [](const ChunkSearchIndex& self, const std::string& text, bool regex, bool case_sensitive,
+                          const std::string& file, size_t first_line, size_t last_line, bool untranslated_only) {
+            ChunkSearchIndex::Query query;
+            query.text = text;
+            query.regex = regex;
+            query.case_sensitive = case_sensitive;
+            query.file = file;
+            query.first_line = first_line;
+            query.last_line = last_line;
+            query.untranslated_only = untranslated_only;
+            std::vector<uint32_t> indices;
+            {
+                py::gil_scoped_release release;
+                indices = self.search(query);
+            }
+            py::array_t<uint32_t> result(indices.size());
+            std::memcpy(result.mutable_data(), indices.data(), indices.size() * sizeof(uint32_t));
+            return result;
+        }, py::arg("text") = "", py::arg("regex") = false, py::arg("case_sensitive") = false, py::arg("file") = "",
+           py::arg("first_line") = 0, py::arg("last_line") = 0, py::arg("untranslated_only") = false,
+           "Indices of the chunks matching every given filter, ascending, as a NumPy uint32 array")
+        .def("mark_translated", &ChunkSearchIndex::mark_translated, py::arg("text"), py::arg("translated") = true,
+             "Mark the chunks with this text as translated or not; False if no chunk has it")
+        .def("set_translated", &ChunkSearchIndex::set_translated, py::arg("texts"),
+             py::call_guard<py::gil_scoped_release>(),
+             "Mark exactly the chunks with one of these texts as translated")
+        .def("__len__", &ChunkSearchIndex::get_chunk_count)
+        .def_property_readonly("text_count", &ChunkSearchIndex::get_text_count)
+        .def_property_readonly("file_count", &ChunkSearchIndex::get_file_count);
+    
+    py::class_<TranslationMemory>(m, "TranslationMemory")
+        .def(py::init<const std::string&>(), py::arg("path"), "Open (memory-map) a translation memory written by save")
+        .def_static("build", &TranslationMemory::build, py::arg("translations"), py::arg("threads") = 0,
+                    py::call_guard<py::gil_scoped_release>(),
+                    "Index a {source text: translation} dict for fuzzy lookup (threads 0 = all cores)")
+        .def("save", &TranslationMemory::save, py::arg("path"), py::call_guard<py::gil_scoped_release>(),
+             "Write the memory to a file that opens without parsing")
+        .def("__len__", &TranslationMemory::size)
+        .def("source", [](const TranslationMemory& self, size_t index) { return to_py_str(self.source(index)); },
+             "Source text of entry i")
+        .def("translation", [](const TranslationMemory& self, size_t index) { return to_py_str(self.translation(index)); },
+             "Translation of entry i")
+        .def("lookup", &TranslationMemory::lookup, py::arg("text"), py::arg("k") = 5, py::arg("min_score") = 0.6,
+             py::call_guard<py::gil_scoped_release>(),
+             "Up to k earlier translations of texts similar to text, best first")
+        .def("lookup_many", &TranslationMemory::lookup_many, py::arg("texts"), py::arg("k") = 5,
+             py::arg("min_score") = 0.6, py::arg("threads") = 0, py::call_guard<py::gil_scoped_release>(),
+             "lookup for a list of texts, in parallel");
+    
+    py::class_<TranslationMemory::Match>(m, "TranslationMatch")
+        .def_readonly("index", &TranslationMemory::Match::index)
+        .def_property_readonly("source", [](const TranslationMemory::Match& self) { return to_py_str(self.source); })
+        .def_property_readonly("translation",
+                               [](const TranslationMemory::Match& self) { return to_py_str(self.translation); })
+        .def_readonly("score", &TranslationMemory::Match::score);
+    
+    py::class_<TextExtractor::UniqueTexts>(m, "UniqueTexts")
+        .def("__len__", [](const TextExtractor::UniqueTexts& self) { return self.texts.size(); })
+        .def_property_readonly("texts", [](const TextExtractor::UniqueTexts& self) {
+            py::list texts(self.texts.size());
+            for (size_t i = 0; i < self.texts.size(); i++) {
+                texts[i] = to_py_str(self.texts[i]);
+            }
+            return texts;
+        })
+        .def_property_readonly("counts", [](const TextExtractor::UniqueTexts& self) {
+            py::array_t<uint64_t> counts(self.texts.size());
+            uint64_t* out = counts.mutable_data();
+            for (size_t i = 0; i < self.texts.size(); i++) {
+                out[i] = self.count(i);
+            }
+            return counts;
+        }, "Number of chunks with each text")
+        .def_property_readonly("text_ids", [](const TextExtractor::UniqueTexts& self) {
+            py::array_t<uint32_t> ids(self.text_ids.size());
+            std::memcpy(ids.mutable_data(), self.text_ids.data(), self.text_ids.size() * sizeof(uint32_t));
+            return ids;
+        }, "Id (index into texts) of every chunk")
+        .def("occurrences", [](const TextExtractor::UniqueTexts& self, size_t id) {
+            if (id >= self.texts.size()) {
+                throw py::index_error("text id out of range");
+            }
+            return std::vector<size_t>(self.occurrence_chunks.begin() + self.occurrence_offsets[id],
+                                       self.occurrence_chunks.begin() + self.occurrence_offsets[id + 1]);
+        }, "Indices of the chunks with text i");
+    
+    m.def("deduplicate", &TextExtractor::deduplicate_texts, py::call_guard<py::gil_scoped_release>(),
+          "Intern the texts of a list of TextChunk: distinct texts, counts and occurrences");
+    m.def("chunks_to_dicts", &chunks_to_dicts, "Convert a list of TextChunk to a list of dicts in one pass");
+    m.def("chunks_to_columns", &chunks_to_columns, "Export a list of TextChunk as NumPy columns");
 }
@@ -0,0 +1,4872 @@
+#pragma once
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <regex>
+#include <unordered_map>
+#include <chrono>
+#include <iostream>
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <queue>
+#include <functional>
+#include <memory>
+#include <iterator>
+#include <tuple>
+#include <utility>
+#include <optional>
+#include <map>
+#include <cstdint>
+#include <cstring>
+#include <cctype>
+#include <charconv>
+#include <cstdio>
+
+#include "async_io.h"
+#include "delimiter_scan.h"
+#include "format_extractors.h"
+#include "text_encoding.h"
+#include "text_unescape.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// The extraction engine: scanning, format extractors, caching, the master
+// translation file and the binary index. Kept free of pybind11 so native
+// tools such as benchmark_extraction.cpp can use it; the Python bindings
+// are in text_extractor.cpp.
+
+namespace fs = std::filesystem;
+
+// Trie over a set of words, read forwards or backwards. Bytes are mapped to
+// a dense alphabet of the bytes the words use, so each step is one table
+// lookup however many words there are.
+class KeywordTrie {
+public:
+    KeywordTrie() = default;
+
+    KeywordTrie(const std::vector<std::string>& words, bool reversed) {
+        alphabet.fill(0);
+        for (const auto& word : words) {
+            for (char ch : word) {
+                unsigned char byte = static_cast<unsigned char>(ch);
+                if (alphabet[byte] == 0) {
+                    alphabet[byte] = static_cast<uint16_t>(++alphabet_size);
+                }
+            }
+        }
+        edges.assign(stride(), 0);
+        for (size_t w = 0; w < words.size(); w++) {
+            uint32_t node = 0;
+            for (size_t i = 0; i < words[w].size(); i++) {
+                char ch = reversed ? words[w][words[w].size() - 1 - i] : words[w][i];
+                size_t edge = node * stride() + alphabet[static_cast<unsigned char>(ch)];
+                if (edges[edge] == 0) {
+                    uint32_t child = add_node();
+                    edges[edge] = child;
+                }
+                node = edges[edge];
+            }
+            if (ends[node] == no_word) {
+                ends[node] = static_cast<uint32_t>(w);
+            }
+        }
+    }
+
+    static constexpr uint32_t root = 0;
+    static constexpr uint32_t no_word = UINT32_MAX;
+
+    // Node after reading `ch` at `node`, or root when no word continues that way
+    uint32_t next(uint32_t node, char ch) const {
+        uint16_t symbol = alphabet[static_cast<unsigned char>(ch)];
+        return symbol == 0 ? root : edges[node * stride() + symbol];
+    }
+
+    // Index of the word ending at `node`, or no_word
+    uint32_t word_at(uint32_t node) const {
+        return ends[node];
+    }
+
+private:
+    std::array<uint16_t, 256> alphabet{};   // 0 = byte used by no word
+    size_t alphabet_size = 0;
+    std::vector<uint32_t> edges{0};   // One row of stride() entries per node; 0 = no edge
+    std::vector<uint32_t> ends{no_word};   // Node 0 is the root
+
+    size_t stride() const {
+        return alphabet_size + 1;
+    }
+
+    uint32_t add_node() {
+        edges.resize(edges.size() + stride(), 0);
+        ends.push_back(no_word);
+        return static_cast<uint32_t>(ends.size() - 1);
+    }
+};
+
+// Single-pass scanner for the built-in text patterns.
+// Finds the same matches as running each regex in TextExtractor::text_patterns
+// with its own std::sregex_iterator, but walks every line only once. Each
+// pattern keeps its own resume position, so overlapping matches of different
+// patterns are reported exactly like the regex set reports them. Keys and
+// tags are looked up in tries, so adding more of them costs no extra scanning.
+class LiteralScanner {
+public:
+    struct Match {
+        size_t pattern;       // Index of the equivalent entry in text_patterns
+        size_t group_start;   // Capture group 1 (the text itself)
+        size_t group_length;
+        size_t match_start;   // Whole match, including quotes/key/tags
+        size_t match_length;
+    };
+
+    // Per-thread buffers reused for every line
+    struct State {
+        std::vector<Match> matches;
+        std::vector<size_t> resume;
+    };
+
+    static constexpr size_t double_quote_pattern = 0;
+    static constexpr size_t single_quote_pattern = 1;
+    static constexpr size_t first_key_pattern = 2;
+
+    // `keys` and `tags` in text_patterns order; both must be free of duplicates
+    LiteralScanner(const std::vector<std::string>& keys, const std::vector<std::string>& tags)
+        : key_trie(keys, true), tag_trie(tags, false), tag_names(tags),
+          key_count(keys.size()), first_tag_pattern(first_key_pattern + keys.size()),
+          pattern_count(first_key_pattern + keys.size() + tags.size()) {}
+
+    // Scan one line into state.matches, ordered by pattern, then by position
+    void scan_line(std::string_view line, State& state) const {
+        std::vector<Match>& matches = state.matches;
+        matches.clear();
+        state.resume.assign(pattern_count, 0);
+        size_t* resume = state.resume.data();
+
+        // Jump straight from one delimiter to the next; every other byte is
+        // ignored by the switch anyway
+        for (size_t i = delimiter_scan::find_first_of(line, 0, delimiters); i < line.size();
+             i = delimiter_scan::find_first_of(line, i + 1, delimiters)) {
+            switch (line[i]) {
+                case '"':
+                    try_quoted(line, i, '"', double_quote_pattern, resume, matches);
+                    break;
+                case '\'':
+                    try_quoted(line, i, '\'', single_quote_pattern, resume, matches);
+                    break;
+                case ':':
+                case '=':
+                    if (key_count > 0) {
+                        try_keys(line, i, resume, matches);
+                    }
+                    break;
+                case '<':
+                    if (!tag_names.empty()) {
+                        try_tags(line, i, resume, matches);
+                    }
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        std::stable_sort(matches.begin(), matches.end(), [](const Match& a, const Match& b) {
+            return a.pattern < b.pattern;
+        });
+    }
+
+private:
+    // Bytes that can start a match: quotes, key separators and tags
+    static constexpr delimiter_scan::Needles<5> delimiters = {'"', '\'', ':', '=', '<'};
+    static constexpr delimiter_scan::Needles<2> quotes = {'"', '\''};
+
+    KeywordTrie key_trie;   // Keys spelled backwards, read from the separator
+    KeywordTrie tag_trie;
+    std::vector<std::string> tag_names;
+    size_t key_count;
+    size_t first_tag_pattern;
+    size_t pattern_count;
+
+    // Same character set as \s in std::regex with the classic locale
+    static bool is_space(char ch) {
+        return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\v' || ch == '\f' || ch == '\r';
+    }
+
+    static void add_match(size_t pattern, size_t group_start, size_t group_end,
+                          size_t match_start, size_t match_end,
+                          size_t resume[], std::vector<Match>& matches) {
+        matches.push_back({pattern, group_start, group_end - group_start, match_start, match_end - match_start});
+        resume[pattern] = match_end;
+    }
+
+    // "([^"\\]*(\\.[^"\\]*)*)" and its single-quoted twin
+    static void try_quoted(std::string_view line, size_t open, char quote, size_t pattern,
+                           size_t resume[], std::vector<Match>& matches) {
+        if (open < resume[pattern]) {
+            return;
+        }
+
+        const delimiter_scan::Needles<2> stops = {quote, '\\'};
+        size_t pos = delimiter_scan::find_first_of(line, open + 1, stops);
+        while (pos < line.size()) {
+            if (line[pos] == quote) {
+                add_match(pattern, open + 1, pos, open, pos + 1, resume, matches);
+                return;
+            }
+            // ECMAScript '.' does not match line terminators
+            if (pos + 1 >= line.size() || line[pos + 1] == '\n' || line[pos + 1] == '\r') {
+                return;
+            }
+            pos = delimiter_scan::find_first_of(line, pos + 2, stops);
+        }
+    }
+
+    // key\s*[:=]\s*["']([^"']+)["'], anchored on the ':' or '=' at `sep`.
+    // Every key that ends right before the separator matches, so walking the
+    // reversed-key trie back from there finds all of them in one pass.
+    void try_keys(std::string_view line, size_t sep,
+                  size_t resume[], std::vector<Match>& matches) const {
+        size_t key_end = sep;
+        while (key_end > 0 && is_space(line[key_end - 1])) {
+            key_end--;
+        }
+
+        // The value part is shared by all keys, so parse it at most once
+        bool value_parsed = false;
+        size_t value_start = 0;
+        size_t value_end = 0;
+
+        uint32_t node = KeywordTrie::root;
+        for (size_t key_start = key_end; key_start > 0; key_start--) {
+            node = key_trie.next(node, line[key_start - 1]);
+            if (node == KeywordTrie::root) {
+                return;
+            }
+            uint32_t key = key_trie.word_at(node);
+            if (key == KeywordTrie::no_word || key_start - 1 < resume[first_key_pattern + key]) {
+                continue;
+            }
+
+            if (!value_parsed) {
+                value_parsed = true;
+                size_t pos = sep + 1;
+                while (pos < line.size() && is_space(line[pos])) {
+                    pos++;
+                }
+                if (pos >= line.size() || (line[pos] != '"' && line[pos] != '\'')) {
+                    return;
+                }
+                value_start = pos + 1;
+                value_end = delimiter_scan::find_first_of(line, value_start, quotes);
+                if (value_end == line.size() || value_end == value_start) {
+                    return;
+                }
+            }
+            add_match(first_key_pattern + key, value_start, value_end, key_start - 1, value_end + 1, resume, matches);
+        }
+    }
+
+    // <tag>([^<]+)</tag>, anchored on the '<' at `open`. Tag names cannot
+    // contain '>', so at most one tag opens here.
+    void try_tags(std::string_view line, size_t open,
+                  size_t resume[], std::vector<Match>& matches) const {
+        uint32_t node = KeywordTrie::root;
+        size_t name_end = open + 1;
+        for (; name_end < line.size() && line[name_end] != '>'; name_end++) {
+            node = tag_trie.next(node, line[name_end]);
+            if (node == KeywordTrie::root) {
+                return;
+            }
+        }
+        uint32_t tag_index = name_end < line.size() ? tag_trie.word_at(node) : KeywordTrie::no_word;
+        if (tag_index == KeywordTrie::no_word) {
+            return;
+        }
+        size_t pattern = first_tag_pattern + tag_index;
+        if (open < resume[pattern]) {
+            return;
+        }
+
+        const std::string_view tag = tag_names[tag_index];
+        size_t content_start = name_end + 1;
+        size_t content_end = line.find('<', content_start);
+        if (content_end == std::string_view::npos || content_end == content_start) {
+            return;
+        }
+
+        size_t close_end = content_end + tag.size() + 3;
+        if (close_end > line.size() || line.compare(content_end, 2, "</") != 0 ||
+            line.compare(content_end + 2, tag.size(), tag) != 0 || line[close_end - 1] != '>') {
+            return;
+        }
+        add_match(pattern, content_start, content_end, open, close_end, resume, matches);
+    }
+};
+
+// Read-only contents of a whole file. Files at or above the mapping threshold
+// are memory-mapped (mmap / MapViewOfFile) and scanned in place; smaller files
+// are read into an owned buffer with a single read, which is cheaper than
+// setting up a mapping.
+class FileBuffer {
+public:
+    FileBuffer() = default;
+    ~FileBuffer() {
+        unmap();
+    }
+
+    FileBuffer(const FileBuffer&) = delete;
+    FileBuffer& operator=(const FileBuffer&) = delete;
+
+    bool open(const std::string& path, size_t mmap_threshold) {
+        unmap();
+        owned.clear();
+        data = std::string_view();
+
+        std::error_code ec;
+        uintmax_t size = fs::file_size(path, ec);
+        if (ec) {
+            return false;
+        }
+        if (size >= mmap_threshold && size > 0 && map(path, static_cast<size_t>(size))) {
+            return true;
+        }
+        return read(path);
+    }
+
+    std::string_view view() const {
+        return data;
+    }
+
+    bool is_mapped() const {
+        return mapped != nullptr;
+    }
+
+private:
+    std::string owned;
+    std::string_view data;
+    const char* mapped = nullptr;
+    size_t mapped_size = 0;
+
+    bool read(const std::string& path) {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file.is_open()) {
+            return false;
+        }
+        std::streamoff size = file.tellg();
+        if (size < 0) {
+            return false;
+        }
+        owned.resize(static_cast<size_t>(size));
+        file.seekg(0);
+        file.read(owned.data(), size);
+        owned.resize(static_cast<size_t>(file.gcount()));
+        data = owned;
+        return true;
+    }
+
+#ifdef _WIN32
+    bool map(const std::string& path, size_t size) {
+        HANDLE file = CreateFileW(fs::path(path).wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                  OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        const void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        // The view keeps the mapping alive on its own
+        if (mapping) {
+            CloseHandle(mapping);
+        }
+        CloseHandle(file);
+        if (!view) {
+            return false;
+        }
+        mapped = static_cast<const char*>(view);
+        mapped_size = size;
+        data = std::string_view(mapped, mapped_size);
+        return true;
+    }
+
+    void unmap() {
+        if (mapped) {
+            UnmapViewOfFile(mapped);
+            mapped = nullptr;
+            mapped_size = 0;
+        }
+    }
+#else
+    bool map(const std::string& path, size_t size) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (view == MAP_FAILED) {
+            return false;
+        }
+#ifdef MADV_SEQUENTIAL
+        madvise(view, size, MADV_SEQUENTIAL);
+#endif
+        mapped = static_cast<const char*>(view);
+        mapped_size = size;
+        data = std::string_view(mapped, mapped_size);
+        return true;
+    }
+
+    void unmap() {
+        if (mapped) {
+            munmap(const_cast<char*>(mapped), mapped_size);
+            mapped = nullptr;
+            mapped_size = 0;
+        }
+    }
+#endif
+};
+
+// 64-bit FNV-1a, used for cache fingerprints and content hashes
+inline uint64_t fnv1a_64(std::string_view data, uint64_t hash = 1469598103934665603ULL) {
+    for (unsigned char ch : data) {
+        hash ^= ch;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Little-endian binary serialisation helpers for on-disk caches
+class BinaryWriter {
+public:
+    explicit BinaryWriter(std::string& out) : out(out) {}
+
+    void u64(uint64_t value) {
+        char bytes[8];
+        for (int i = 0; i < 8; i++) {
+            bytes[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+        }
+        out.append(bytes, 8);
+    }
+
+    void u32(uint32_t value) {
+        char bytes[4];
+        for (int i = 0; i < 4; i++) {
+            bytes[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+        }
+        out.append(bytes, 4);
+    }
+
+    void str(std::string_view value) {
+        u64(value.size());
+        out.append(value.data(), value.size());
+    }
+
+    void raw(std::string_view value) {
+        out.append(value.data(), value.size());
+    }
+
+private:
+    std::string& out;
+};
+
+// Bounds-checked reader matching BinaryWriter; throws std::runtime_error on truncated input
+class BinaryReader {
+public:
+    explicit BinaryReader(std::string_view data) : data(data) {}
+
+    uint64_t u64() {
+        require(8);
+        uint64_t value = 0;
+        for (int i = 0; i < 8; i++) {
+            value |= static_cast<uint64_t>(static_cast<unsigned char>(data[pos + i])) << (8 * i);
+        }
+        pos += 8;
+        return value;
+    }
+
+    uint32_t u32() {
+        require(4);
+        uint32_t value = 0;
+        for (int i = 0; i < 4; i++) {
+            value |= static_cast<uint32_t>(static_cast<unsigned char>(data[pos + i])) << (8 * i);
+        }
+        pos += 4;
+        return value;
+    }
+
+    std::string_view str() {
+        uint64_t size = u64();
+        require(size);
+        std::string_view value = data.substr(pos, static_cast<size_t>(size));
+        pos += static_cast<size_t>(size);
+        return value;
+    }
+
+    std::string_view raw(size_t size) {
+        require(size);
+        std::string_view value = data.substr(pos, size);
+        pos += size;
+        return value;
+    }
+
+private:
+    std::string_view data;
+    size_t pos = 0;
+
+    void require(uint64_t size) const {
+        if (size > data.size() - pos) {
+            throw std::runtime_error("unexpected end of data");
+        }
+    }
+};
+
+// Output file that collects text in a large buffer and writes it in big
+// blocks, instead of one small stream write per field
+class BufferedFileWriter {
+public:
+    explicit BufferedFileWriter(const std::string& path, std::ios::openmode mode = std::ios::out,
+                                size_t capacity = 1 << 20)
+        : file(path, mode), capacity(capacity) {
+        buffer.reserve(capacity);
+    }
+    
+    ~BufferedFileWriter() {
+        flush();
+    }
+    
+    bool is_open() const {
+        return file.is_open();
+    }
+    
+    // Appending text already formatted elsewhere bypasses the buffer
+    void write(std::string_view text) {
+        if (buffer.size() + text.size() > capacity) {
+            flush();
+        }
+        if (text.size() >= capacity) {
+            file.write(text.data(), static_cast<std::streamsize>(text.size()));
+        } else {
+            buffer.append(text.data(), text.size());
+        }
+    }
+    
+    std::string& data() {
+        return buffer;
+    }
+    
+    // Write the buffer out once it has filled up
+    void maybe_flush() {
+        if (buffer.size() >= capacity) {
+            flush();
+        }
+    }
+    
+    void flush() {
+        if (!buffer.empty() && file.is_open()) {
+            file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        }
+        buffer.clear();
+    }
+    
+    // Flush and close; false if any write failed
+    bool close() {
+        flush();
+        file.close();
+        return !file.fail();
+    }
+    
+private:
+    std::ofstream file;
+    size_t capacity;
+    std::string buffer;
+};
+
+// Why a file looks like binary data rather than text, or nullptr for text:
+// "unity" for a binary Unity serialized file or asset bundle, "binary" for
+// NUL bytes or mostly control characters in the first few KB. UTF-16 has to
+// be ruled out first, since it is full of NUL bytes.
+inline const char* binary_file_kind(std::string_view data) {
+    for (std::string_view magic : {"UnityFS", "UnityWeb", "UnityRaw", "UnityArchive"}) {
+        if (data.size() > magic.size() && data.compare(0, magic.size(), magic) == 0 && data[magic.size()] == '\0') {
+            return "unity";
+        }
+    }
+    // Serialized file header: big-endian metadata size, file size, version
+    // and data offset; from version 22 on the sizes move to 64-bit fields
+    auto big_endian = [&data](size_t offset, size_t bytes) {
+        uint64_t value = 0;
+        for (size_t i = 0; i < bytes; i++) {
+            value = (value << 8) | static_cast<unsigned char>(data[offset + i]);
+        }
+        return value;
+    };
+    if (data.size() >= 48) {
+        uint64_t version = big_endian(8, 4);
+        uint64_t file_size = version >= 22 ? big_endian(24, 8) : big_endian(4, 4);
+        if (version >= 5 && version < 64 && file_size == data.size()) {
+            return "unity";
+        }
+    }
+    
+    std::string_view head = data.substr(0, 4096);
+    size_t control = 0;
+    for (char ch : head) {
+        unsigned char byte = static_cast<unsigned char>(ch);
+        if (byte == 0) {
+            return "binary";
+        }
+        if ((byte < 0x20 && !std::isspace(byte) && byte != 0x1B) || byte == 0x7F) {
+            control++;
+        }
+    }
+    return control * 10 > head.size() ? "binary" : nullptr;
+}
+
+inline void append_number(std::string& out, size_t value) {
+    char digits[24];
+    auto end = std::to_chars(digits, digits + sizeof(digits), value).ptr;
+    out.append(digits, end);
+}
+
+// CPU time of the whole process (all threads, user + system) in seconds
+inline double process_cpu_seconds() {
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) {
+        return 0;
+    }
+    auto seconds = [](const FILETIME& time) {
+        return ((static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime) / 1e7;
+    };
+    return seconds(kernel) + seconds(user);
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+#endif
+}
+
+// Thread pool with one task deque per worker. A worker pops from the front
+// of its own deque and steals from the back of the others once it runs dry,
+// so a few huge files don't leave the remaining threads idle. Tasks may
+// submit further tasks; wait() returns once all of them have finished.
+class WorkStealingPool {
+public:
+    using Task = std::function<void()>;
+
+    explicit WorkStealingPool(size_t thread_count) {
+        thread_count = std::max<size_t>(thread_count, 1);
+        for (size_t i = 0; i < thread_count; i++) {
+            queues.push_back(std::make_unique<Queue>());
+        }
+        for (size_t i = 0; i < thread_count; i++) {
+            threads.emplace_back([this, i] { worker_loop(i); });
+        }
+    }
+
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lock(state_mutex);
+            stopping = true;
+        }
+        work_available.notify_all();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    size_t size() const {
+        return threads.size();
+    }
+
+    // Index of the worker running the calling task, size() outside the pool
+    size_t worker_index() const {
+        return current_pool == this ? current_index : threads.size();
+    }
+
+    void submit(Task task) {
+        // Tasks spawned by a worker stay on that worker's deque
+        size_t index = current_pool == this ? current_index
+                                             : next_queue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+        pending.fetch_add(1, std::memory_order_relaxed);
+        queued.fetch_add(1, std::memory_order_release);
+        {
+            std::lock_guard<std::mutex> lock(queues[index]->mutex);
+            queues[index]->tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard<std::mutex> lock(state_mutex);
+        }
+        work_available.notify_one();
+    }
+
+    // Block until every submitted task has run; rethrows the first task exception.
+    // Must not be called from inside a task.
+    void wait() {
+        std::unique_lock<std::mutex> lock(state_mutex);
+        all_done.wait(lock, [this] { return pending.load(std::memory_order_acquire) == 0; });
+        if (first_error) {
+            std::exception_ptr error = first_error;
+            first_error = nullptr;
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> threads;
+    std::mutex state_mutex;
+    std::condition_variable work_available;
+    std::condition_variable all_done;
+    std::atomic<size_t> pending{0};
+    std::atomic<size_t> queued{0};
+    std::atomic<size_t> next_queue{0};
+    std::exception_ptr first_error;
+    bool stopping = false;
+
+    static inline thread_local WorkStealingPool* current_pool = nullptr;
+    static inline thread_local size_t current_index = 0;
+
+    bool try_pop(size_t index, Task& task) {
+        {
+            Queue& own = *queues[index];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty()) {
+                task = std::move(own.tasks.front());
+                own.tasks.pop_front();
+                queued.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        for (size_t offset = 1; offset < queues.size(); offset++) {
+            Queue& victim = *queues[(index + offset) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                task = std::move(victim.tasks.back());
+                victim.tasks.pop_back();
+                queued.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void worker_loop(size_t index) {
+        current_pool = this;
+        current_index = index;
+
+        while (true) {
+            Task task;
+            if (try_pop(index, task)) {
+                try {
+                    task();
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(state_mutex);
+                    if (!first_error) {
+                        first_error = std::current_exception();
+                    }
+                }
+                if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    std::lock_guard<std::mutex> lock(state_mutex);
+                    all_done.notify_all();
+                }
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(state_mutex);
+            work_available.wait(lock, [this] {
+                return stopping || queued.load(std::memory_order_acquire) > 0;
+            });
+            if (stopping && queued.load(std::memory_order_acquire) == 0) {
+                return;
+            }
+        }
+    }
+};
+
+// Open-addressing hash set of lowercase file extensions (".json", ...).
+// Looks extensions up without allocating, unlike a std::string key.
+class ExtensionSet {
+public:
+    ExtensionSet() = default;
+
+    explicit ExtensionSet(const std::vector<std::string>& extensions) {
+        size_t capacity = 16;
+        while (capacity < extensions.size() * 2) {
+            capacity *= 2;
+        }
+        slots.assign(capacity, std::string());
+        for (const auto& extension : extensions) {
+            std::string lower = extension;
+            std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char ch) {
+                return static_cast<char>(std::tolower(ch));
+            });
+            if (lower.empty() || lower.size() > max_length) {
+                continue;
+            }
+            size_t slot = find_slot(lower);
+            slots[slot] = lower;
+        }
+    }
+
+    // `extension` must already be lowercase
+    bool contains(std::string_view extension) const {
+        if (slots.empty() || extension.empty() || extension.size() > max_length) {
+            return false;
+        }
+        return !slots[find_slot(extension)].empty();
+    }
+
+    // Check the extension of a file name, as fs::path::extension() defines it
+    bool matches_file_name(std::string_view name) const {
+        size_t dot = name.rfind('.');
+        if (dot == std::string_view::npos || dot == 0 || name.size() - dot > max_length) {
+            return false;
+        }
+        char lower[max_length];
+        size_t length = name.size() - dot;
+        for (size_t i = 0; i < length; i++) {
+            lower[i] = static_cast<char>(std::tolower(static_cast<unsigned char>(name[dot + i])));
+        }
+        return contains(std::string_view(lower, length));
+    }
+
+private:
+    static constexpr size_t max_length = 32;
+    std::vector<std::string> slots;
+
+    size_t find_slot(std::string_view extension) const {
+        size_t mask = slots.size() - 1;
+        size_t slot = static_cast<size_t>(fnv1a_64(extension)) & mask;
+        while (!slots[slot].empty() && slots[slot] != extension) {
+            slot = (slot + 1) & mask;
+        }
+        return slot;
+    }
+};
+
+// Shell-style match of `text` against `pattern`, where '*' matches any run
+// of characters and '?' any single character
+inline bool glob_match(std::string_view pattern, std::string_view text) {
+    size_t p = 0;
+    size_t t = 0;
+    size_t star = std::string_view::npos;
+    size_t star_text = 0;
+    while (t < text.size()) {
+        if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == text[t])) {
+            p++;
+            t++;
+        } else if (p < pattern.size() && pattern[p] == '*') {
+            star = p++;
+            star_text = t;
+        } else if (star != std::string_view::npos) {
+            p = star + 1;
+            t = ++star_text;
+        } else {
+            return false;
+        }
+    }
+    while (p < pattern.size() && pattern[p] == '*') {
+        p++;
+    }
+    return p == pattern.size();
+}
+
+// Order of paths under a common root: component by component, so a
+// directory's contents sort right after the directory name itself. This is
+// the order of a depth-first walk that visits entries sorted by name.
+inline bool path_order_less(const std::string& a, const std::string& b) {
+    auto key = [](char ch) -> unsigned char {
+        return ch == '/' || ch == '\\' ? 0 : static_cast<unsigned char>(ch);
+    };
+    size_t length = std::min(a.size(), b.size());
+    for (size_t i = 0; i < length; i++) {
+        unsigned char ka = key(a[i]);
+        unsigned char kb = key(b[i]);
+        if (ka != kb) {
+            return ka < kb;
+        }
+    }
+    return a.size() < b.size();
+}
+
+// Deepest directory containing all `paths`
+inline fs::path common_root(const std::vector<std::string>& paths) {
+    fs::path root;
+    for (size_t i = 0; i < paths.size(); i++) {
+        fs::path parent = fs::path(paths[i]).parent_path();
+        if (i == 0) {
+            root = parent;
+            continue;
+        }
+        fs::path common;
+        auto a = root.begin();
+        auto b = parent.begin();
+        for (; a != root.end() && b != parent.end() && *a == *b; ++a, ++b) {
+            common /= *a;
+        }
+        root = common;
+    }
+    return root;
+}
+
+// Open-addressing hash table that assigns each distinct string a dense id.
+// Strings are not copied: the caller keeps them alive while the table is in
+// use. Every slot keeps the full hash, so probing compares hashes before
+// bytes and growing never hashes a string twice.
+class StringInternTable {
+public:
+    static constexpr uint32_t npos = UINT32_MAX;
+
+    explicit StringInternTable(size_t expected = 0) {
+        size_t capacity = 16;
+        while (capacity * 7 < expected * 10) {
+            capacity *= 2;
+        }
+        slots.assign(capacity, Slot());
+        strings.reserve(expected);
+    }
+
+    // Id of `text`, adding it if it is new; `.second` is true when it was added
+    std::pair<uint32_t, bool> intern(std::string_view text) {
+        return intern(text, fnv1a_64(text));
+    }
+
+    std::pair<uint32_t, bool> intern(std::string_view text, uint64_t hash) {
+        size_t mask = slots.size() - 1;
+        size_t slot = static_cast<size_t>(hash) & mask;
+        while (slots[slot].id != npos) {
+            if (slots[slot].hash == hash && strings[slots[slot].id] == text) {
+                return {slots[slot].id, false};
+            }
+            slot = (slot + 1) & mask;
+        }
+        if (strings.size() >= npos) {
+            throw std::length_error("too many distinct strings");
+        }
+        uint32_t id = static_cast<uint32_t>(strings.size());
+        slots[slot] = Slot{hash, id};
+        strings.push_back(text);
+        // Keep the load factor at or below 0.7
+        if (strings.size() * 10 > slots.size() * 7) {
+            grow();
+        }
+        return {id, true};
+    }
+
+    uint32_t find(std::string_view text) const {
+        uint64_t hash = fnv1a_64(text);
+        size_t mask = slots.size() - 1;
+        for (size_t slot = static_cast<size_t>(hash) & mask; slots[slot].id != npos; slot = (slot + 1) & mask) {
+            if (slots[slot].hash == hash && strings[slots[slot].id] == text) {
+                return slots[slot].id;
+            }
+        }
+        return npos;
+    }
+
+    size_t size() const {
+        return strings.size();
+    }
+
+    std::string_view at(uint32_t id) const {
+        return strings[id];
+    }
+
+private:
+    struct Slot {
+        uint64_t hash = 0;
+        uint32_t id = npos;
+    };
+    std::vector<Slot> slots;
+    std::vector<std::string_view> strings;
+
+    void grow() {
+        std::vector<Slot> old(slots.size() * 2, Slot());
+        old.swap(slots);
+        size_t mask = slots.size() - 1;
+        for (const Slot& entry : old) {
+            if (entry.id == npos) {
+                continue;
+            }
+            size_t slot = static_cast<size_t>(entry.hash) & mask;
+            while (slots[slot].id != npos) {
+                slot = (slot + 1) & mask;
+            }
+            slots[slot] = entry;
+        }
+    }
+};
+
+// Fixed-capacity blocking queue between pipeline stages. push() blocks while
+// the queue is full, which is what bounds the memory of a pipeline.
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : capacity(std::max<size_t>(capacity, 1)) {}
+
+    // Returns false if the queue was closed before the item could be added
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_full.wait(lock, [this] { return closed || items.size() < capacity; });
+        if (closed) {
+            return false;
+        }
+        items.push_back(std::move(item));
+        not_empty.notify_one();
+        return true;
+    }
+
+    // Returns false once the queue is closed and drained
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_empty.wait(lock, [this] { return closed || !items.empty(); });
+        if (items.empty()) {
+            return false;
+        }
+        item = std::move(items.front());
+        items.pop_front();
+        not_full.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        not_full.notify_all();
+        not_empty.notify_all();
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable not_full;
+    std::condition_variable not_empty;
+    std::deque<T> items;
+    size_t capacity;
+    bool closed = false;
+};
+
+// Cooperative cancellation for long-running extractions. cancel() may be
+// called from any thread; extraction checks the token between files and
+// returns what it has so far.
+class CancellationToken {
+public:
+    void cancel() {
+        cancelled.store(true, std::memory_order_relaxed);
+    }
+
+    // Make the token usable for another extraction
+    void reset() {
+        cancelled.store(false, std::memory_order_relaxed);
+    }
+
+    bool is_cancelled() const {
+        return cancelled.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<bool> cancelled{false};
+};
+
+class TextExtractor {
+private:
+    // Keys of the `key: "value"` patterns and element names of the
+    // `<tag>value</tag>` patterns (can be set dynamically)
+    std::vector<std::string> text_keys = {
+        "text", "label", "message", "title", "description", "name", "value", "content"
+    };
+    std::vector<std::string> text_tags = {
+        "text", "string", "message", "label", "title", "description", "name", "value", "content"
+    };
+    
+    // Common text patterns in game files: quoted strings, then one pattern
+    // per key and per tag. Only the regex engine runs them, so they are
+    // compiled on first use; compiling them was most of the cost of
+    // constructing a TextExtractor.
+    struct RegexPatterns {
+        std::once_flag compiled;
+        std::vector<std::regex> patterns;
+    };
+    std::shared_ptr<RegexPatterns> regex_patterns = std::make_shared<RegexPatterns>();
+    
+    // File extensions to process (can be set dynamically)
+    std::vector<std::string> supported_extensions = {
+        ".csv", ".erb", ".erh", ".py", ".cpp", ".c", ".h", ".hpp", ".cs", ".java", ".js", ".ts", ".jsx", ".tsx",
+        ".xml", ".json", ".yaml", ".yml", ".ini", ".cfg", ".txt", ".lua", ".rpy",
+        ".unity", ".prefab", ".asset", ".scene", ".csproj", ".sln"
+    };
+    ExtensionSet extension_set{supported_extensions};
+    
+    // Format-aware extractors by lowercase extension; other files are
+    // scanned with text_patterns
+    std::unordered_map<std::string, const format_extract::FormatExtractor*> format_extractors = {
+        {".json", format_extract::find_extractor("json")},
+        {".xml", format_extract::find_extractor("xml")},
+        {".csv", format_extract::find_extractor("csv")},
+        {".yaml", format_extract::find_extractor("yaml")},
+        {".yml", format_extract::find_extractor("yaml")},
+        {".unity", format_extract::find_extractor("unity")},
+        {".prefab", format_extract::find_extractor("unity")},
+        {".asset", format_extract::find_extractor("unity")},
+        {".scene", format_extract::find_extractor("unity")},
+    };
+    
+    // Directory glob patterns skipped while walking (e.g. ".git", "Library", "*/Temp")
+    std::vector<std::string> excluded_directories;
+    
+    // Minimum text length to extract
+    size_t min_text_length = 3;
+    
+    // Maximum text length per chunk
+    size_t max_chunk_size = 50000;
+
+    // Engine used to find texts; the regex set is kept for validation
+    enum class ScanEngine { Scanner, Regex };
+    ScanEngine scan_engine = ScanEngine::Scanner;
+    LiteralScanner scanner{text_keys, text_tags};
+    
+    // Worker threads for extract_texts (0 = one per hardware thread)
+    size_t num_threads = 0;
+    
+    // Files of at least this many bytes are memory-mapped instead of read
+    size_t mmap_threshold = 1024 * 1024;
+    
+    // Read files for extract_texts on the workers that scan them, or ahead
+    // of them with an async_io::FileReader keeping io_depth reads in flight
+    bool async_reads = false;
+    async_io::Backend io_backend = async_io::Backend::Threads;
+    size_t io_depth = 32;
+    
+    // Incremental extraction cache (empty path = disabled)
+    std::string cache_file;
+    bool cache_content_hash = false;
+    
+    // List each distinct text once in the master translation file
+    bool deduplicate = false;
+    
+    // Encoding of the input files; detected per file unless one is forced
+    bool detect_encoding = true;
+    text_encoding::Encoding input_encoding = text_encoding::Encoding::Utf8;
+    
+    // Files and lines that are not worth scanning
+    bool skip_binary_files = true;
+    size_t max_file_size = 0;
+    size_t max_line_length = 0;
+    
+    // Part of the tree a walk covers, see set_shard
+    size_t shard_index = 0;
+    size_t shard_count = 1;
+
+public:
+    // Method to set supported file extensions
+    void set_supported_extensions(const std::vector<std::string>& extensions) {
+        supported_extensions = extensions;
+        extension_set = ExtensionSet(extensions);
+    }
+    
+    // Method to get current supported extensions
+    std::vector<std::string> get_supported_extensions() const {
+        return supported_extensions;
+    }
+
+    // Directories to skip while walking. A pattern without '/' is matched
+    // against the directory name, one with '/' against its path relative to
+    // the scanned root; '*' and '?' are wildcards.
+    void set_excluded_directories(const std::vector<std::string>& patterns) {
+        excluded_directories.clear();
+        for (std::string pattern : patterns) {
+            std::replace(pattern.begin(), pattern.end(), '\\', '/');
+            while (!pattern.empty() && pattern.back() == '/') {
+                pattern.pop_back();
+            }
+            if (!pattern.empty()) {
+                excluded_directories.push_back(pattern);
+            }
+        }
+    }
+    
+    std::vector<std::string> get_excluded_directories() const {
+        return excluded_directories;
+    }
+    
+    // Keys matched as `key: "value"` / `key = 'value'`. Like the regexes they
+    // stand for, a key also matches at the end of a longer word ("subtitle"
+    // for "title"). Duplicates are dropped.
+    void set_text_keys(const std::vector<std::string>& keys) {
+        std::vector<std::string> unique = validate_keywords(keys, "key");
+        regex_patterns = std::make_shared<RegexPatterns>();
+        scanner = LiteralScanner(unique, text_tags);
+        text_keys = std::move(unique);
+    }
+    
+    std::vector<std::string> get_text_keys() const {
+        return text_keys;
+    }
+    
+    // Element names matched as `<tag>value</tag>`
+    void set_text_tags(const std::vector<std::string>& tags) {
+        std::vector<std::string> unique = validate_keywords(tags, "tag");
+        regex_patterns = std::make_shared<RegexPatterns>();
+        scanner = LiteralScanner(text_keys, unique);
+        text_tags = std::move(unique);
+    }
+    
+    std::vector<std::string> get_text_tags() const {
+        return text_tags;
+    }
+    
+    // Extractor used for files with `extension`: "json", "xml", "csv", "yaml",
+    // "unity", or "patterns" for the generic text_patterns scan
+    void set_format_extractor(const std::string& extension, const std::string& format) {
+        if (extension.size() < 2 || extension[0] != '.') {
+            throw std::invalid_argument("Extension must start with a dot: " + extension);
+        }
+        std::string key = lowercase(extension);
+        if (format == "patterns") {
+            format_extractors.erase(key);
+            return;
+        }
+        const format_extract::FormatExtractor* extractor = format_extract::find_extractor(format);
+        if (!extractor) {
+            throw std::invalid_argument("Unknown format extractor: " + format);
+        }
+        format_extractors[key] = extractor;
+    }
+    
+    std::string get_format_extractor(const std::string& extension) const {
+        auto it = format_extractors.find(lowercase(extension));
+        return it == format_extractors.end() ? "patterns" : it->second->name();
+    }
+    
+    // Every extension with a format extractor, and the extractor's name
+    std::map<std::string, std::string> get_format_extractors() const {
+        std::map<std::string, std::string> formats;
+        for (const auto& [extension, extractor] : format_extractors) {
+            formats[extension] = extractor->name();
+        }
+        return formats;
+    }
+    
+    // Select the matching engine for files without a format extractor:
+    // "scanner" (default) or "regex"
+    void set_scan_engine(const std::string& engine) {
+        if (engine == "scanner") {
+            scan_engine = ScanEngine::Scanner;
+        } else if (engine == "regex") {
+            scan_engine = ScanEngine::Regex;
+        } else {
+            throw std::invalid_argument("Unknown scan engine: " + engine);
+        }
+    }
+    
+    std::string get_scan_engine() const {
+        return scan_engine == ScanEngine::Regex ? "regex" : "scanner";
+    }
+    
+    // Input encoding: "auto" (default: BOM, then UTF-16/UTF-8/Shift-JIS heuristics),
+    // or one of "utf-8", "utf-8-sig", "utf-16le", "utf-16be", "shift_jis".
+    // Files are converted to UTF-8 before scanning; columns stay in original bytes.
+    void set_input_encoding(const std::string& encoding) {
+        using text_encoding::Encoding;
+        if (encoding == "auto") {
+            detect_encoding = true;
+            return;
+        }
+        static const std::pair<const char*, Encoding> names[] = {
+            {"utf-8", Encoding::Utf8}, {"utf8", Encoding::Utf8},
+            {"utf-8-sig", Encoding::Utf8Bom},
+            {"utf-16le", Encoding::Utf16LE}, {"utf-16be", Encoding::Utf16BE},
+            {"shift_jis", Encoding::ShiftJis}, {"sjis", Encoding::ShiftJis}, {"cp932", Encoding::ShiftJis},
+        };
+        for (const auto& name : names) {
+            if (encoding == name.first) {
+                if (name.second == Encoding::ShiftJis && !text_encoding::ShiftJisTable::instance().available()) {
+                    throw std::invalid_argument("Shift-JIS conversion is not available on this system");
+                }
+                detect_encoding = false;
+                input_encoding = name.second;
+                return;
+            }
+        }
+        throw std::invalid_argument("Unknown input encoding: " + encoding);
+    }
+    
+    std::string get_input_encoding() const {
+        return detect_encoding ? "auto" : text_encoding::encoding_name(input_encoding);
+    }
+    
+    // Encoding extract_from_file would use for `data`
+    text_encoding::Encoding resolve_encoding(std::string_view data) const {
+        return detect_encoding ? text_encoding::detect(data) : input_encoding;
+    }
+    
+    // Number of worker threads used by extract_texts (0 = hardware concurrency)
+    void set_num_threads(size_t threads) {
+        num_threads = threads;
+    }
+    
+    size_t get_num_threads() const {
+        return num_threads;
+    }
+    
+    // Files smaller than this are read into a buffer, larger ones are memory-mapped
+    void set_mmap_threshold(size_t bytes) {
+        mmap_threshold = bytes;
+    }
+    
+    size_t get_mmap_threshold() const {
+        return mmap_threshold;
+    }
+    
+    // How extract_texts reads files: "sync" (default: each worker reads the
+    // file it scans), "auto" (the best asynchronous backend available),
+    // "io_uring" (Linux), "iocp" (Windows) or "threads" (blocking reads on
+    // dedicated reader threads). The asynchronous ones pay off on network
+    // shares and cold disks. Not used for memory-mapped files or with a cache.
+    void set_io_backend(const std::string& backend) {
+        using async_io::Backend;
+        if (backend == "sync") {
+            async_reads = false;
+            return;
+        }
+        Backend selected;
+        if (backend == "auto") {
+            selected = async_io::best_backend();
+        } else if (backend == "threads") {
+            selected = Backend::Threads;
+        } else if (backend == "io_uring") {
+            if (!async_io::io_uring_available()) {
+                throw std::invalid_argument("io_uring is not available on this system");
+            }
+            selected = Backend::IoUring;
+        } else if (backend == "iocp") {
+            if (!async_io::iocp_available()) {
+                throw std::invalid_argument("IOCP is only available on Windows");
+            }
+            selected = Backend::Iocp;
+        } else {
+            throw std::invalid_argument("Unknown I/O backend: " + backend);
+        }
+        async_reads = true;
+        io_backend = selected;
+    }
+    
+    std::string get_io_backend() const {
+        return async_reads ? async_io::backend_name(io_backend) : "sync";
+    }
+    
+    // Files an asynchronous backend reads at once; read files waiting to be
+    // scanned count too, which bounds the memory they take
+    void set_io_depth(size_t depth) {
+        if (depth == 0 || depth > async_io::FileReader::max_depth) {
+            throw std::invalid_argument("I/O depth must be between 1 and " +
+                                        std::to_string(async_io::FileReader::max_depth));
+        }
+        io_depth = depth;
+    }
+    
+    size_t get_io_depth() const {
+        return io_depth;
+    }
+    
+    // Reuse chunks of unchanged files between runs. Files are matched by
+    // path, size and modification time; an empty path disables the cache.
+    void set_cache_file(const std::string& path) {
+        cache_file = path;
+    }
+    
+    std::string get_cache_file() const {
+        return cache_file;
+    }
+    
+    // Also hash file contents, so files that were touched but not changed are reused
+    void set_cache_content_hash(bool enabled) {
+        cache_content_hash = enabled;
+    }
+    
+    bool get_cache_content_hash() const {
+        return cache_content_hash;
+    }
+    
+    // With deduplication, master_translation.txt has one entry per distinct
+    // text listing all of its locations, so each text is translated once
+    void set_deduplicate(bool enabled) {
+        deduplicate = enabled;
+    }
+    
+    bool get_deduplicate() const {
+        return deduplicate;
+    }
+    
+    // Snapshot of a running extract_texts, passed to the progress callback
+    struct ExtractionProgress {
+        size_t files_found = 0;        // Supported files found by the walk so far
+        size_t files_processed = 0;
+        size_t bytes_read = 0;         // File contents scanned; files reused from the cache are not read
+        size_t chunks_found = 0;       // Before long texts are split
+        double elapsed_seconds = 0;
+        double eta_seconds = -1;       // Estimated from the files found so far, -1 until a file is done
+        bool finished = false;         // Last report of the run
+    };
+    
+    using ProgressCallback = std::function<void(ExtractionProgress)>;
+    
+    // Call `callback` every `interval_seconds` while extract_texts runs and
+    // once more when it ends. The calls come from a reporting thread, so the
+    // file workers only bump counters. An empty callback disables reporting.
+    void set_progress_callback(ProgressCallback callback, double interval_seconds) {
+        if (!(interval_seconds > 0)) {
+            throw std::invalid_argument("Progress interval must be positive");
+        }
+        progress_callback = std::move(callback);
+        progress_interval = interval_seconds;
+    }
+    
+    double get_progress_interval() const {
+        return progress_interval;
+    }
+    
+    // Token checked between files by extract_texts, extract_iter and
+    // scan_directory; nullptr disables cancellation
+    void set_cancel_token(std::shared_ptr<CancellationToken> token) {
+        cancel_token = std::move(token);
+    }
+    
+    std::shared_ptr<CancellationToken> get_cancel_token() const {
+        return cancel_token;
+    }
+    
+    // Skip files that look binary (see binary_file_kind) instead of scanning them
+    void set_skip_binary_files(bool enabled) {
+        skip_binary_files = enabled;
+    }
+    
+    bool get_skip_binary_files() const {
+        return skip_binary_files;
+    }
+    
+    // Skip files larger than this many bytes (0 = no limit)
+    void set_max_file_size(size_t bytes) {
+        max_file_size = bytes;
+    }
+    
+    size_t get_max_file_size() const {
+        return max_file_size;
+    }
+    
+    // Scan only the first this many bytes of longer lines (0 = no limit).
+    // Format extractors read the whole file and are not limited.
+    void set_max_line_length(size_t bytes) {
+        max_line_length = bytes;
+    }
+    
+    size_t get_max_line_length() const {
+        return max_line_length;
+    }
+    
+    // Walk only shard `index` of `count`: the files whose path relative to the
+    // scanned directory hashes to it (see shard_of). Applies to every walk, so
+    // `count` machines with the same settings split a tree without overlap;
+    // ExtractionIndex::merge combines their indexes.
+    void set_shard(size_t index, size_t count) {
+        if (count == 0 || index >= count) {
+            throw std::invalid_argument("Shard index must be less than the shard count");
+        }
+        shard_index = index;
+        shard_count = count;
+    }
+    
+    size_t get_shard_index() const {
+        return shard_index;
+    }
+    
+    size_t get_shard_count() const {
+        return shard_count;
+    }
+    
+    // Shard of a file from its path relative to the scanned directory, with
+    // '/' separators, so it is the same wherever the tree is mounted
+    static size_t shard_of(std::string_view relative_path, size_t count) {
+        return static_cast<size_t>(fnv1a_64(relative_path) % count);
+    }
+    
+    static std::string join_path(const std::string& directory, std::string_view name) {
+        std::string path = directory;
+#ifdef _WIN32
+        if (!path.empty() && path.back() != '/' && path.back() != '\\') {
+            path += '\\';
+        }
+#else
+        if (!path.empty() && path.back() != '/') {
+            path += '/';
+        }
+#endif
+        path.append(name.data(), name.size());
+        return path;
+    }
+    
+    // Number of files listed in ExtractionStats::slowest_files
+    void set_slowest_files(size_t count) {
+        slowest_files = count;
+    }
+    
+    size_t get_slowest_files() const {
+        return slowest_files;
+    }
+    
+    // Write a Chrome trace (chrome://tracing, Perfetto) of every extract_texts
+    // to this file: one event per stage, directory and file. Empty disables.
+    void set_trace_file(const std::string& path) {
+        trace_file = path;
+    }
+    
+    std::string get_trace_file() const {
+        return trace_file;
+    }
+    
+    // Source lines of one file that produced chunks, each stored once and
+    // shared by every chunk of that file
+    struct SourceText {
+        std::string lines;
+    };
+    
+    struct TextChunk {
+        std::string text;
+        std::string file_path;
+        size_t line_number;
+        size_t column_start;
+        size_t column_end;
+        
+        // Texts longer than max_chunk_size are split into part_count pieces
+        // that keep the file, line, columns and context of the whole text
+        size_t part_index = 0;
+        size_t part_count = 1;
+        
+        // Spans into source->lines; context and original text are only
+        // materialised when asked for
+        std::shared_ptr<const SourceText> source;
+        size_t context_offset = 0;
+        size_t context_length = 0;
+        size_t original_offset = 0;
+        size_t original_length = 0;
+        
+        std::string_view context() const {
+            return source ? std::string_view(source->lines).substr(context_offset, context_length) : std::string_view();
+        }
+        
+        std::string_view original_text() const {
+            return source ? std::string_view(source->lines).substr(original_offset, original_length) : std::string_view();
+        }
+    };
+    
+    // Wall and process CPU time of one step of extract_texts
+    struct StageTime {
+        std::string name;
+        double wall_seconds = 0;
+        double cpu_seconds = 0;   // All threads of the process
+    };
+    
+    struct FileTime {
+        std::string file_path;
+        double seconds = 0;       // Read, decode and scan
+        size_t bytes = 0;
+        size_t chunks = 0;
+    };
+    
+    struct SkippedFile {
+        std::string file_path;
+        std::string reason;       // "size", "binary" or "unity"
+        size_t bytes = 0;
+    };
+    
+    struct ThreadTime {
+        double busy_seconds = 0;  // Walking directories and extracting files
+        size_t files = 0;
+        double utilisation = 0;   // busy_seconds / wall time of the extract stage
+    };
+    
+    // Where the time of an extract_texts went
+    struct ExtractionStats {
+        std::vector<StageTime> stages;   // cache_load, extract, cache_save, merge, split, dedup; the cache
+                                         // and dedup stages only when they are enabled
+        
+        // Breakdown of the extract stage, summed over the worker threads
+        double walk_seconds = 0;     // Listing directories
+        double read_seconds = 0;     // Opening, reading or mapping files
+        double decode_seconds = 0;   // Converting non-UTF-8 files
+        double scan_seconds = 0;     // Matching and cleaning texts
+        size_t bytes_read = 0;
+        size_t files_read = 0;       // Files reused by size and time from the cache are not opened
+        
+        std::map<std::string, size_t> pattern_matches;  // Texts found per pattern, e.g. "'...'" or "<text>...</text>"
+        std::map<std::string, size_t> format_matches;   // Texts found per format extractor
+        std::vector<FileTime> slowest_files;            // Slowest first
+        std::vector<SkippedFile> skipped_files;         // Files not scanned, in walk order
+        size_t lines_truncated = 0;                     // Lines cut to max_line_length
+        std::vector<ThreadTime> threads;
+    };
+    
+    struct ExtractionResult {
+        std::vector<TextChunk> chunks;
+        size_t total_files_processed;
+        size_t total_texts_found;
+        double processing_time;
+        size_t files_from_cache = 0;
+        size_t unique_texts_found = 0;   // Only counted with set_deduplicate(true)
+        bool cancelled = false;          // Stopped by the cancel token; chunks are from the files done so far
+        ExtractionStats stats;
+    };
+    
+    // Distinct texts of a chunk list and where each one occurs. Ids follow
+    // the order of first occurrence.
+    struct UniqueTexts {
+        std::vector<std::string> texts;
+        std::vector<uint32_t> text_ids;               // Id of every chunk's text
+        std::vector<size_t> occurrence_offsets;       // Occurrences of id i: [offsets[i], offsets[i + 1])
+        std::vector<size_t> occurrence_chunks;        // Chunk indices, grouped by id, ascending
+        
+        size_t count(size_t id) const {
+            return occurrence_offsets[id + 1] - occurrence_offsets[id];
+        }
+    };
+    
+    static UniqueTexts deduplicate_texts(const std::vector<TextChunk>& chunks) {
+        UniqueTexts unique;
+        StringInternTable table(chunks.size() / 4);
+        unique.text_ids.reserve(chunks.size());
+        for (const auto& chunk : chunks) {
+            unique.text_ids.push_back(table.intern(chunk.text).first);
+        }
+        
+        unique.texts.reserve(table.size());
+        for (uint32_t id = 0; id < table.size(); id++) {
+            unique.texts.emplace_back(table.at(id));
+        }
+        
+        // Counting sort of chunk indices by id
+        unique.occurrence_offsets.assign(table.size() + 1, 0);
+        for (uint32_t id : unique.text_ids) {
+            unique.occurrence_offsets[id + 1]++;
+        }
+        for (size_t id = 0; id < table.size(); id++) {
+            unique.occurrence_offsets[id + 1] += unique.occurrence_offsets[id];
+        }
+        std::vector<size_t> next(unique.occurrence_offsets.begin(), unique.occurrence_offsets.end() - 1);
+        unique.occurrence_chunks.resize(chunks.size());
+        for (size_t i = 0; i < chunks.size(); i++) {
+            unique.occurrence_chunks[next[unique.text_ids[i]]++] = i;
+        }
+        return unique;
+    }
+    
+    // Fast parallel file scanning; files come back in walk order (see path_order_less)
+    std::vector<std::string> scan_directory(const std::string& directory_path) {
+        std::vector<std::string> files;
+        std::mutex files_mutex;
+        
+        try {
+            WorkStealingPool pool(resolve_thread_count());
+            walk_directory(directory_path, pool, [&files, &files_mutex](std::string file_path) {
+                std::lock_guard<std::mutex> lock(files_mutex);
+                files.push_back(std::move(file_path));
+            });
+            pool.wait();
+        } catch (const std::exception& e) {
+            std::cerr << "Error scanning directory: " << e.what() << std::endl;
+        }
+        
+        std::sort(files.begin(), files.end(), path_order_less);
+        return files;
+    }
+    
+    // Walk `directory_path` on `pool`, one task per directory, and call
+    // `on_file` (from worker threads) for every supported regular file as
+    // soon as it is found. Returns immediately; call pool.wait() to finish.
+    // Like fs::recursive_directory_iterator, symlinked directories are not followed.
+    void walk_directory(const std::string& directory_path, WorkStealingPool& pool,
+                        std::function<void(std::string)> on_file) {
+        walk_directory(directory_path, pool, std::move(on_file), nullptr);
+    }
+    
+    // Time and size of one file, filled by the overloads that take it
+    struct FileStats {
+        bool read = false;   // The file could be opened
+        size_t bytes = 0;
+        double read_seconds = 0;
+        double decode_seconds = 0;
+        double scan_seconds = 0;
+        size_t* pattern_matches = nullptr;   // Optional counters, one per pattern
+        const char* skipped = nullptr;       // Why the file was not scanned, see SkippedFile::reason
+        size_t lines_truncated = 0;
+    };
+    
+    // Fast text extraction from a single file
+    std::vector<TextChunk> extract_from_file(const std::string& file_path) {
+        FileStats stats;
+        return extract_from_file(file_path, stats);
+    }
+    
+    std::vector<TextChunk> extract_from_file(const std::string& file_path, FileStats& stats) {
+        // Files over the limit are skipped by their size, without reading them
+        if (max_file_size > 0) {
+            std::error_code error;
+            uintmax_t size = fs::file_size(file_path, error);
+            if (!error && size > max_file_size) {
+                stats.bytes = static_cast<size_t>(size);
+                stats.skipped = "size";
+                return {};
+            }
+        }
+        auto start = std::chrono::steady_clock::now();
+        FileBuffer file;
+        if (!file.open(file_path, mmap_threshold)) {
+            return {};
+        }
+        stats.read = true;
+        stats.bytes = file.view().size();
+        stats.read_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return extract_from_buffer(file_path, file.view(), &stats);
+    }
+    
+    // Extract texts from file contents that are already in memory
+    std::vector<TextChunk> extract_from_buffer(const std::string& file_path, std::string_view data,
+                                               FileStats* stats = nullptr) {
+        if (max_file_size > 0 && data.size() > max_file_size) {
+            if (stats) {
+                stats->skipped = "size";
+            }
+            return {};
+        }
+        ScanScratch& scratch = ScanScratch::local();
+        ScanScratch::Reset reset{scratch};
+        auto start = std::chrono::steady_clock::now();
+        text_encoding::Encoding encoding = resolve_encoding(data);
+        if (skip_binary_files && encoding != text_encoding::Encoding::Utf16LE &&
+            encoding != text_encoding::Encoding::Utf16BE) {
+            if (const char* kind = binary_file_kind(data)) {
+                if (stats) {
+                    stats->skipped = kind;
+                }
+                return {};
+            }
+        }
+        if (encoding == text_encoding::Encoding::Utf8) {
+            return extract_from_text(file_path, data, nullptr, stats);
+        }
+        text_encoding::decode(data, encoding, scratch.decoded);
+        if (stats) {
+            stats->decode_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        return extract_from_text(file_path, scratch.decoded.utf8, &scratch.decoded.map, stats);
+    }
+    
+    // Scan UTF-8 text. `map` leads back to the original bytes when the file
+    // was converted, so columns are reported in the file's own encoding.
+    std::vector<TextChunk> extract_from_text(const std::string& file_path, std::string_view data,
+                                             const text_encoding::OffsetMap* map, FileStats* stats = nullptr) {
+        std::vector<TextChunk> chunks;
+        auto start = std::chrono::steady_clock::now();
+        
+        try {
+            size_t line_start = 0;
+            ScanScratch& scratch = ScanScratch::local();
+            LiteralScanner::State& scanner_state = scratch.scanner;
+            FileScan scan{file_path, std::make_shared<SourceText>(), chunks, scratch, map, format_for(file_path),
+                          stats ? stats->pattern_matches : nullptr};
+            SourceLine line;
+            
+            if (scan.format) {
+                extract_with_format(scan, data);
+                scan.source->lines.shrink_to_fit();
+                if (stats) {
+                    stats->scan_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                }
+                return chunks;
+            }
+            
+            // Same line splitting as std::getline: a trailing newline does not start a new line
+            while (line_start < data.size()) {
+                size_t newline = data.find('\n', line_start);
+                size_t line_end = newline == std::string_view::npos ? data.size() : newline;
+                line.text = data.substr(line_start, line_end - line_start);
+                line.number++;
+                line.offset = std::string::npos;
+                line.start = line_start;
+                line_start = line_end + 1;
+                
+#ifdef _WIN32
+                // Text-mode ifstream used to drop the CR of CRLF line endings
+                if (!line.text.empty() && line.text.back() == '\r') {
+                    line.text.remove_suffix(1);
+                }
+#endif
+                if (max_line_length > 0 && line.text.size() > max_line_length) {
+                    size_t end = max_line_length;
+                    while (end > 0 && (static_cast<unsigned char>(line.text[end]) & 0xC0) == 0x80) {
+                        end--;
+                    }
+                    line.text = line.text.substr(0, end);
+                    if (stats) {
+                        stats->lines_truncated++;
+                    }
+                }
+                
+                if (scan_engine == ScanEngine::Regex) {
+                    extract_with_regex(scan, line);
+                    continue;
+                }
+                
+                scanner.scan_line(line.text, scanner_state);
+                for (const auto& match : scanner_state.matches) {
+                    add_chunk(scan, line, match.group_start, match.group_length,
+                              match.match_start, match.match_length, match.pattern);
+                }
+            }
+            
+            scan.source->lines.shrink_to_fit();
+        } catch (const std::exception& e) {
+            std::cerr << "Error reading file " << file_path << ": " << e.what() << std::endl;
+        }
+        
+        if (stats) {
+            stats->scan_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        return chunks;
+    }
+    
+    // Split texts longer than max_chunk_size into parts
+    std::vector<TextChunk> split_into_chunks(const std::vector<TextChunk>& chunks) {
+        return split_into_chunks(std::vector<TextChunk>(chunks));
+    }
+    
+    // Same, taking ownership. The split happens in place: chunks that fit
+    // are moved to their final slot and only the pieces of long texts are
+    // new strings; context stays shared through the SourceText.
+    std::vector<TextChunk> split_into_chunks(std::vector<TextChunk>&& chunks) {
+        // Piece boundaries of every long text, as (chunk, start, end)
+        struct Piece {
+            size_t chunk;
+            size_t start;
+            size_t end;
+        };
+        std::vector<Piece> pieces;
+        for (size_t c = 0; c < chunks.size(); c++) {
+            const std::string& text = chunks[c].text;
+            if (text.length() <= max_chunk_size) {
+                continue;
+            }
+            size_t start = 0;
+            while (start < text.length()) {
+                size_t end = std::min(start + max_chunk_size, text.length());
+                
+                // Try to break at word boundary
+                if (end < text.length()) {
+                    size_t last_space = text.rfind(' ', end);
+                    if (last_space != std::string::npos && last_space > start) {
+                        end = last_space;
+                    }
+                }
+                pieces.push_back({c, start, end});
+                
+                start = end;
+                if (start < text.length() && text[start] == ' ') {
+                    start++; // Skip the space
+                }
+            }
+        }
+        if (pieces.empty()) {
+            return std::move(chunks);
+        }
+        
+        // Grow once, then fill from the back so nothing is overwritten
+        // before it has been moved
+        size_t extra = 0;
+        for (size_t i = 1; i < pieces.size(); i++) {
+            if (pieces[i].chunk == pieces[i - 1].chunk) {
+                extra++;
+            }
+        }
+        size_t old_size = chunks.size();
+        chunks.resize(old_size + extra);
+        
+        size_t out = chunks.size();
+        size_t p = pieces.size();
+        for (size_t c = old_size; c-- > 0;) {
+            if (p == 0 || pieces[p - 1].chunk != c) {
+                if (--out != c) {
+                    chunks[out] = std::move(chunks[c]);
+                }
+                continue;
+            }
+            size_t first = p;
+            while (first > 0 && pieces[first - 1].chunk == c) {
+                first--;
+            }
+            TextChunk whole = std::move(chunks[c]);
+            std::string text = std::move(whole.text);
+            whole.part_count = p - first;
+            out -= whole.part_count;
+            for (size_t q = first; q < p; q++) {
+                TextChunk& part = chunks[out + q - first];
+                if (q + 1 < p) {
+                    part = whole;
+                    part.text.assign(text, pieces[q].start, pieces[q].end - pieces[q].start);
+                } else {
+                    // The last piece reuses the original buffer
+                    part = std::move(whole);
+                    text.resize(pieces[q].end);
+                    text.erase(0, pieces[q].start);
+                    part.text = std::move(text);
+                }
+                part.part_index = q - first;
+            }
+            p = first;
+        }
+        return std::move(chunks);
+    }
+    
+    // Extract files in parallel and hand each file's chunks to `emit` in file
+    // order. At most a few files per thread are in flight, so memory stays
+    // bounded however many files there are. Stops early if `emit` returns false.
+    // `prepare`, if set, runs on the worker right after a file is extracted.
+    // An exception from either is rethrown here, in the file's turn.
+    void extract_files_ordered(const std::vector<std::string>& files,
+                               const std::function<bool(size_t, std::vector<TextChunk>&)>& emit,
+                               const std::function<void(size_t, std::vector<TextChunk>&)>& prepare = nullptr) {
+        size_t threads = std::min(resolve_thread_count(), files.size());
+        if (threads <= 1) {
+            for (size_t i = 0; i < files.size() && !cancelled(); i++) {
+                std::vector<TextChunk> chunks = extract_from_file(files[i]);
+                if (prepare) {
+                    prepare(i, chunks);
+                }
+                if (!emit(i, chunks)) {
+                    return;
+                }
+            }
+            return;
+        }
+        
+        const size_t window = threads * 4;
+        std::vector<std::vector<TextChunk>> slots(window);
+        std::vector<std::exception_ptr> errors(window);
+        std::vector<char> ready(window, 0);
+        std::mutex slots_mutex;
+        std::condition_variable slot_ready;
+        
+        // Declared after the slots so in-flight tasks finish before the slots go away
+        WorkStealingPool pool(threads);
+        size_t submitted = 0;
+        auto submit_next = [&] {
+            size_t i = submitted++;
+            pool.submit([this, &files, &prepare, &slots, &errors, &ready, &slots_mutex, &slot_ready, window, i] {
+                // A task that throws still fills its slot, or the consumer would wait for it forever
+                std::vector<TextChunk> chunks;
+                std::exception_ptr error;
+                try {
+                    if (!cancelled()) {
+                        chunks = extract_from_file(files[i]);
+                        if (prepare) {
+                            prepare(i, chunks);
+                        }
+                    }
+                } catch (...) {
+                    error = std::current_exception();
+                }
+                {
+                    std::lock_guard<std::mutex> lock(slots_mutex);
+                    slots[i % window] = std::move(chunks);
+                    errors[i % window] = error;
+                    ready[i % window] = 1;
+                }
+                slot_ready.notify_all();
+            });
+        };
+        
+        while (submitted < std::min(window, files.size())) {
+            submit_next();
+        }
+        for (size_t next = 0; next < files.size() && !cancelled(); next++) {
+            std::vector<TextChunk> chunks;
+            std::exception_ptr error;
+            {
+                std::unique_lock<std::mutex> lock(slots_mutex);
+                slot_ready.wait(lock, [&] { return ready[next % window] != 0; });
+                chunks = std::move(slots[next % window]);
+                error = std::move(errors[next % window]);
+                ready[next % window] = 0;
+            }
+            if (error) {
+                std::rethrow_exception(error);
+            }
+            if (submitted < files.size()) {
+                submit_next();
+            }
+            if (!emit(next, chunks)) {
+                return;
+            }
+        }
+    }
+    
+    // Main extraction function
+    ExtractionResult extract_texts(const std::string& directory_path) {
+        auto start_time = std::chrono::high_resolution_clock::now();
+        
+        ExtractionResult result;
+        ProgressCounters counters;
+        ProgressReporter reporter(progress_callback, progress_interval, counters);
+        const size_t thread_count = resolve_thread_count();
+        StatsCollector collector(thread_count, text_pattern_count(), slowest_files, !trace_file.empty());
+        
+        // Each stage ends where the next one starts; the calling thread's
+        // trace track holds the stages
+        auto stage_start = std::chrono::steady_clock::now();
+        double stage_cpu = process_cpu_seconds();
+        auto end_stage = [&](const char* name) {
+            auto now = std::chrono::steady_clock::now();
+            double cpu = process_cpu_seconds();
+            StageTime stage{name, std::chrono::duration<double>(now - stage_start).count(), cpu - stage_cpu};
+            if (collector.trace) {
+                collector.workers.back().events.push_back(
+                    {name, "stage", collector.since_origin(stage_start), stage.wall_seconds});
+            }
+            result.stats.stages.push_back(std::move(stage));
+            stage_start = now;
+            stage_cpu = cpu;
+            return result.stats.stages.back().wall_seconds;
+        };
+        
+        std::unordered_map<std::string, CacheEntry> cached;
+        std::atomic<size_t> reused{0};
+        const bool use_cache = !cache_file.empty();
+        if (use_cache) {
+            cached = load_cache(cache_file);
+            end_stage("cache_load");
+        }
+        
+        // Files are extracted while the walk is still running. Each file gets
+        // its own entry (deque elements never move), and the entries are put
+        // in walk order afterwards so the result does not depend on scheduling.
+        std::deque<FileJob> jobs;
+        std::mutex jobs_mutex;
+        
+        {
+            // With asynchronous reads the walk queues each file on the reader,
+            // and a file is handed to the pool once its contents are in memory.
+            // The reader outlives the pool, which may still release slots.
+            std::optional<async_io::FileReader> reader;
+            WorkStealingPool pool(thread_count);
+            // Stops the reader before the pool goes away, also when a task threw
+            struct StopReader {
+                std::optional<async_io::FileReader>& reader;
+                ~StopReader() {
+                    if (reader) {
+                        reader->cancel();
+                        reader->close();
+                    }
+                }
+            } stop_reader{reader};
+            
+            auto extract_job = [this, &pool, &cached, &reused, &counters, &collector, use_cache](
+                                   FileJob* job, async_io::ReadResult* read) {
+                if (cancelled()) {
+                    return;
+                }
+                auto start = std::chrono::steady_clock::now();
+                WorkerStats& worker = collector.local(pool);
+                FileStats stats;
+                stats.pattern_matches = worker.pattern_matches.data();
+                size_t bytes_read = 0;
+                bool scanned = true;
+                if (read && read->ok && !read->too_large) {
+                    stats.read = true;
+                    stats.bytes = read->data.size();
+                    stats.read_seconds = read->seconds;
+                    job->entry.chunks = extract_from_buffer(job->path, read->data, &stats);
+                    bytes_read = stats.bytes;
+                } else if (read && !read->ok) {
+                    // Unreadable, like extract_from_file when the open fails
+                } else if (!use_cache) {
+                    job->entry.chunks = extract_from_file(job->path, stats);
+                    bytes_read = stats.read ? stats.bytes : 0;
+                } else if (extract_with_cache(job->path, cached, job->entry, stats)) {
+                    reused.fetch_add(1, std::memory_order_relaxed);
+                    scanned = false;
+                } else if (job->entry.readable && stats.read) {
+                    bytes_read = static_cast<size_t>(job->entry.size);
+                }
+                job->done = true;
+                counters.files_processed.fetch_add(1, std::memory_order_relaxed);
+                counters.bytes_read.fetch_add(bytes_read, std::memory_order_relaxed);
+                counters.chunks_found.fetch_add(job->entry.chunks.size(), std::memory_order_relaxed);
+                
+                double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                worker.busy_seconds += seconds;
+                worker.files++;
+                worker.read_seconds += stats.read_seconds;
+                worker.decode_seconds += stats.decode_seconds;
+                worker.scan_seconds += stats.scan_seconds;
+                worker.bytes_read += stats.read ? stats.bytes : 0;
+                worker.files_read += stats.read ? 1 : 0;
+                if (scanned && stats.read) {
+                    if (const auto* format = format_for(job->path)) {
+                        worker.format_matches[format] += job->entry.chunks.size();
+                    }
+                }
+                worker.lines_truncated += stats.lines_truncated;
+                if (stats.skipped) {
+                    worker.skipped.push_back({job->path, stats.skipped, stats.bytes});
+                }
+                collector.add_file(worker, job->path, seconds, stats.bytes, job->entry.chunks.size());
+                if (collector.trace) {
+                    worker.events.push_back({job->path, "file", collector.since_origin(start), seconds});
+                }
+            };
+            
+            if (async_reads && !use_cache) {
+                // Files at or over the mapping threshold or the size limit are
+                // not read; extract_from_file maps them or skips them by size
+                size_t read_limit = max_file_size > 0 ? std::min(mmap_threshold, max_file_size) : mmap_threshold;
+                reader.emplace(io_backend, io_depth, read_limit, [this, &pool, &reader, &extract_job](
+                                   async_io::ReadResult&& read) {
+                    if (cancelled()) {
+                        reader->cancel();
+                        reader->release();
+                        return;
+                    }
+                    auto owned = std::make_shared<async_io::ReadResult>(std::move(read));
+                    pool.submit([owned, &reader, &extract_job] {
+                        // The slot is given back even if the scan throws
+                        struct Release {
+                            async_io::FileReader& reader;
+                            ~Release() {
+                                reader.release();
+                            }
+                        } release{*reader};
+                        extract_job(static_cast<FileJob*>(owned->context), owned.get());
+                        // Free the contents before the slot lets another file in
+                        owned->data = std::string();
+                    });
+                });
+            }
+            
+            walk_directory(directory_path, pool, [&](std::string file_path) {
+                if (cancelled()) {
+                    return;
+                }
+                FileJob* job;
+                {
+                    std::lock_guard<std::mutex> lock(jobs_mutex);
+                    job = &jobs.emplace_back();
+                }
+                job->path = std::move(file_path);
+                counters.files_found.fetch_add(1, std::memory_order_relaxed);
+                if (reader) {
+                    reader->read(job->path, job);
+                } else {
+                    pool.submit([job, &extract_job] { extract_job(job, nullptr); });
+                }
+            }, &collector);
+            pool.wait();
+            if (reader) {
+                // Reads finishing now still queue their scans, so wait again
+                reader->close();
+                pool.wait();
+            }
+        }
+        result.cancelled = cancelled();
+        merge_stats(collector, end_stage("extract"), result.stats);
+        
+        // A cancelled run keeps the files that were finished
+        std::vector<FileJob*> ordered;
+        ordered.reserve(jobs.size());
+        for (auto& job : jobs) {
+            if (job.done) {
+                ordered.push_back(&job);
+            }
+        }
+        std::sort(ordered.begin(), ordered.end(), [](const FileJob* a, const FileJob* b) {
+            return path_order_less(a->path, b->path);
+        });
+        result.total_files_processed = ordered.size();
+        result.files_from_cache = reused.load();
+        
+        // Files that no longer exist are simply not written back. A cancelled
+        // run would drop the entries of files it did not get to, so it keeps
+        // the old cache.
+        if (use_cache && !result.cancelled) {
+            std::vector<std::string> files;
+            std::vector<CacheEntry> entries;
+            files.reserve(ordered.size());
+            entries.reserve(ordered.size());
+            for (FileJob* job : ordered) {
+                files.push_back(job->path);
+                entries.push_back(std::move(job->entry));
+            }
+            save_cache(cache_file, files, entries);
+            for (size_t i = 0; i < ordered.size(); i++) {
+                ordered[i]->entry = std::move(entries[i]);
+            }
+            end_stage("cache_save");
+        }
+        
+        size_t total_chunks = 0;
+        for (const FileJob* job : ordered) {
+            total_chunks += job->entry.chunks.size();
+        }
+        result.chunks.reserve(total_chunks);
+        for (FileJob* job : ordered) {
+            auto& chunks = job->entry.chunks;
+            std::move(chunks.begin(), chunks.end(), std::back_inserter(result.chunks));
+            std::vector<TextChunk>().swap(chunks);
+        }
+        end_stage("merge");
+        
+        // Split into manageable chunks
+        result.chunks = split_into_chunks(std::move(result.chunks));
+        result.total_texts_found = result.chunks.size();
+        end_stage("split");
+        if (deduplicate) {
+            StringInternTable table(result.chunks.size() / 4);
+            for (const auto& chunk : result.chunks) {
+                table.intern(chunk.text);
+            }
+            result.unique_texts_found = table.size();
+            end_stage("dedup");
+        }
+        
+        auto end_time = std::chrono::high_resolution_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
+        result.processing_time = duration.count() / 1000.0;
+        
+        if (collector.trace) {
+            write_trace(trace_file, collector);
+        }
+        reporter.finish();
+        return result;
+    }
+    
+    // Save extracted texts to files
+    void save_extracted_texts(const std::vector<TextChunk>& chunks, const std::string& output_dir) {
+        try {
+            fs::create_directories(output_dir);
+            
+            // Group chunks by file as index lists, in order of first appearance
+            std::vector<std::vector<size_t>> groups;
+            {
+                std::unordered_map<std::string_view, size_t> group_of_file;
+                for (size_t i = 0; i < chunks.size(); i++) {
+                    auto inserted = group_of_file.try_emplace(chunks[i].file_path, groups.size());
+                    if (inserted.second) {
+                        groups.emplace_back();
+                    }
+                    groups[inserted.first->second].push_back(i);
+                }
+            }
+            std::vector<std::string_view> group_paths;
+            group_paths.reserve(groups.size());
+            for (const auto& group : groups) {
+                group_paths.push_back(chunks[group.front()].file_path);
+            }
+            std::vector<std::string> output_names = extracted_file_names(group_paths);
+            
+            // Master entries: one per chunk, or one per distinct text
+            UniqueTexts unique;
+            if (deduplicate) {
+                unique = deduplicate_texts(chunks);
+            }
+            const size_t entry_count = deduplicate ? unique.texts.size() : chunks.size();
+            
+            // Master file segments, formatted on the pool and written in order.
+            // Declared before the pool so in-flight tasks finish before they go away.
+            const size_t threads = resolve_thread_count();
+            const size_t segment_size = 16384;
+            const size_t segment_count = (entry_count + segment_size - 1) / segment_size;
+            const size_t window = threads * 2;
+            std::vector<std::string> segments(window);
+            std::vector<std::exception_ptr> segment_errors(window);
+            std::vector<char> ready(window, 0);
+            std::mutex segments_mutex;
+            std::condition_variable segment_ready;
+            
+            WorkStealingPool pool(threads);
+            
+            // Save each file's chunks
+            for (size_t g = 0; g < groups.size(); g++) {
+                pool.submit([&chunks, &groups, &output_names, &output_dir, g] {
+                    const std::vector<size_t>& group = groups[g];
+                    std::string output_file = output_dir + "/" + output_names[g];
+                    BufferedFileWriter file(output_file);
+                    if (!file.is_open()) {
+                        std::cerr << "Could not write extracted texts: " << output_file << std::endl;
+                        return;
+                    }
+                    append_extracted_header(file.data(), chunks[group.front()].file_path);
+                    for (size_t i : group) {
+                        append_extracted_entry(file.data(), chunks[i]);
+                        file.maybe_flush();
+                    }
+                    if (!file.close()) {
+                        std::cerr << "Error writing extracted texts: " << output_file << std::endl;
+                    }
+                });
+            }
+            
+            // Save master translation file; at most `window` segments are in memory
+            std::string master_file = output_dir + "/master_translation.txt";
+            BufferedFileWriter master(master_file);
+            if (master.is_open()) {
+                master.write("=== MASTER TRANSLATION FILE ===\n\n");
+                
+                size_t submitted = 0;
+                auto submit_next = [&] {
+                    size_t s = submitted++;
+                    pool.submit([this, &chunks, &unique, &segments, &segment_errors, &ready, &segments_mutex,
+                                 &segment_ready, entry_count, window, segment_size, s] {
+                        // A task that throws still marks its segment ready, or the writer would wait for it forever
+                        std::string out;
+                        std::exception_ptr error;
+                        try {
+                            size_t last = std::min(entry_count, (s + 1) * segment_size);
+                            for (size_t i = s * segment_size; i < last; i++) {
+                                out += "ID: ";
+                                append_number(out, i + 1);
+                                if (deduplicate) {
+                                    out += "\nOccurrences: ";
+                                    append_number(out, unique.count(i));
+                                    for (size_t o = unique.occurrence_offsets[i]; o < unique.occurrence_offsets[i + 1]; o++) {
+                                        append_location(out, chunks[unique.occurrence_chunks[o]]);
+                                    }
+                                } else {
+                                    append_location(out, chunks[i]);
+                                }
+                                out += "\nOriginal: ";
+                                out += deduplicate ? unique.texts[i] : chunks[i].text;
+                                out += "\nTranslation: \n---\n\n";
+                            }
+                        } catch (...) {
+                            error = std::current_exception();
+                        }
+                        {
+                            std::lock_guard<std::mutex> lock(segments_mutex);
+                            segments[s % window] = std::move(out);
+                            segment_errors[s % window] = error;
+                            ready[s % window] = 1;
+                        }
+                        segment_ready.notify_all();
+                    });
+                };
+                
+                while (submitted < std::min(window, segment_count)) {
+                    submit_next();
+                }
+                for (size_t next = 0; next < segment_count; next++) {
+                    std::string segment;
+                    std::exception_ptr error;
+                    {
+                        std::unique_lock<std::mutex> lock(segments_mutex);
+                        segment_ready.wait(lock, [&] { return ready[next % window] != 0; });
+                        segment = std::move(segments[next % window]);
+                        error = std::move(segment_errors[next % window]);
+                        ready[next % window] = 0;
+                    }
+                    if (error) {
+                        std::rethrow_exception(error);
+                    }
+                    if (submitted < segment_count) {
+                        submit_next();
+                    }
+                    master.write(segment);
+                }
+                
+                if (!master.close()) {
+                    std::cerr << "Error writing extracted texts: " << master_file << std::endl;
+                }
+            } else {
+                std::cerr << "Could not write extracted texts: " << master_file << std::endl;
+            }
+            
+            pool.wait();
+            
+        } catch (const std::exception& e) {
+            std::cerr << "Error saving extracted texts: " << e.what() << std::endl;
+        }
+    }
+    
+    // extract_texts followed by save_extracted_texts, without holding the
+    // result: files are extracted a few per thread at a time (see
+    // extract_files_ordered), each file's output is written by the worker
+    // that extracted it and its master entries are appended as soon as the
+    // files before it are done. The returned result has no chunks. With
+    // set_deduplicate(true) the master file lists every location of a text
+    // under its first one, so the distinct texts and the locations (not the
+    // chunks) are kept until the end.
+    ExtractionResult extract_to_directory(const std::string& directory_path, const std::string& output_dir) {
+        auto start_time = std::chrono::high_resolution_clock::now();
+        ExtractionResult result;
+        result.total_files_processed = 0;
+        result.total_texts_found = 0;
+        ProgressCounters counters;
+        ProgressReporter reporter(progress_callback, progress_interval, counters);
+        
+        try {
+            std::vector<std::string> files = scan_directory(directory_path);
+            counters.files_found.store(files.size(), std::memory_order_relaxed);
+            
+            fs::create_directories(output_dir);
+            std::string master_file = output_dir + "/master_translation.txt";
+            BufferedFileWriter master(master_file);
+            if (!master.is_open()) {
+                std::cerr << "Could not write extracted texts: " << master_file << std::endl;
+                return result;
+            }
+            master.write("=== MASTER TRANSLATION FILE ===\n\n");
+            
+            // Output names depend on which files turn out to have texts, so
+            // each file is written under its index and renamed at the end
+            const std::string staging_dir = output_dir + "/.extracting";
+            fs::create_directories(staging_dir);
+            auto staged_file = [&staging_dir](size_t i) {
+                std::string path = staging_dir + "/";
+                append_number(path, i);
+                return path;
+            };
+            
+            // Where each text of a deduplicated master file occurs
+            struct Location {
+                uint32_t text_id;
+                uint32_t file;      // Index into written_files
+                uint32_t part_index;
+                uint32_t part_count;
+                size_t line_number;
+                size_t column_start;
+                size_t column_end;
+            };
+            StringInternTable table;
+            std::deque<std::string> texts;   // The table only holds views; chunks do not outlive emit
+            std::vector<Location> locations;
+            
+            std::vector<size_t> written_files;   // Indices into `files` of the files with texts
+            
+            extract_files_ordered(files, [&](size_t i, std::vector<TextChunk>& chunks) {
+                counters.files_processed.fetch_add(1, std::memory_order_relaxed);
+                result.total_files_processed++;
+                if (chunks.empty()) {
+                    return true;
+                }
+                counters.chunks_found.fetch_add(chunks.size(), std::memory_order_relaxed);
+                uint32_t file = static_cast<uint32_t>(written_files.size());
+                written_files.push_back(i);
+                
+                std::string& out = master.data();
+                for (const TextChunk& chunk : chunks) {
+                    result.total_texts_found++;
+                    if (deduplicate) {
+                        uint32_t id = table.find(chunk.text);
+                        if (id == StringInternTable::npos) {
+                            id = table.intern(texts.emplace_back(chunk.text)).first;
+                        }
+                        locations.push_back({id, file,
+                                             static_cast<uint32_t>(chunk.part_index),
+                                             static_cast<uint32_t>(chunk.part_count), chunk.line_number,
+                                             chunk.column_start, chunk.column_end});
+                        continue;
+                    }
+                    out += "ID: ";
+                    append_number(out, result.total_texts_found);
+                    append_location(out, chunk);
+                    out += "\nOriginal: ";
+                    out += chunk.text;
+                    out += "\nTranslation: \n---\n\n";
+                    master.maybe_flush();
+                }
+                return true;
+            }, [&](size_t i, std::vector<TextChunk>& chunks) {
+                std::error_code size_error;
+                auto size = fs::file_size(files[i], size_error);
+                if (!size_error) {
+                    counters.bytes_read.fetch_add(static_cast<size_t>(size), std::memory_order_relaxed);
+                }
+                if (chunks.empty()) {
+                    return;
+                }
+                chunks = split_into_chunks(std::move(chunks));
+                std::string output_file = staged_file(i);
+                BufferedFileWriter file(output_file);
+                if (!file.is_open()) {
+                    std::cerr << "Could not write extracted texts: " << output_file << std::endl;
+                    return;
+                }
+                append_extracted_header(file.data(), files[i]);
+                for (const TextChunk& chunk : chunks) {
+                    append_extracted_entry(file.data(), chunk);
+                    file.maybe_flush();
+                }
+                if (!file.close()) {
+                    std::cerr << "Error writing extracted texts: " << output_file << std::endl;
+                }
+            });
+            result.cancelled = cancelled();
+            
+            if (deduplicate) {
+                result.unique_texts_found = table.size();
+                
+                // Counting sort of the locations by text id keeps them in
+                // walk order within each text
+                std::vector<size_t> offsets(table.size() + 1, 0);
+                for (const Location& location : locations) {
+                    offsets[location.text_id + 1]++;
+                }
+                for (size_t id = 0; id < table.size(); id++) {
+                    offsets[id + 1] += offsets[id];
+                }
+                std::vector<uint32_t> order(locations.size());
+                std::vector<size_t> next(offsets.begin(), offsets.end() - 1);
+                for (size_t l = 0; l < locations.size(); l++) {
+                    order[next[locations[l].text_id]++] = static_cast<uint32_t>(l);
+                }
+                
+                std::string& out = master.data();
+                for (uint32_t id = 0; id < table.size(); id++) {
+                    out += "ID: ";
+                    append_number(out, id + 1);
+                    out += "\nOccurrences: ";
+                    append_number(out, offsets[id + 1] - offsets[id]);
+                    for (size_t o = offsets[id]; o < offsets[id + 1]; o++) {
+                        const Location& location = locations[order[o]];
+                        append_location(out, files[written_files[location.file]], location.line_number,
+                                        location.column_start, location.column_end, location.part_index,
+                                        location.part_count);
+                    }
+                    out += "\nOriginal: ";
+                    out += table.at(id);
+                    out += "\nTranslation: \n---\n\n";
+                    master.maybe_flush();
+                }
+            }
+            if (!master.close()) {
+                std::cerr << "Error writing extracted texts: " << master_file << std::endl;
+            }
+            
+            std::vector<std::string_view> paths;
+            paths.reserve(written_files.size());
+            for (size_t i : written_files) {
+                paths.push_back(files[i]);
+            }
+            std::vector<std::string> output_names = extracted_file_names(paths);
+            for (size_t f = 0; f < written_files.size(); f++) {
+                std::error_code rename_error;
+                fs::rename(staged_file(written_files[f]), output_dir + "/" + output_names[f], rename_error);
+                if (rename_error) {
+                    std::cerr << "Error writing extracted texts: " << output_dir << "/" << output_names[f] << ": "
+                              << rename_error.message() << std::endl;
+                }
+            }
+            std::error_code remove_error;
+            fs::remove_all(staging_dir, remove_error);
+        } catch (const std::exception& e) {
+            std::cerr << "Error saving extracted texts: " << e.what() << std::endl;
+        }
+        
+        auto end_time = std::chrono::high_resolution_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
+        result.processing_time = duration.count() / 1000.0;
+        reporter.finish();
+        return result;
+    }
+    
+    // Apply the translations filled into a master translation file. Each
+    // translated text is spliced into a copy of its source file at the
+    // recorded line and columns; copies go to output_dir, laid out relative
+    // to the common root of the source files. Returns the number of texts applied.
+    size_t apply_translations(const std::string& translation_file, const std::string& output_dir) {
+        try {
+            std::ifstream file(translation_file);
+            if (!file.is_open()) {
+                std::cerr << "Could not open translation file: " << translation_file << std::endl;
+                return 0;
+            }
+            
+            std::vector<TranslationEntry> entries;
+            std::string line;
+            std::string* continued = nullptr;   // Field that text without a prefix belongs to
+            size_t first_location = 0;          // Deduplicated entries list several File: locations
+            
+            // Copy the text of a deduplicated entry to all of its locations
+            auto finish_entry = [&entries, &first_location] {
+                for (size_t e = first_location; e + 1 < entries.size(); e++) {
+                    entries[e].original = entries.back().original;
+                    entries[e].translation = entries.back().translation;
+                }
+            };
+            
+            while (std::getline(file, line)) {
+                if (line.find("ID: ") == 0) {
+                    finish_entry();
+                    first_location = entries.size();
+                    entries.emplace_back();
+                    continued = nullptr;
+                } else if (entries.empty()) {
+                    continue;
+                } else if (line.find("File: ") == 0) {
+                    if (!entries.back().file_path.empty()) {
+                        entries.emplace_back();
+                    }
+                    entries.back().file_path = line.substr(6);
+                    continued = nullptr;
+                } else if (line.find("Line: ") == 0) {
+                    entries.back().line_number = std::strtoull(line.c_str() + 6, nullptr, 10);
+                    continued = nullptr;
+                } else if (line.find("Columns: ") == 0) {
+                    char* dash = nullptr;
+                    size_t column_start = std::strtoull(line.c_str() + 9, &dash, 10);
+                    if (dash && *dash == '-') {
+                        entries.back().column_start = column_start;
+                        entries.back().column_end = std::strtoull(dash + 1, nullptr, 10);
+                    }
+                    continued = nullptr;
+                } else if (line.find("Part: ") == 0) {
+                    size_t part = std::strtoull(line.c_str() + 6, nullptr, 10);
+                    if (part > 0) {
+                        entries.back().part = part - 1;
+                    }
+                    continued = nullptr;
+                } else if (line.find("Original: ") == 0) {
+                    entries.back().original = line.substr(10);
+                    continued = &entries.back().original;
+                } else if (line.find("Translation: ") == 0) {
+                    entries.back().translation = line.substr(13);
+                    continued = &entries.back().translation;
+                } else if (line == "---") {
+                    continued = nullptr;
+                } else if (continued) {
+                    // Texts with line breaks span several lines of the master file
+                    *continued += '\n';
+                    *continued += line;
+                }
+            }
+            
+            finish_entry();
+            file.close();
+            
+            // Translations are typed like the source strings, so "\n" means a line break
+            for (auto& entry : entries) {
+                entry.translation = text_unescape::unescape(entry.translation);
+                if (entry.part == std::string::npos) {
+                    entry.part = strip_part_suffix(entry.file_path);
+                }
+            }
+            
+            return apply_translation_entries(entries, output_dir);
+            
+        } catch (const std::exception& e) {
+            std::cerr << "Error applying translations: " << e.what() << std::endl;
+            return 0;
+        }
+    }
+    
+    // Same as apply_translations, for chunks and a map of original text to translation
+    size_t apply_translation_map(const std::vector<TextChunk>& chunks,
+                                 const std::unordered_map<std::string, std::string>& translations,
+                                 const std::string& output_dir) {
+        try {
+            std::vector<TranslationEntry> entries;
+            for (const auto& chunk : chunks) {
+                auto found = translations.find(chunk.text);
+                TranslationEntry entry;
+                entry.file_path = chunk.file_path;
+                entry.part = chunk.part_count > 1 ? chunk.part_index : std::string::npos;
+                entry.line_number = chunk.line_number;
+                entry.column_start = chunk.column_start;
+                entry.column_end = chunk.column_end;
+                entry.original = chunk.text;
+                if (found != translations.end()) {
+                    entry.translation = found->second;
+                }
+                entries.push_back(std::move(entry));
+            }
+            return apply_translation_entries(entries, output_dir);
+            
+        } catch (const std::exception& e) {
+            std::cerr << "Error applying translations: " << e.what() << std::endl;
+            return 0;
+        }
+    }
+
+private:
+    // One file's entry in the incremental extraction cache
+    struct CacheEntry {
+        uint64_t size = 0;
+        int64_t mtime = 0;
+        uint64_t hash = 0;   // 0 when the content was not hashed
+        bool readable = true;
+        std::vector<TextChunk> chunks;
+    };
+    
+    // Per-file output of save_extracted_texts and extract_to_directory
+    static void append_extracted_header(std::string& out, std::string_view file_path) {
+        out += "=== EXTRACTED TEXTS FROM: ";
+        out += file_path;
+        out += " ===\n\n";
+    }
+    
+    static void append_extracted_entry(std::string& out, const TextChunk& chunk) {
+        out += "Line ";
+        append_number(out, chunk.line_number);
+        if (chunk.part_count > 1) {
+            out += " (part ";
+            append_number(out, chunk.part_index + 1);
+            out += '/';
+            append_number(out, chunk.part_count);
+            out += ')';
+        }
+        out += ":\nContext: ";
+        out += chunk.context();
+        out += "\nText: ";
+        out += chunk.text;
+        out += "\nOriginal: ";
+        out += chunk.original_text();
+        out += "\n---\n\n";
+    }
+    
+    // Location lines of one master file entry
+    static void append_location(std::string& out, std::string_view file_path, size_t line_number,
+                                size_t column_start, size_t column_end, size_t part_index, size_t part_count) {
+        out += "\nFile: ";
+        out += file_path;
+        out += "\nLine: ";
+        append_number(out, line_number);
+        out += "\nColumns: ";
+        append_number(out, column_start);
+        out += '-';
+        append_number(out, column_end);
+        if (part_count > 1) {
+            out += "\nPart: ";
+            append_number(out, part_index + 1);
+            out += '/';
+            append_number(out, part_count);
+        }
+    }
+    
+    static void append_location(std::string& out, const TextChunk& chunk) {
+        append_location(out, chunk.file_path, chunk.line_number, chunk.column_start, chunk.column_end,
+                        chunk.part_index, chunk.part_count);
+    }
+    
+    // Output name for each source file that has texts: "<basename>_extracted.txt"
+    // when the basename is unique (ignoring case, as Windows does), otherwise
+    // the basename plus a hash of the full source path
+    static std::vector<std::string> extracted_file_names(const std::vector<std::string_view>& paths) {
+        auto lower = [](std::string text) {
+            std::transform(text.begin(), text.end(), text.begin(), [](unsigned char ch) {
+                return static_cast<char>(std::tolower(ch));
+            });
+            return text;
+        };
+        
+        std::vector<std::string> basenames;
+        std::unordered_map<std::string, size_t> basename_count;
+        basenames.reserve(paths.size());
+        for (std::string_view path : paths) {
+            basenames.push_back(fs::path(path).filename().string());
+            basename_count[lower(basenames.back())]++;
+        }
+        
+        std::vector<std::string> names(paths.size());
+        std::unordered_map<std::string, size_t> taken;
+        for (size_t g = 0; g < paths.size(); g++) {
+            if (basename_count[lower(basenames[g])] == 1) {
+                names[g] = basenames[g] + "_extracted.txt";
+                taken[lower(names[g])] = g;
+            }
+        }
+        for (size_t g = 0; g < paths.size(); g++) {
+            if (!names[g].empty()) {
+                continue;
+            }
+            std::string_view source_path = paths[g];
+            for (uint64_t salt = 0;; salt++) {
+                char suffix[20];
+                uint64_t hash = fnv1a_64(source_path, 1469598103934665603ULL + salt);
+                std::snprintf(suffix, sizeof(suffix), "_%08x", static_cast<unsigned>(hash & 0xffffffffu));
+                std::string name = basenames[g] + suffix + "_extracted.txt";
+                if (taken.try_emplace(lower(name), g).second) {
+                    names[g] = std::move(name);
+                    break;
+                }
+            }
+        }
+        return names;
+    }
+    
+    // One text to write back, parsed from a master file or built from a chunk
+    struct TranslationEntry {
+        std::string file_path;
+        size_t part = std::string::npos;            // Part index of a split text, npos if it was not split
+        size_t line_number = 0;
+        size_t column_start = std::string::npos;    // npos if the master file predates columns
+        size_t column_end = std::string::npos;
+        std::string original;
+        std::string translation;                    // Empty if not translated
+    };
+    
+    // Master files written before TextChunk::part_index marked parts with a
+    // "_chunk_N" suffix on the path. Remove it and return N.
+    static size_t strip_part_suffix(std::string& file_path) {
+        static constexpr std::string_view marker = "_chunk_";
+        size_t digits = file_path.size();
+        while (digits > 0 && std::isdigit(static_cast<unsigned char>(file_path[digits - 1]))) {
+            digits--;
+        }
+        if (digits == file_path.size() || digits < marker.size() ||
+            file_path.compare(digits - marker.size(), marker.size(), marker) != 0) {
+            return std::string::npos;
+        }
+        std::error_code ec;
+        if (fs::exists(file_path, ec)) {
+            return std::string::npos;
+        }
+        size_t part = std::strtoull(file_path.c_str() + digits, nullptr, 10);
+        file_path.resize(digits - marker.size());
+        return part;
+    }
+    
+    size_t apply_translation_entries(std::vector<TranslationEntry>& entries, const std::string& output_dir) {
+        // Group by file; only files with at least one translation are written
+        std::vector<std::string> all_files;
+        std::vector<std::vector<TranslationEntry*>> by_file;
+        std::unordered_map<std::string, size_t> file_index;
+        for (auto& entry : entries) {
+            auto inserted = file_index.try_emplace(entry.file_path, all_files.size());
+            if (inserted.second) {
+                all_files.push_back(entry.file_path);
+                by_file.emplace_back();
+            }
+            by_file[inserted.first->second].push_back(&entry);
+        }
+        
+        fs::path root = common_root(all_files);
+        std::vector<size_t> translated_files;
+        std::vector<std::string> output_paths(all_files.size());
+        for (size_t f = 0; f < all_files.size(); f++) {
+            bool translated = std::any_of(by_file[f].begin(), by_file[f].end(), [](const TranslationEntry* entry) {
+                return !entry->translation.empty();
+            });
+            if (!translated) {
+                continue;
+            }
+            fs::path relative = fs::path(all_files[f]).lexically_relative(root);
+            if (relative.empty()) {
+                relative = fs::path(all_files[f]).filename();
+            }
+            fs::path output_path = fs::path(output_dir) / relative;
+            // Created up front: concurrent create_directories calls can fail on each other
+            fs::create_directories(output_path.parent_path());
+            output_paths[f] = output_path.string();
+            translated_files.push_back(f);
+        }
+        
+        std::atomic<size_t> applied{0};
+        WorkStealingPool pool(resolve_thread_count());
+        for (size_t f : translated_files) {
+            pool.submit([this, &all_files, &by_file, &output_paths, &applied, f] {
+                applied.fetch_add(apply_file_translations(all_files[f], output_paths[f], by_file[f]),
+                                  std::memory_order_relaxed);
+            });
+        }
+        pool.wait();
+        return applied.load();
+    }
+    
+    // Write a copy of `source_path` with its translated texts spliced in, one
+    // pass over the file with the edits sorted by position
+    size_t apply_file_translations(const std::string& source_path, const std::string& output_path,
+                                   std::vector<TranslationEntry*>& entries) {
+        // Entries from master files without columns are located by extracting the file again
+        if (std::any_of(entries.begin(), entries.end(), [](const TranslationEntry* entry) {
+                return entry->column_start == std::string::npos && !entry->translation.empty();
+            })) {
+            locate_entries(source_path, entries);
+        }
+        
+        // Where two patterns found the same text, the translated entry comes first
+        std::sort(entries.begin(), entries.end(), [](const TranslationEntry* a, const TranslationEntry* b) {
+            bool a_untranslated = a->translation.empty();
+            bool b_untranslated = b->translation.empty();
+            return std::tie(a->line_number, a->column_start, a->column_end, a->part, a_untranslated) <
+                   std::tie(b->line_number, b->column_start, b->column_end, b->part, b_untranslated);
+        });
+        
+        auto buffer = std::make_unique<FileBuffer>();
+        if (!buffer->open(source_path, mmap_threshold)) {
+            std::cerr << "Could not open source file: " << source_path << std::endl;
+            return 0;
+        }
+        std::string_view data = buffer->view();
+        
+        // Lines and columns are matched on the UTF-8 text, splices go into the original bytes
+        text_encoding::Encoding encoding = resolve_encoding(data);
+        text_encoding::DecodedText decoded;
+        std::string_view text = data;
+        const bool converted = encoding != text_encoding::Encoding::Utf8;
+        if (converted) {
+            text_encoding::decode(data, encoding, decoded);
+            text = decoded.utf8;
+        }
+        const format_extract::FormatExtractor* format = format_for(source_path);
+        const format_extract::TextCodec& codec = format ? *format : format_extract::pattern_codec();
+        auto to_source = [&](size_t offset) { return converted ? decoded.map.to_source(offset) : offset; };
+        auto to_utf8 = [&](size_t offset) { return converted ? decoded.map.to_utf8(offset) : offset; };
+        
+        // Absolute byte ranges and their replacements, in file order
+        struct Splice {
+            size_t begin;
+            size_t end;
+            std::string text;
+        };
+        std::vector<Splice> splices;
+        size_t skipped = 0;
+        size_t unencodable = 0;
+        
+        size_t line_number = 1;
+        size_t line_start = 0;
+        std::string translated;
+        for (size_t i = 0; i < entries.size();) {
+            // All entries with the same span: one text, or the parts of a split text
+            size_t group_end = i + 1;
+            while (group_end < entries.size() && entries[group_end]->line_number == entries[i]->line_number &&
+                   entries[group_end]->column_start == entries[i]->column_start &&
+                   entries[group_end]->column_end == entries[i]->column_end) {
+                group_end++;
+            }
+            const TranslationEntry& first = *entries[i];
+            bool has_translation = std::any_of(entries.begin() + i, entries.begin() + group_end,
+                                               [](const TranslationEntry* entry) { return !entry->translation.empty(); });
+            size_t group_start = i;
+            i = group_end;
+            if (!has_translation) {
+                continue;
+            }
+            if (first.column_start == std::string::npos || first.line_number < line_number) {
+                skipped++;
+                continue;
+            }
+            
+            while (line_number < first.line_number && line_start < text.size()) {
+                size_t newline = text.find('\n', line_start);
+                line_start = newline == std::string_view::npos ? text.size() : newline + 1;
+                line_number++;
+            }
+            size_t newline = text.find('\n', line_start);
+            std::string_view line = text.substr(line_start, (newline == std::string_view::npos ? text.size() : newline) - line_start);
+#ifdef _WIN32
+            if (!line.empty() && line.back() == '\r') {
+                line.remove_suffix(1);
+            }
+#endif
+            size_t source_line_start = to_source(line_start);
+            size_t begin = source_line_start + first.column_start;
+            size_t end = source_line_start + first.column_end;
+            size_t column_start = to_utf8(begin) - line_start;
+            size_t column_end = to_utf8(end) - line_start;
+            if (line_number != first.line_number || first.column_start > first.column_end ||
+                end > data.size() || to_utf8(begin) < line_start || column_end > line.size() ||
+                (!splices.empty() && begin < splices.back().end)) {
+                skipped++;
+                continue;
+            }
+            
+            // The span must still hold the extracted text; parts are matched
+            // in order, separated by the single space the split dropped
+            std::string current;
+            codec.decode(line, column_start, column_end, current);
+            translated.clear();
+            size_t position = 0;
+            size_t previous_part = std::string::npos;
+            bool matches = true;
+            for (size_t e = group_start; e < group_end && matches; e++) {
+                const TranslationEntry& entry = *entries[e];
+                if (e > group_start && entry.part == previous_part) {
+                    continue;   // Same text found by two patterns
+                }
+                previous_part = entry.part;
+                if (current.compare(position, entry.original.size(), entry.original) != 0) {
+                    matches = false;
+                    break;
+                }
+                position += entry.original.size();
+                translated += entry.translation.empty() ? entry.original : entry.translation;
+                if (position < current.size() && current[position] == ' ') {
+                    translated += ' ';
+                    position++;
+                }
+            }
+            if (!matches || position != current.size()) {
+                skipped++;
+                continue;
+            }
+            
+            Splice splice{begin, end, std::string()};
+            codec.encode(translated, line, column_start, column_end, splice.text);
+            if (converted) {
+                std::string escaped = std::move(splice.text);
+                if (!text_encoding::encode(escaped, encoding, splice.text)) {
+                    unencodable++;
+                    continue;
+                }
+            }
+            splices.push_back(std::move(splice));
+        }
+        
+        if (skipped > 0) {
+            std::cerr << "Skipped " << skipped << " translations in " << source_path
+                      << ": the text at the recorded position has changed" << std::endl;
+        }
+        if (unencodable > 0) {
+            std::cerr << "Skipped " << unencodable << " translations in " << source_path
+                      << ": they contain characters that " << text_encoding::encoding_name(encoding)
+                      << " cannot represent" << std::endl;
+        }
+        if (splices.empty()) {
+            return 0;
+        }
+        
+        // Written next to the target and renamed, so output_dir may be the source tree itself
+        std::string temp_path = output_path + ".tmp";
+        {
+            BufferedFileWriter out(temp_path, std::ios::out | std::ios::binary);
+            if (!out.is_open()) {
+                std::cerr << "Could not write translated file: " << output_path << std::endl;
+                return 0;
+            }
+            size_t written = 0;
+            for (const auto& splice : splices) {
+                out.write(data.substr(written, splice.begin - written));
+                out.write(splice.text);
+                written = splice.end;
+            }
+            out.write(data.substr(written));
+            if (!out.close()) {
+                std::cerr << "Error writing translated file: " << output_path << std::endl;
+                return 0;
+            }
+        }
+        buffer.reset();   // Unmapped before the rename, which Windows refuses on a mapped file
+        
+        std::error_code ec;
+        fs::rename(temp_path, output_path, ec);
+        if (ec) {
+            std::cerr << "Error writing translated file: " << output_path << ": " << ec.message() << std::endl;
+            fs::remove(temp_path, ec);
+            return 0;
+        }
+        return splices.size();
+    }
+    
+    // Fill in columns for entries that only know their line and text
+    void locate_entries(const std::string& source_path, std::vector<TranslationEntry*>& entries) {
+        std::vector<TextChunk> chunks = split_into_chunks(extract_from_file(source_path));
+        std::vector<char> used(chunks.size(), 0);
+        for (TranslationEntry* entry : entries) {
+            if (entry->column_start != std::string::npos) {
+                continue;
+            }
+            for (size_t c = 0; c < chunks.size(); c++) {
+                size_t part = chunks[c].part_count > 1 ? chunks[c].part_index : std::string::npos;
+                if (!used[c] && chunks[c].line_number == entry->line_number && chunks[c].text == entry->original &&
+                    part == entry->part) {
+                    entry->column_start = chunks[c].column_start;
+                    entry->column_end = chunks[c].column_end;
+                    used[c] = 1;
+                    break;
+                }
+            }
+        }
+    }
+    
+    // A file found by the walker and the chunks extracted from it
+    struct FileJob {
+        std::string path;
+        CacheEntry entry;
+        bool done = false;   // False if cancelled before the file was extracted
+    };
+    
+    // Progress reporting and cancellation (see set_progress_callback and set_cancel_token)
+    ProgressCallback progress_callback;
+    double progress_interval = 0.5;
+    std::shared_ptr<CancellationToken> cancel_token;
+    
+    bool cancelled() const {
+        return cancel_token && cancel_token->is_cancelled();
+    }
+    
+    // Counters the workers of one extract_texts bump for the reporter
+    struct ProgressCounters {
+        std::atomic<size_t> files_found{0};
+        std::atomic<size_t> files_processed{0};
+        std::atomic<size_t> bytes_read{0};
+        std::atomic<size_t> chunks_found{0};
+    };
+    
+    // Calls the progress callback from its own thread every interval until
+    // finish(), which sends the final report. Without a callback it does nothing.
+    class ProgressReporter {
+    public:
+        ProgressReporter(const ProgressCallback& callback, double interval_seconds, const ProgressCounters& counters)
+            : callback(callback), interval(interval_seconds), counters(counters),
+              start(std::chrono::steady_clock::now()) {
+            if (callback) {
+                thread = std::thread([this] { run(); });
+            }
+        }
+        
+        ~ProgressReporter() {
+            finish();
+        }
+        
+        ProgressReporter(const ProgressReporter&) = delete;
+        ProgressReporter& operator=(const ProgressReporter&) = delete;
+        
+        void finish() {
+            if (finished) {
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            wake.notify_all();
+            if (thread.joinable()) {
+                thread.join();
+            }
+            finished = true;
+            report(true);
+        }
+        
+    private:
+        const ProgressCallback& callback;
+        std::chrono::duration<double> interval;
+        const ProgressCounters& counters;
+        std::chrono::steady_clock::time_point start;
+        std::thread thread;
+        std::mutex mutex;
+        std::condition_variable wake;
+        bool stopping = false;
+        bool finished = false;
+        bool failed = false;   // The callback threw; stop calling it
+        
+        void run() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (!wake.wait_for(lock, interval, [this] { return stopping; })) {
+                lock.unlock();
+                report(false);
+                lock.lock();
+            }
+        }
+        
+        void report(bool last) {
+            if (!callback || failed) {
+                return;
+            }
+            ExtractionProgress progress;
+            progress.files_found = counters.files_found.load(std::memory_order_relaxed);
+            progress.files_processed = counters.files_processed.load(std::memory_order_relaxed);
+            progress.bytes_read = counters.bytes_read.load(std::memory_order_relaxed);
+            progress.chunks_found = counters.chunks_found.load(std::memory_order_relaxed);
+            progress.elapsed_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            progress.finished = last;
+            if (last) {
+                progress.eta_seconds = 0;
+            } else if (progress.files_processed > 0 && progress.files_found >= progress.files_processed) {
+                progress.eta_seconds = progress.elapsed_seconds * (progress.files_found - progress.files_processed) /
+                                       progress.files_processed;
+            }
+            try {
+                callback(progress);
+            } catch (const std::exception& e) {
+                std::cerr << "Error in progress callback: " << e.what() << std::endl;
+                failed = true;
+            }
+        }
+    };
+    
+    // Statistics of extract_texts (see ExtractionResult::stats, set_slowest_files and set_trace_file)
+    size_t slowest_files = 10;
+    std::string trace_file;
+    
+    // One span of the trace; times are seconds since extract_texts started
+    struct TraceEvent {
+        std::string name;
+        const char* category;
+        double start;
+        double duration;
+    };
+    
+    // Counters of one thread, merged after the pool is done. Aligned so the
+    // workers do not write to the same cache line.
+    struct alignas(64) WorkerStats {
+        double busy_seconds = 0;
+        size_t files = 0;
+        double walk_seconds = 0;
+        double read_seconds = 0;
+        double decode_seconds = 0;
+        double scan_seconds = 0;
+        size_t bytes_read = 0;
+        size_t files_read = 0;
+        std::vector<size_t> pattern_matches;   // Indexed like text_patterns
+        std::unordered_map<const format_extract::FormatExtractor*, size_t> format_matches;
+        std::vector<FileTime> slowest;         // Min-heap on seconds, at most StatsCollector::slowest
+        std::vector<SkippedFile> skipped;
+        size_t lines_truncated = 0;
+        std::vector<TraceEvent> events;
+    };
+    
+    // Stats of one extract_texts: a WorkerStats per pool thread plus one for
+    // the calling thread (see WorkStealingPool::worker_index)
+    struct StatsCollector {
+        std::chrono::steady_clock::time_point origin;
+        std::vector<WorkerStats> workers;
+        size_t slowest = 0;
+        bool trace = false;
+        
+        StatsCollector(size_t threads, size_t patterns, size_t slowest, bool trace)
+            : origin(std::chrono::steady_clock::now()), workers(threads + 1), slowest(slowest), trace(trace) {
+            for (auto& worker : workers) {
+                worker.pattern_matches.assign(patterns, 0);
+            }
+        }
+        
+        WorkerStats& local(const WorkStealingPool& pool) {
+            return workers[pool.worker_index()];
+        }
+        
+        double since_origin(std::chrono::steady_clock::time_point time) const {
+            return std::chrono::duration<double>(time - origin).count();
+        }
+        
+        // Keep the file if it is among the `slowest` slowest seen by this worker
+        void add_file(WorkerStats& worker, const std::string& path, double seconds, size_t bytes, size_t chunks) {
+            auto faster = [](const FileTime& a, const FileTime& b) { return a.seconds > b.seconds; };
+            if (slowest == 0 || (worker.slowest.size() == slowest && seconds <= worker.slowest.front().seconds)) {
+                return;
+            }
+            worker.slowest.push_back({path, seconds, bytes, chunks});
+            std::push_heap(worker.slowest.begin(), worker.slowest.end(), faster);
+            if (worker.slowest.size() > slowest) {
+                std::pop_heap(worker.slowest.begin(), worker.slowest.end(), faster);
+                worker.slowest.pop_back();
+            }
+        }
+    };
+    
+    // Display name of every entry of text_patterns, in the same order
+    std::vector<std::string> pattern_names() const {
+        std::vector<std::string> names = {"\"...\"", "'...'"};
+        for (const auto& key : text_keys) {
+            names.push_back(key + ": \"...\"");
+        }
+        for (const auto& tag : text_tags) {
+            names.push_back("<" + tag + ">...</" + tag + ">");
+        }
+        return names;
+    }
+    
+    // Sum the worker counters into `stats`; `extract_seconds` is the wall
+    // time the workers are measured against
+    void merge_stats(const StatsCollector& collector, double extract_seconds, ExtractionStats& stats) const {
+        std::vector<std::string> names = pattern_names();
+        std::vector<size_t> pattern_totals(names.size(), 0);
+        std::unordered_map<const format_extract::FormatExtractor*, size_t> format_totals;
+        for (size_t w = 0; w < collector.workers.size(); w++) {
+            const WorkerStats& worker = collector.workers[w];
+            stats.walk_seconds += worker.walk_seconds;
+            stats.read_seconds += worker.read_seconds;
+            stats.decode_seconds += worker.decode_seconds;
+            stats.scan_seconds += worker.scan_seconds;
+            stats.bytes_read += worker.bytes_read;
+            stats.files_read += worker.files_read;
+            for (size_t p = 0; p < pattern_totals.size() && p < worker.pattern_matches.size(); p++) {
+                pattern_totals[p] += worker.pattern_matches[p];
+            }
+            for (const auto& [format, count] : worker.format_matches) {
+                format_totals[format] += count;
+            }
+            stats.slowest_files.insert(stats.slowest_files.end(), worker.slowest.begin(), worker.slowest.end());
+            stats.skipped_files.insert(stats.skipped_files.end(), worker.skipped.begin(), worker.skipped.end());
+            stats.lines_truncated += worker.lines_truncated;
+            // The last entry is the calling thread, which runs no tasks
+            if (w + 1 < collector.workers.size()) {
+                ThreadTime thread;
+                thread.busy_seconds = worker.busy_seconds;
+                thread.files = worker.files;
+                thread.utilisation = extract_seconds > 0 ? worker.busy_seconds / extract_seconds : 0;
+                stats.threads.push_back(thread);
+            }
+        }
+        for (size_t p = 0; p < names.size(); p++) {
+            stats.pattern_matches[names[p]] = pattern_totals[p];
+        }
+        for (const auto& [format, count] : format_totals) {
+            stats.format_matches[format->name()] += count;
+        }
+        std::sort(stats.slowest_files.begin(), stats.slowest_files.end(), [](const FileTime& a, const FileTime& b) {
+            return a.seconds > b.seconds || (a.seconds == b.seconds && path_order_less(a.file_path, b.file_path));
+        });
+        if (stats.slowest_files.size() > collector.slowest) {
+            stats.slowest_files.resize(collector.slowest);
+        }
+        std::sort(stats.skipped_files.begin(), stats.skipped_files.end(), [](const SkippedFile& a, const SkippedFile& b) {
+            return path_order_less(a.file_path, b.file_path);
+        });
+    }
+    
+    static void append_json_string(std::string& out, std::string_view text) {
+        static const char hex[] = "0123456789abcdef";
+        out += '"';
+        for (char ch : text) {
+            unsigned char byte = static_cast<unsigned char>(ch);
+            if (ch == '"' || ch == '\\') {
+                out += '\\';
+                out += ch;
+            } else if (byte < 0x20) {
+                out += "\\u00";
+                out += hex[byte >> 4];
+                out += hex[byte & 0xF];
+            } else {
+                out += ch;
+            }
+        }
+        out += '"';
+    }
+    
+    // Chrome trace event format: complete ("X") events in microseconds, one
+    // track per worker and one ("main") for the stages
+    void write_trace(const std::string& path, const StatsCollector& collector) const {
+        BufferedFileWriter out(path, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            std::cerr << "Error writing trace file: cannot open " << path << std::endl;
+            return;
+        }
+        std::string& data = out.data();
+        data += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        const size_t main_thread = collector.workers.size() - 1;
+        for (size_t w = 0; w < collector.workers.size(); w++) {
+            data += w == 0 ? "" : ",\n";
+            data += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":";
+            append_number(data, w);
+            data += ",\"args\":{\"name\":\"";
+            if (w == main_thread) {
+                data += "main";
+            } else {
+                data += "worker ";
+                append_number(data, w);
+            }
+            data += "\"}}";
+        }
+        for (size_t w = 0; w < collector.workers.size(); w++) {
+            for (const auto& event : collector.workers[w].events) {
+                data += ",\n{\"name\":";
+                append_json_string(data, event.name);
+                data += ",\"cat\":\"";
+                data += event.category;
+                data += "\",\"ph\":\"X\",\"ts\":";
+                append_number(data, static_cast<size_t>(event.start * 1e6));
+                data += ",\"dur\":";
+                append_number(data, static_cast<size_t>(event.duration * 1e6));
+                data += ",\"pid\":1,\"tid\":";
+                append_number(data, w);
+                data += '}';
+                out.maybe_flush();
+            }
+        }
+        data += "\n]}\n";
+        if (!out.close()) {
+            std::cerr << "Error writing trace file: " << path << std::endl;
+        }
+    }
+    
+    bool is_excluded_directory(std::string_view name, std::string_view relative_path) const {
+        for (const auto& pattern : excluded_directories) {
+            bool path_pattern = pattern.find('/') != std::string::npos;
+            if (glob_match(pattern, path_pattern ? relative_path : name)) {
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    // Keys and tags become part of regexes and XML tag names, so they are
+    // limited to letters, digits, '_', '-' and '.'
+    static std::vector<std::string> validate_keywords(const std::vector<std::string>& words, const char* kind) {
+        std::vector<std::string> unique;
+        for (const auto& word : words) {
+            if (word.empty() || !std::all_of(word.begin(), word.end(), [](unsigned char ch) {
+                    return std::isalnum(ch) || ch == '_' || ch == '-' || ch == '.';
+                })) {
+                throw std::invalid_argument(std::string("Invalid text ") + kind + ": '" + word + "'");
+            }
+            if (std::find(unique.begin(), unique.end(), word) == unique.end()) {
+                unique.push_back(word);
+            }
+        }
+        return unique;
+    }
+    
+    static std::string escape_regex(const std::string& word) {
+        std::string escaped;
+        for (char ch : word) {
+            if (ch == '.') {
+                escaped += '\\';
+            }
+            escaped += ch;
+        }
+        return escaped;
+    }
+    
+    // The regexes of the text patterns, compiled by the first caller
+    const std::vector<std::regex>& text_patterns() const {
+        RegexPatterns& set = *regex_patterns;
+        std::call_once(set.compiled, [this, &set] { set.patterns = build_text_patterns(text_keys, text_tags); });
+        return set.patterns;
+    }
+    
+    size_t text_pattern_count() const {
+        return LiteralScanner::first_key_pattern + text_keys.size() + text_tags.size();
+    }
+    
+    static std::vector<std::regex> build_text_patterns(const std::vector<std::string>& keys,
+                                                       const std::vector<std::string>& tags) {
+        std::vector<std::regex> patterns = {
+            std::regex(R"re("([^"\\]*(\\.[^"\\]*)*)")re"),  // Double quoted strings
+            std::regex(R"('([^'\\]*(\\.[^'\\]*)*)')"),  // Single quoted strings
+        };
+        for (const auto& key : keys) {
+            patterns.emplace_back(escape_regex(key) + R"(\s*[:=]\s*["']([^"']+)["'])");   // key: "value"
+        }
+        for (const auto& tag : tags) {
+            std::string name = escape_regex(tag);
+            patterns.emplace_back("<" + name + ">([^<]+)</" + name + ">");   // <tag>value</tag>
+        }
+        return patterns;
+    }
+    
+    static std::string lowercase(std::string text) {
+        std::transform(text.begin(), text.end(), text.begin(), [](unsigned char ch) {
+            return static_cast<char>(std::tolower(ch));
+        });
+        return text;
+    }
+    
+    // Format extractor for a file, by the extension of its name as
+    // fs::path::extension() defines it; nullptr for text_patterns
+    const format_extract::FormatExtractor* format_for(std::string_view file_path) const {
+        if (format_extractors.empty()) {
+            return nullptr;
+        }
+        size_t name_start = file_path.find_last_of("/\\");
+        name_start = name_start == std::string_view::npos ? 0 : name_start + 1;
+        size_t dot = file_path.rfind('.');
+        if (dot == std::string_view::npos || dot <= name_start) {
+            return nullptr;
+        }
+        auto it = format_extractors.find(lowercase(std::string(file_path.substr(dot))));
+        return it == format_extractors.end() ? nullptr : it->second;
+    }
+    
+    bool in_shard(const std::string& relative_path, std::string_view name) const {
+        if (shard_count == 1) {
+            return true;
+        }
+        std::string file = relative_path.empty() ? std::string(name) : relative_path + "/" + std::string(name);
+        return shard_of(file, shard_count) == shard_index;
+    }
+    
+    // walk_directory, timing each directory into `stats` when it is set
+    void walk_directory(const std::string& directory_path, WorkStealingPool& pool,
+                        std::function<void(std::string)> on_file, StatsCollector* stats) {
+        std::error_code ec;
+        if (!fs::is_directory(directory_path, ec)) {
+            std::cerr << "Error scanning directory: " << directory_path << " is not a directory" << std::endl;
+            return;
+        }
+        auto callback = std::make_shared<std::function<void(std::string)>>(std::move(on_file));
+        pool.submit([this, &pool, directory_path, callback, stats] {
+            walk_task_timed(pool, directory_path, std::string(), callback, stats);
+        });
+    }
+    
+    // walk_task, timed into the stats of the worker running it
+    void walk_task_timed(WorkStealingPool& pool, const std::string& directory, const std::string& relative_path,
+                         const std::shared_ptr<std::function<void(std::string)>>& on_file, StatsCollector* stats) {
+        if (!stats) {
+            walk_task(pool, directory, relative_path, on_file, stats);
+            return;
+        }
+        auto start = std::chrono::steady_clock::now();
+        walk_task(pool, directory, relative_path, on_file, stats);
+        auto end = std::chrono::steady_clock::now();
+        WorkerStats& worker = stats->local(pool);
+        double seconds = std::chrono::duration<double>(end - start).count();
+        worker.walk_seconds += seconds;
+        worker.busy_seconds += seconds;
+        if (stats->trace) {
+            worker.events.push_back({directory, "walk", stats->since_origin(start), seconds});
+        }
+    }
+    
+    // List one directory: report matching files, queue subdirectories as new tasks.
+    // `relative_path` uses '/' separators and is empty for the root.
+    void walk_task(WorkStealingPool& pool, const std::string& directory, const std::string& relative_path,
+                   const std::shared_ptr<std::function<void(std::string)>>& on_file, StatsCollector* stats) {
+        if (cancelled()) {
+            return;
+        }
+        auto visit_directory = [&](std::string_view name) {
+            std::string child_relative = relative_path.empty() ? std::string(name)
+                                                               : relative_path + "/" + std::string(name);
+            if (is_excluded_directory(name, child_relative)) {
+                return;
+            }
+            std::string child = join_path(directory, name);
+            pool.submit([this, &pool, child, child_relative, on_file, stats] {
+                walk_task_timed(pool, child, child_relative, on_file, stats);
+            });
+        };
+        
+#ifdef _WIN32
+        std::wstring pattern = fs::path(directory).wstring();
+        if (!pattern.empty() && pattern.back() != L'\\' && pattern.back() != L'/') {
+            pattern += L'\\';
+        }
+        pattern += L'*';
+        
+        // FindExInfoBasic skips the short name; large fetch batches the directory reads
+        WIN32_FIND_DATAW data;
+        HANDLE find = FindFirstFileExW(pattern.c_str(), FindExInfoBasic, &data, FindExSearchNameMatch,
+                                       nullptr, FIND_FIRST_EX_LARGE_FETCH);
+        if (find == INVALID_HANDLE_VALUE) {
+            std::cerr << "Error scanning directory: cannot open " << directory << std::endl;
+            return;
+        }
+        do {
+            std::wstring_view wide_name(data.cFileName);
+            if (wide_name == L"." || wide_name == L"..") {
+                continue;
+            }
+            std::string name = fs::path(data.cFileName).string();
+            if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+                if (!(data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)) {
+                    visit_directory(name);
+                }
+            } else if (extension_set.matches_file_name(name) && in_shard(relative_path, name) &&
+                       (!(data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) ||
+                        fs::is_regular_file(join_path(directory, name)))) {
+                (*on_file)(join_path(directory, name));
+            }
+        } while (FindNextFileW(find, &data));
+        FindClose(find);
+#else
+        DIR* dir = opendir(directory.c_str());
+        if (!dir) {
+            std::cerr << "Error scanning directory: cannot open " << directory << std::endl;
+            return;
+        }
+        while (dirent* entry = readdir(dir)) {
+            std::string_view name(entry->d_name);
+            if (name == "." || name == "..") {
+                continue;
+            }
+            
+            // d_type saves a stat per entry; only symlinks and filesystems
+            // that don't fill it in need one
+            bool is_directory = false;
+            bool is_file = false;
+#ifdef DT_DIR
+            if (entry->d_type == DT_DIR) {
+                is_directory = true;
+            } else if (entry->d_type == DT_REG) {
+                is_file = extension_set.matches_file_name(name);
+            } else if (entry->d_type == DT_LNK || entry->d_type == DT_UNKNOWN) {
+                bool unknown = entry->d_type == DT_UNKNOWN;
+#else
+            {
+                bool unknown = true;
+#endif
+                if (unknown || extension_set.matches_file_name(name)) {
+                    struct stat st;
+                    if (fstatat(dirfd(dir), entry->d_name, &st, unknown ? AT_SYMLINK_NOFOLLOW : 0) == 0) {
+                        is_directory = unknown && S_ISDIR(st.st_mode);
+                        is_file = S_ISREG(st.st_mode) && extension_set.matches_file_name(name);
+                        // A symlink reported as DT_UNKNOWN still counts if it points to a file
+                        if (unknown && S_ISLNK(st.st_mode) && extension_set.matches_file_name(name) &&
+                            fstatat(dirfd(dir), entry->d_name, &st, 0) == 0) {
+                            is_file = S_ISREG(st.st_mode);
+                        }
+                    }
+                }
+            }
+            
+            if (is_directory) {
+                visit_directory(name);
+            } else if (is_file && in_shard(relative_path, name)) {
+                (*on_file)(join_path(directory, name));
+            }
+        }
+        closedir(dir);
+#endif
+    }
+    
+    static constexpr std::string_view cache_magic = "GTXCACHE";
+    static constexpr uint64_t cache_version = 1;
+    
+    // Settings that change what extract_from_buffer produces; a cache written
+    // with different settings is discarded
+    uint64_t cache_fingerprint() const {
+        std::string settings = "engine=" + get_scan_engine() + ";min=" + std::to_string(min_text_length) +
+                               ";encoding=" + get_input_encoding() + ";keys=";
+        for (const auto& key : text_keys) {
+            settings += key + ",";
+        }
+        settings += ";tags=";
+        for (const auto& tag : text_tags) {
+            settings += tag + ",";
+        }
+        settings += ";formats=";
+        for (const auto& [extension, format] : get_format_extractors()) {
+            settings += extension + "=" + format + ",";
+        }
+        settings += ";binary=" + std::to_string(skip_binary_files) + ";max_size=" + std::to_string(max_file_size) +
+                    ";max_line=" + std::to_string(max_line_length) + ";";
+        return fnv1a_64(settings);
+    }
+    
+    // Fill `entry` for one file, reusing cached chunks when the file is
+    // unchanged. Returns true if the cached chunks were reused.
+    bool extract_with_cache(const std::string& file_path, std::unordered_map<std::string, CacheEntry>& cached,
+                            CacheEntry& entry, FileStats& stats) {
+        std::error_code size_error;
+        std::error_code time_error;
+        entry.size = fs::file_size(file_path, size_error);
+        entry.mtime = static_cast<int64_t>(fs::last_write_time(file_path, time_error).time_since_epoch().count());
+        
+        auto it = cached.find(file_path);
+        bool same_size = it != cached.end() && !size_error && it->second.size == entry.size;
+        if (same_size && !time_error && it->second.mtime == entry.mtime) {
+            entry.hash = it->second.hash;
+            entry.chunks = std::move(it->second.chunks);
+            return true;
+        }
+        
+        if (max_file_size > 0 && !size_error && entry.size > max_file_size) {
+            stats.bytes = static_cast<size_t>(entry.size);
+            stats.skipped = "size";
+            return false;
+        }
+        auto start = std::chrono::steady_clock::now();
+        FileBuffer file;
+        if (!file.open(file_path, mmap_threshold)) {
+            entry.readable = false;
+            return false;
+        }
+        stats.read = true;
+        stats.bytes = file.view().size();
+        if (cache_content_hash) {
+            entry.hash = fnv1a_64(file.view());
+            if (same_size && it->second.hash != 0 && it->second.hash == entry.hash) {
+                entry.chunks = std::move(it->second.chunks);
+                return true;
+            }
+        }
+        stats.read_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        entry.chunks = extract_from_buffer(file_path, file.view(), &stats);
+        return false;
+    }
+    
+    std::unordered_map<std::string, CacheEntry> load_cache(const std::string& path) const {
+        std::unordered_map<std::string, CacheEntry> entries;
+        if (!fs::exists(path)) {
+            return entries;
+        }
+        
+        try {
+            FileBuffer file;
+            if (!file.open(path, mmap_threshold)) {
+                return entries;
+            }
+            BinaryReader reader(file.view());
+            if (reader.raw(cache_magic.size()) != cache_magic || reader.u64() != cache_version ||
+                reader.u64() != cache_fingerprint()) {
+                return entries;
+            }
+            
+            uint64_t file_count = reader.u64();
+            for (uint64_t f = 0; f < file_count; f++) {
+                std::string file_path(reader.str());
+                CacheEntry entry;
+                entry.size = reader.u64();
+                entry.mtime = static_cast<int64_t>(reader.u64());
+                entry.hash = reader.u64();
+                
+                auto source = std::make_shared<SourceText>();
+                source->lines = std::string(reader.str());
+                uint64_t chunk_count = reader.u64();
+                entry.chunks.reserve(static_cast<size_t>(chunk_count));
+                for (uint64_t c = 0; c < chunk_count; c++) {
+                    TextChunk chunk;
+                    chunk.text = std::string(reader.str());
+                    chunk.file_path = file_path;
+                    chunk.line_number = static_cast<size_t>(reader.u64());
+                    chunk.column_start = static_cast<size_t>(reader.u64());
+                    chunk.column_end = static_cast<size_t>(reader.u64());
+                    chunk.source = source;
+                    chunk.context_offset = static_cast<size_t>(reader.u64());
+                    chunk.context_length = static_cast<size_t>(reader.u64());
+                    chunk.original_offset = static_cast<size_t>(reader.u64());
+                    chunk.original_length = static_cast<size_t>(reader.u64());
+                    if (chunk.context_offset + chunk.context_length > source->lines.size() ||
+                        chunk.original_offset + chunk.original_length > source->lines.size()) {
+                        throw std::runtime_error("chunk span out of range");
+                    }
+                    entry.chunks.push_back(std::move(chunk));
+                }
+                entries[file_path] = std::move(entry);
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Ignoring unreadable cache " << path << ": " << e.what() << std::endl;
+            entries.clear();
+        }
+        
+        return entries;
+    }
+    
+    void save_cache(const std::string& path, const std::vector<std::string>& files,
+                    const std::vector<CacheEntry>& entries) const {
+        try {
+            std::string data;
+            BinaryWriter writer(data);
+            writer.raw(cache_magic);
+            writer.u64(cache_version);
+            writer.u64(cache_fingerprint());
+            
+            // Unreadable files are left out so they are retried next time
+            writer.u64(std::count_if(entries.begin(), entries.end(), [](const CacheEntry& entry) {
+                return entry.readable;
+            }));
+            
+            for (size_t i = 0; i < files.size(); i++) {
+                const CacheEntry& entry = entries[i];
+                if (!entry.readable) {
+                    continue;
+                }
+                writer.str(files[i]);
+                writer.u64(entry.size);
+                writer.u64(static_cast<uint64_t>(entry.mtime));
+                writer.u64(entry.hash);
+                
+                // All chunks of a file share one SourceText
+                writer.str(entry.chunks.empty() ? std::string_view() : std::string_view(entry.chunks.front().source->lines));
+                writer.u64(entry.chunks.size());
+                for (const auto& chunk : entry.chunks) {
+                    writer.str(chunk.text);
+                    writer.u64(chunk.line_number);
+                    writer.u64(chunk.column_start);
+                    writer.u64(chunk.column_end);
+                    writer.u64(chunk.context_offset);
+                    writer.u64(chunk.context_length);
+                    writer.u64(chunk.original_offset);
+                    writer.u64(chunk.original_length);
+                }
+            }
+            
+            // Write next to the target and rename, so an interrupted run never leaves a torn cache
+            std::string temp_path = path + ".tmp";
+            {
+                std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+                if (!out.is_open()) {
+                    std::cerr << "Could not write cache file: " << temp_path << std::endl;
+                    return;
+                }
+                out.write(data.data(), static_cast<std::streamsize>(data.size()));
+            }
+            fs::rename(temp_path, path);
+        } catch (const std::exception& e) {
+            std::cerr << "Error saving cache " << path << ": " << e.what() << std::endl;
+        }
+    }
+    
+    size_t resolve_thread_count() const {
+        if (num_threads > 0) {
+            return num_threads;
+        }
+        return std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    }
+    
+    // Per-file state while extracting
+    // Buffers one thread reuses for every file it scans, so once it has
+    // warmed up, scanning a file allocates nothing but the chunks themselves.
+    // Reset after each file; buffers grown by an unusually large file are
+    // released rather than kept for the rest of the thread's life.
+    struct ScanScratch {
+        LiteralScanner::State scanner;
+        std::vector<format_extract::Span> spans;
+        std::string clean_buffer;
+        text_encoding::DecodedText decoded;
+        
+        static ScanScratch& local() {
+            thread_local ScanScratch scratch;
+            return scratch;
+        }
+        
+        // Resets the scratch when a file is done
+        struct Reset {
+            ScanScratch& scratch;
+            ~Reset() {
+                scratch.reset();
+            }
+        };
+        
+        void reset() {
+            static constexpr size_t keep_bytes = 4 * 1024 * 1024;
+            release_if_large(scanner.matches, keep_bytes);
+            release_if_large(spans, keep_bytes);
+            release_if_large(clean_buffer, keep_bytes);
+            release_if_large(decoded.utf8, keep_bytes);
+            decoded.map = text_encoding::OffsetMap();
+        }
+        
+        template <typename Buffer>
+        static void release_if_large(Buffer& buffer, size_t keep_bytes) {
+            if (buffer.capacity() * sizeof(buffer[0]) > keep_bytes) {
+                Buffer().swap(buffer);
+            } else {
+                buffer.clear();
+            }
+        }
+    };
+    
+    struct FileScan {
+        const std::string& file_path;
+        std::shared_ptr<SourceText> source;
+        std::vector<TextChunk>& chunks;
+        ScanScratch& scratch;
+        const text_encoding::OffsetMap* map = nullptr;   // Set for converted files
+        const format_extract::FormatExtractor* format = nullptr;   // Null for text_patterns
+        size_t* pattern_matches = nullptr;   // Kept texts per pattern, when stats are collected
+    };
+    
+    // Line being scanned; `offset` is its position in the file's SourceText
+    // once a chunk has referenced it
+    struct SourceLine {
+        std::string_view text;
+        size_t number = 0;
+        size_t offset = std::string::npos;
+        size_t start = 0;   // Position of the line in the scanned text
+    };
+    
+    // Reference implementation: one std::sregex_iterator pass per pattern
+    void extract_with_regex(FileScan& scan, SourceLine& line) {
+        const std::vector<std::regex>& patterns = text_patterns();
+        for (size_t p = 0; p < patterns.size(); p++) {
+            std::cregex_iterator iter(line.text.data(), line.text.data() + line.text.size(), patterns[p]);
+            std::cregex_iterator end;
+            
+            for (; iter != end; ++iter) {
+                const std::cmatch& match = *iter;
+                add_chunk(scan, line, match.position(1), match.length(1),
+                          match.position(0), match.length(0), p);
+            }
+        }
+    }
+    
+    // Report the spans a format extractor finds, line by line like the pattern
+    // scan. Spans that cross a line break cannot be written back and are dropped.
+    void extract_with_format(FileScan& scan, std::string_view data) {
+        std::vector<format_extract::Span>& spans = scan.scratch.spans;
+        spans.clear();
+        scan.format->extract(data, spans);
+        std::stable_sort(spans.begin(), spans.end(), [](const format_extract::Span& a, const format_extract::Span& b) {
+            return a.group_start < b.group_start;
+        });
+        
+        SourceLine line;
+        size_t next_line = 0;   // Start of the line after `line`
+        for (const auto& span : spans) {
+            while (span.group_start >= next_line) {
+                size_t newline = data.find('\n', next_line);
+                size_t line_end = newline == std::string_view::npos ? data.size() : newline;
+                line.text = data.substr(next_line, line_end - next_line);
+                line.number++;
+                line.offset = std::string::npos;
+                line.start = next_line;
+                next_line = line_end + 1;
+#ifdef _WIN32
+                if (!line.text.empty() && line.text.back() == '\r') {
+                    line.text.remove_suffix(1);
+                }
+#endif
+            }
+            
+            size_t line_end = line.start + line.text.size();
+            if (span.group_end > line_end || span.group_end < span.group_start) {
+                continue;
+            }
+            size_t match_start = std::min(std::max(span.match_start, line.start), span.group_start);
+            size_t match_end = std::max(std::min(span.match_end, line_end), span.group_end);
+            add_chunk(scan, line, span.group_start - line.start, span.group_end - span.group_start,
+                      match_start - line.start, match_end - match_start);
+        }
+    }
+    
+    // `pattern` is the text_patterns index of the match, counted in the stats
+    void add_chunk(FileScan& scan, SourceLine& line, size_t group_start, size_t group_length,
+                   size_t match_start, size_t match_length, size_t pattern = 0) {
+        // Cleaning never makes a text longer, so short matches are rejected
+        // before anything is copied out of the file buffer
+        if (group_length < min_text_length) {
+            return;
+        }
+        
+        // Clean up the text
+        if (scan.format) {
+            scan.format->decode(line.text, group_start, group_start + group_length, scan.scratch.clean_buffer);
+            if (!format_extract::looks_like_text(scan.scratch.clean_buffer)) {
+                return;
+            }
+        } else {
+            text_unescape::unescape(line.text.substr(group_start, group_length), scan.scratch.clean_buffer);
+        }
+        
+        if (scan.scratch.clean_buffer.length() >= min_text_length) {
+            // Intern the line the first time one of its matches is kept
+            if (line.offset == std::string::npos) {
+                line.offset = scan.source->lines.size();
+                scan.source->lines.append(line.text);
+            }
+            
+            TextChunk& chunk = scan.chunks.emplace_back();
+            chunk.text = scan.scratch.clean_buffer;
+            chunk.file_path = scan.file_path;
+            chunk.line_number = line.number;
+            chunk.column_start = group_start;
+            chunk.column_end = group_start + group_length;
+            if (scan.map) {
+                // Columns count bytes of the original file, not of the UTF-8 text
+                size_t source_line_start = scan.map->to_source(line.start);
+                chunk.column_start = scan.map->to_source(line.start + group_start) - source_line_start;
+                chunk.column_end = scan.map->to_source(line.start + group_start + group_length) - source_line_start;
+            }
+            chunk.source = scan.source;
+            chunk.context_offset = line.offset;
+            chunk.context_length = line.text.size();
+            chunk.original_offset = line.offset + match_start;
+            chunk.original_length = match_length;
+            if (scan.pattern_matches && !scan.format) {
+                scan.pattern_matches[pattern]++;
+            }
+        }
+    }
+};
+
+// Incremental extraction: a background thread walks the directory and
+// extracts files in order, while the consumer pulls batches of chunks as
+// soon as they are ready. The queue between them holds only a few batches.
+class ExtractionStream {
+public:
+    // batch_size == 0 yields one batch per file that has chunks
+    ExtractionStream(TextExtractor& extractor, const std::string& directory_path, size_t batch_size)
+        : batches(queue_depth), batch_size(batch_size) {
+        producer = std::thread([this, &extractor, directory_path] { run(extractor, directory_path); });
+    }
+
+    ~ExtractionStream() {
+        close();
+    }
+
+    ExtractionStream(const ExtractionStream&) = delete;
+    ExtractionStream& operator=(const ExtractionStream&) = delete;
+
+    // Blocks until the next batch is ready; false once extraction is finished.
+    // If extraction failed, the error is rethrown once the batches before it
+    // have been taken.
+    bool next_batch(std::vector<TextExtractor::TextChunk>& batch) {
+        if (batches.pop(batch)) {
+            return true;
+        }
+        if (error) {
+            std::rethrow_exception(std::exchange(error, nullptr));
+        }
+        return false;
+    }
+
+    // Stop extracting and discard pending batches
+    void close() {
+        stopping = true;
+        batches.close();
+        if (producer.joinable()) {
+            producer.join();
+        }
+    }
+
+    size_t get_total_files() const {
+        return total_files.load();
+    }
+
+    size_t get_files_processed() const {
+        return files_processed.load();
+    }
+
+    size_t get_texts_found() const {
+        return texts_found.load();
+    }
+
+private:
+    static constexpr size_t queue_depth = 4;
+
+    BoundedQueue<std::vector<TextExtractor::TextChunk>> batches;
+    size_t batch_size;
+    std::thread producer;
+    std::atomic<bool> stopping{false};
+    std::atomic<size_t> total_files{0};
+    std::atomic<size_t> files_processed{0};
+    std::atomic<size_t> texts_found{0};
+    // Set by the producer before it closes the queue
+    std::exception_ptr error;
+
+    void run(TextExtractor& extractor, const std::string& directory_path) {
+        try {
+            std::vector<std::string> files = extractor.scan_directory(directory_path);
+            total_files = files.size();
+            
+            std::vector<TextExtractor::TextChunk> batch;
+            extractor.extract_files_ordered(files, [&](size_t, std::vector<TextExtractor::TextChunk>& chunks) {
+                files_processed++;
+                std::vector<TextExtractor::TextChunk> split = extractor.split_into_chunks(std::move(chunks));
+                texts_found += split.size();
+                
+                for (auto& chunk : split) {
+                    batch.push_back(std::move(chunk));
+                    if (batch_size > 0 && batch.size() >= batch_size && !flush(batch)) {
+                        return false;
+                    }
+                }
+                if (batch_size == 0 && !batch.empty() && !flush(batch)) {
+                    return false;
+                }
+                return !stopping.load();
+            });
+            if (!batch.empty()) {
+                flush(batch);
+            }
+        } catch (...) {
+            error = std::current_exception();
+        }
+        batches.close();
+    }
+
+    bool flush(std::vector<TextExtractor::TextChunk>& batch) {
+        bool pushed = batches.push(std::move(batch));
+        batch = std::vector<TextExtractor::TextChunk>();
+        return pushed;
+    }
+};
+
+// Binary snapshot of an extraction: a file table, fixed-size chunk records
+// and one string table they point into. Opening maps the file and checks the
+// header only, so it takes the same time for any number of chunks; records
+// are decoded (and bounds-checked) when they are accessed.
+//
+// Layout, all integers little-endian:
+//   header   "GTXINDEX", u32 version, u32 header size, u64 file count,
+//            u64 chunk count, u64 offsets of the file table, chunk table and
+//            string table, u64 string table size, u64 offset + length of the
+//            source root in the string table
+//   file     u64 path offset, u64 path length
+//   chunk    u64 text offset, u64 context offset, u32 text length,
+//            u32 context length, u32 file index, u32 line, u32 column start,
+//            u32 column end, u32 original start (within context), u32 original length,
+//            u32 part index, u32 part count
+// String offsets are relative to the string table. Chunks on the same line
+// share their context bytes, and repeated texts are stored once.
+class ExtractionIndex {
+public:
+    static constexpr std::string_view magic = "GTXINDEX";
+    static constexpr uint32_t version = 2;
+    static constexpr size_t header_size = 80;
+    static constexpr size_t file_record_size = 16;
+    static constexpr size_t chunk_record_size = 56;
+
+    explicit ExtractionIndex(const std::string& path) {
+        // Threshold 0: always map, never copy
+        if (!buffer.open(path, 0)) {
+            throw std::runtime_error("Could not open index file: " + path);
+        }
+        data = buffer.view();
+        BinaryReader reader(data);
+        if (data.size() < header_size || reader.raw(magic.size()) != magic) {
+            throw std::runtime_error("Not an extraction index: " + path);
+        }
+        if (reader.u32() != version || reader.u32() != header_size) {
+            throw std::runtime_error("Unsupported extraction index version: " + path);
+        }
+        file_count = reader.u64();
+        chunk_count = reader.u64();
+        files_offset = reader.u64();
+        chunks_offset = reader.u64();
+        strings_offset = reader.u64();
+        strings_size = reader.u64();
+        uint64_t root_offset = reader.u64();
+        uint64_t root_length = reader.u64();
+        
+        if (!in_file(files_offset, file_count, file_record_size) ||
+            !in_file(chunks_offset, chunk_count, chunk_record_size) ||
+            !in_file(strings_offset, strings_size, 1)) {
+            throw std::runtime_error("Truncated extraction index: " + path);
+        }
+        source_root_view = string_at(root_offset, root_length);
+    }
+
+    ExtractionIndex(const ExtractionIndex&) = delete;
+    ExtractionIndex& operator=(const ExtractionIndex&) = delete;
+
+    size_t get_file_count() const {
+        return static_cast<size_t>(file_count);
+    }
+
+    size_t get_chunk_count() const {
+        return static_cast<size_t>(chunk_count);
+    }
+
+    std::string_view source_root() const {
+        return source_root_view;
+    }
+
+    std::string_view file_path(size_t index) const {
+        check_index(index, file_count);
+        BinaryReader reader(data.substr(files_offset + index * file_record_size, file_record_size));
+        uint64_t offset = reader.u64();
+        uint64_t length = reader.u64();
+        return string_at(offset, length);
+    }
+
+    // Fields of one chunk record; the views point into the mapped file
+    struct Record {
+        std::string_view text;
+        std::string_view context;
+        size_t file_index;
+        size_t line_number;
+        size_t column_start;
+        size_t column_end;
+        size_t original_start;
+        size_t original_length;
+        size_t part_index;
+        size_t part_count;
+    };
+
+    Record record(size_t index) const {
+        check_index(index, chunk_count);
+        BinaryReader reader(data.substr(chunks_offset + index * chunk_record_size, chunk_record_size));
+        uint64_t text_offset = reader.u64();
+        uint64_t context_offset = reader.u64();
+        uint32_t text_length = reader.u32();
+        uint32_t context_length = reader.u32();
+        
+        Record result;
+        result.text = string_at(text_offset, text_length);
+        result.context = string_at(context_offset, context_length);
+        result.file_index = reader.u32();
+        result.line_number = reader.u32();
+        result.column_start = reader.u32();
+        result.column_end = reader.u32();
+        result.original_start = reader.u32();
+        result.original_length = reader.u32();
+        result.part_index = reader.u32();
+        result.part_count = reader.u32();
+        if (result.file_index >= file_count || result.part_index >= result.part_count ||
+            result.original_start + result.original_length > result.context.size()) {
+            throw std::runtime_error("Corrupt extraction index record");
+        }
+        return result;
+    }
+
+    TextExtractor::TextChunk chunk(size_t index) const {
+        Record rec = record(index);
+        auto source = std::make_shared<TextExtractor::SourceText>();
+        source->lines = std::string(rec.context);
+        return to_chunk(rec, source, 0);
+    }
+
+    // All chunks; they share one copy of the string table
+    std::vector<TextExtractor::TextChunk> chunks() const {
+        auto source = std::make_shared<TextExtractor::SourceText>();
+        source->lines = std::string(data.substr(strings_offset, strings_size));
+        std::vector<TextExtractor::TextChunk> result;
+        result.reserve(static_cast<size_t>(chunk_count));
+        for (size_t i = 0; i < chunk_count; i++) {
+            Record rec = record(i);
+            size_t context_offset = rec.context.data() - (data.data() + strings_offset);
+            result.push_back(to_chunk(rec, source, context_offset));
+        }
+        return result;
+    }
+
+    // Write `chunks` to `path`. An empty source_root is stored as the
+    // deepest directory containing all chunk files; that depends on which
+    // files were found, so the indexes of shards must be given the scanned
+    // directory (see merge).
+    static bool write(const std::string& path, const std::vector<TextExtractor::TextChunk>& chunks,
+                      const std::string& source_root) {
+        try {
+            // String table layout: source root, file paths, then each chunk's
+            // context (once per line) and text
+            std::vector<std::string_view> files;
+            std::vector<uint32_t> file_of_chunk(chunks.size());
+            std::unordered_map<std::string_view, uint32_t> file_index;
+            for (size_t i = 0; i < chunks.size(); i++) {
+                auto inserted = file_index.try_emplace(chunks[i].file_path, static_cast<uint32_t>(files.size()));
+                if (inserted.second) {
+                    files.push_back(chunks[i].file_path);
+                }
+                file_of_chunk[i] = inserted.first->second;
+            }
+            std::string root = source_root;
+            if (root.empty() && !chunks.empty()) {
+                std::vector<std::string> paths(files.begin(), files.end());
+                root = common_root(paths).string();
+            }
+            
+            uint64_t strings_size = root.size();
+            for (auto file : files) {
+                strings_size += file.size();
+            }
+            // Repeated texts are stored once and share their offset
+            std::vector<uint64_t> context_offsets(chunks.size());
+            std::vector<uint64_t> text_offsets(chunks.size());
+            std::vector<char> new_text(chunks.size(), 0);
+            std::vector<uint64_t> unique_offsets;
+            StringInternTable texts(chunks.size() / 4);
+            for (size_t i = 0; i < chunks.size(); i++) {
+                if (i > 0 && same_context(chunks[i - 1], chunks[i])) {
+                    context_offsets[i] = context_offsets[i - 1];
+                } else {
+                    context_offsets[i] = strings_size;
+                    strings_size += chunks[i].context_length;
+                }
+                auto interned = texts.intern(chunks[i].text);
+                if (interned.second) {
+                    unique_offsets.push_back(strings_size);
+                    strings_size += chunks[i].text.size();
+                    new_text[i] = 1;
+                }
+                text_offsets[i] = unique_offsets[interned.first];
+            }
+            
+            const uint64_t files_offset = header_size;
+            const uint64_t chunks_offset = files_offset + files.size() * file_record_size;
+            const uint64_t strings_offset = chunks_offset + chunks.size() * chunk_record_size;
+            
+            std::string temp_path = path + ".tmp";
+            {
+                BufferedFileWriter out(temp_path, std::ios::out | std::ios::binary | std::ios::trunc);
+                if (!out.is_open()) {
+                    std::cerr << "Could not write index file: " << temp_path << std::endl;
+                    return false;
+                }
+                BinaryWriter writer(out.data());
+                writer.raw(magic);
+                writer.u32(version);
+                writer.u32(static_cast<uint32_t>(header_size));
+                writer.u64(files.size());
+                writer.u64(chunks.size());
+                writer.u64(files_offset);
+                writer.u64(chunks_offset);
+                writer.u64(strings_offset);
+                writer.u64(strings_size);
+                writer.u64(0);
+                writer.u64(root.size());
+                
+                uint64_t offset = root.size();
+                for (auto file : files) {
+                    writer.u64(offset);
+                    writer.u64(file.size());
+                    offset += file.size();
+                    out.maybe_flush();
+                }
+                for (size_t i = 0; i < chunks.size(); i++) {
+                    const auto& chunk = chunks[i];
+                    writer.u64(text_offsets[i]);
+                    writer.u64(context_offsets[i]);
+                    writer.u32(narrow(chunk.text.size()));
+                    writer.u32(narrow(chunk.context_length));
+                    writer.u32(file_of_chunk[i]);
+                    writer.u32(narrow(chunk.line_number));
+                    writer.u32(narrow(chunk.column_start));
+                    writer.u32(narrow(chunk.column_end));
+                    writer.u32(narrow(chunk.original_offset - chunk.context_offset));
+                    writer.u32(narrow(chunk.original_length));
+                    writer.u32(narrow(chunk.part_index));
+                    writer.u32(narrow(chunk.part_count));
+                    out.maybe_flush();
+                }
+                
+                writer.raw(root);
+                for (auto file : files) {
+                    writer.raw(file);
+                    out.maybe_flush();
+                }
+                for (size_t i = 0; i < chunks.size(); i++) {
+                    if (i == 0 || !same_context(chunks[i - 1], chunks[i])) {
+                        writer.raw(chunks[i].context());
+                    }
+                    if (new_text[i]) {
+                        writer.raw(chunks[i].text);
+                    }
+                    out.maybe_flush();
+                }
+                if (!out.close()) {
+                    std::cerr << "Error writing index file: " << temp_path << std::endl;
+                    return false;
+                }
+            }
+            fs::rename(temp_path, path);
+            return true;
+        } catch (const std::exception& e) {
+            std::cerr << "Error saving index: " << e.what() << std::endl;
+            return false;
+        }
+    }
+
+    struct MergeResult {
+        size_t files = 0;
+        size_t chunks = 0;
+        size_t duplicate_files = 0;   // Files in more than one input; the first input's chunks are kept
+    };
+
+    // Merge the indexes of the shards of one tree (see TextExtractor::set_shard)
+    // into `path`. Each input lists its files in walk order, so a k-way merge on
+    // the paths relative to each input's source root puts the files, and so the
+    // chunks and their master_translation.txt IDs, in the order one extraction of
+    // the whole tree gives them. All inputs with files must have the same source
+    // root, the scanned directory: a root write() derived from one shard's own
+    // files would make the relative paths of the shards disagree. Paths are
+    // rebased onto `source_root` (default: that common root). Chunks are copied
+    // from the mapped inputs without building TextChunk objects, and texts found
+    // in several inputs are stored once.
+    static MergeResult merge(const std::string& path, const std::vector<std::string>& inputs,
+                             const std::string& source_root = std::string()) {
+        if (inputs.empty()) {
+            throw std::invalid_argument("No indexes to merge");
+        }
+        std::vector<std::unique_ptr<ExtractionIndex>> indexes;
+        size_t first_with_files = SIZE_MAX;
+        for (size_t k = 0; k < inputs.size(); k++) {
+            indexes.push_back(std::make_unique<ExtractionIndex>(inputs[k]));
+            // An empty shard has nothing to rebase, whatever root it was saved with
+            if (indexes[k]->get_file_count() == 0) {
+                continue;
+            }
+            if (first_with_files == SIZE_MAX) {
+                first_with_files = k;
+            } else if (indexes[k]->source_root() != indexes[first_with_files]->source_root()) {
+                throw std::invalid_argument("Indexes to merge have different source roots: " +
+                                            inputs[first_with_files] + " has \"" +
+                                            std::string(indexes[first_with_files]->source_root()) + "\", " +
+                                            inputs[k] + " has \"" + std::string(indexes[k]->source_root()) +
+                                            "\"; save each shard with the scanned directory as source_root");
+            }
+        }
+        std::string root = source_root;
+        if (root.empty() && first_with_files != SIZE_MAX) {
+            root = std::string(indexes[first_with_files]->source_root());
+        }
+
+        // Each input as runs of consecutive chunks of one file
+        struct Run {
+            size_t input;
+            std::string relative;
+            size_t begin;
+            size_t end;
+        };
+        std::vector<std::vector<Run>> runs(indexes.size());
+        for (size_t k = 0; k < indexes.size(); k++) {
+            const ExtractionIndex& index = *indexes[k];
+            size_t file = SIZE_MAX;
+            for (size_t i = 0; i < index.get_chunk_count(); i++) {
+                size_t file_index = index.record(i).file_index;
+                if (file_index != file) {
+                    std::string relative = relative_path(index.file_path(file_index), index.source_root());
+                    if (relative.empty()) {
+                        throw std::runtime_error("File outside the source root of " + inputs[k] + ": " +
+                                                 std::string(index.file_path(file_index)));
+                    }
+                    runs[k].push_back(Run{k, std::move(relative), i, i});
+                    file = file_index;
+                }
+                runs[k].back().end = i + 1;
+            }
+            auto run_less = [](const Run& a, const Run& b) { return path_order_less(a.relative, b.relative); };
+            if (!std::is_sorted(runs[k].begin(), runs[k].end(), run_less)) {
+                std::stable_sort(runs[k].begin(), runs[k].end(), run_less);
+            }
+        }
+
+        // k-way merge; on equal paths the earlier input comes first and the others are dropped
+        MergeResult result;
+        std::vector<const Run*> merged;
+        auto later = [&](const std::pair<size_t, size_t>& a, const std::pair<size_t, size_t>& b) {
+            const Run& ra = runs[a.first][a.second];
+            const Run& rb = runs[b.first][b.second];
+            if (path_order_less(ra.relative, rb.relative)) {
+                return false;
+            }
+            return path_order_less(rb.relative, ra.relative) || a.first > b.first;
+        };
+        std::priority_queue<std::pair<size_t, size_t>, std::vector<std::pair<size_t, size_t>>, decltype(later)>
+            heads(later);
+        for (size_t k = 0; k < runs.size(); k++) {
+            if (!runs[k].empty()) {
+                heads.push({k, 0});
+            }
+        }
+        const Run* last = nullptr;
+        while (!heads.empty()) {
+            auto [k, r] = heads.top();
+            heads.pop();
+            const Run& run = runs[k][r];
+            if (last && last->input != run.input && last->relative == run.relative) {
+                result.duplicate_files++;
+            } else {
+                merged.push_back(&run);
+                last = &run;
+            }
+            if (r + 1 < runs[k].size()) {
+                heads.push({k, r + 1});
+            }
+        }
+
+        // Same layout as write(): root, file paths, then each chunk's context
+        // (once per line) and text (once per distinct text)
+        std::vector<std::string> files;
+        std::vector<uint32_t> file_of_run(merged.size());
+        for (size_t r = 0; r < merged.size(); r++) {
+            if (r == 0 || merged[r]->relative != merged[r - 1]->relative) {
+                std::string relative = merged[r]->relative;
+#ifdef _WIN32
+                std::replace(relative.begin(), relative.end(), '/', '\\');
+#endif
+                files.push_back(TextExtractor::join_path(root, relative));
+            }
+            file_of_run[r] = narrow(files.size() - 1);
+        }
+        uint64_t strings_size = root.size();
+        for (const auto& file : files) {
+            strings_size += file.size();
+        }
+        const uint64_t files_strings_end = strings_size;
+
+        size_t chunk_count = 0;
+        for (const Run* run : merged) {
+            chunk_count += run->end - run->begin;
+        }
+        std::vector<uint32_t> text_ids(chunk_count);
+        std::vector<uint64_t> unique_offsets;
+        StringInternTable texts(chunk_count / 4);
+        // Visit the merged chunks in order: f(chunk number, record, shares the previous chunk's context)
+        auto each_chunk = [&](auto&& f) {
+            size_t n = 0;
+            std::string_view previous_context;
+            for (const Run* run : merged) {
+                const ExtractionIndex& index = *indexes[run->input];
+                for (size_t i = run->begin; i < run->end; i++, n++) {
+                    Record rec = index.record(i);
+                    bool shared = i > run->begin && rec.context.data() == previous_context.data() &&
+                                  rec.context.size() == previous_context.size();
+                    previous_context = rec.context;
+                    f(n, rec, shared);
+                }
+            }
+        };
+        each_chunk([&](size_t n, const Record& rec, bool shared) {
+            if (!shared) {
+                strings_size += rec.context.size();
+            }
+            auto interned = texts.intern(rec.text);
+            if (interned.second) {
+                unique_offsets.push_back(strings_size);
+                strings_size += rec.text.size();
+            }
+            text_ids[n] = interned.first;
+        });
+
+        const uint64_t files_offset = header_size;
+        const uint64_t chunks_offset = files_offset + files.size() * file_record_size;
+        const uint64_t strings_offset = chunks_offset + chunk_count * chunk_record_size;
+
+        std::string temp_path = path + ".tmp";
+        {
+            BufferedFileWriter out(temp_path, std::ios::out | std::ios::binary | std::ios::trunc);
+            if (!out.is_open()) {
+                throw std::runtime_error("Could not write index file: " + temp_path);
+            }
+            BinaryWriter writer(out.data());
+            writer.raw(magic);
+            writer.u32(version);
+            writer.u32(static_cast<uint32_t>(header_size));
+            writer.u64(files.size());
+            writer.u64(chunk_count);
+            writer.u64(files_offset);
+            writer.u64(chunks_offset);
+            writer.u64(strings_offset);
+            writer.u64(strings_size);
+            writer.u64(0);
+            writer.u64(root.size());
+
+            uint64_t offset = root.size();
+            for (const auto& file : files) {
+                writer.u64(offset);
+                writer.u64(file.size());
+                offset += file.size();
+                out.maybe_flush();
+            }
+            // Context offsets follow from the same walk as the first pass
+            uint64_t next_string = files_strings_end;
+            uint64_t context_offset = 0;
+            uint32_t next_text = 0;
+            size_t run = 0;
+            size_t run_end = merged.empty() ? 0 : merged[0]->end - merged[0]->begin;
+            each_chunk([&](size_t n, const Record& rec, bool shared) {
+                while (n >= run_end) {
+                    run++;
+                    run_end += merged[run]->end - merged[run]->begin;
+                }
+                if (!shared) {
+                    context_offset = next_string;
+                    next_string += rec.context.size();
+                }
+                if (text_ids[n] == next_text) {
+                    next_text++;
+                    next_string += rec.text.size();
+                }
+                writer.u64(unique_offsets[text_ids[n]]);
+                writer.u64(context_offset);
+                writer.u32(narrow(rec.text.size()));
+                writer.u32(narrow(rec.context.size()));
+                writer.u32(file_of_run[run]);
+                writer.u32(narrow(rec.line_number));
+                writer.u32(narrow(rec.column_start));
+                writer.u32(narrow(rec.column_end));
+                writer.u32(narrow(rec.original_start));
+                writer.u32(narrow(rec.original_length));
+                writer.u32(narrow(rec.part_index));
+                writer.u32(narrow(rec.part_count));
+                out.maybe_flush();
+            });
+
+            writer.raw(root);
+            for (const auto& file : files) {
+                writer.raw(file);
+                out.maybe_flush();
+            }
+            next_text = 0;
+            each_chunk([&](size_t n, const Record& rec, bool shared) {
+                if (!shared) {
+                    writer.raw(rec.context);
+                }
+                if (text_ids[n] == next_text) {
+                    next_text++;
+                    writer.raw(rec.text);
+                }
+                out.maybe_flush();
+            });
+            if (!out.close()) {
+                throw std::runtime_error("Error writing index file: " + temp_path);
+            }
+        }
+        // Release the inputs first, in case one of them is being replaced
+        indexes.clear();
+        fs::rename(temp_path, path);
+        result.files = files.size();
+        result.chunks = chunk_count;
+        return result;
+    }
+
+private:
+    FileBuffer buffer;
+    std::string_view data;
+    uint64_t file_count = 0;
+    uint64_t chunk_count = 0;
+    uint64_t files_offset = 0;
+    uint64_t chunks_offset = 0;
+    uint64_t strings_offset = 0;
+    uint64_t strings_size = 0;
+    std::string_view source_root_view;
+
+    bool in_file(uint64_t offset, uint64_t count, uint64_t record_size) const {
+        if (offset > data.size() || count > (data.size() - offset) / record_size) {
+            return false;
+        }
+        return true;
+    }
+
+    static void check_index(size_t index, uint64_t count) {
+        if (index >= count) {
+            throw std::out_of_range("index out of range");
+        }
+    }
+
+    std::string_view string_at(uint64_t offset, uint64_t length) const {
+        if (offset > strings_size || length > strings_size - offset) {
+            throw std::runtime_error("Corrupt extraction index string reference");
+        }
+        return data.substr(static_cast<size_t>(strings_offset + offset), static_cast<size_t>(length));
+    }
+
+    TextExtractor::TextChunk to_chunk(const Record& rec, const std::shared_ptr<TextExtractor::SourceText>& source,
+                                      size_t context_offset) const {
+        TextExtractor::TextChunk chunk;
+        chunk.text = std::string(rec.text);
+        chunk.file_path = std::string(file_path(rec.file_index));
+        chunk.line_number = rec.line_number;
+        chunk.column_start = rec.column_start;
+        chunk.column_end = rec.column_end;
+        chunk.source = source;
+        chunk.context_offset = context_offset;
+        chunk.context_length = rec.context.size();
+        chunk.original_offset = context_offset + rec.original_start;
+        chunk.original_length = rec.original_length;
+        chunk.part_index = rec.part_index;
+        chunk.part_count = rec.part_count;
+        return chunk;
+    }
+
+    static bool same_context(const TextExtractor::TextChunk& a, const TextExtractor::TextChunk& b) {
+        return a.source == b.source && a.context_offset == b.context_offset && a.context_length == b.context_length;
+    }
+
+    // `path` relative to `root` with '/' separators; empty if it is not under root
+    static std::string relative_path(std::string_view path, std::string_view root) {
+        auto separator = [](char ch) { return ch == '/' || ch == '\\'; };
+        if (path.size() <= root.size() || path.substr(0, root.size()) != root) {
+            return std::string();
+        }
+        size_t start = root.size();
+        if (!root.empty() && !separator(root.back())) {
+            if (!separator(path[start])) {
+                return std::string();
+            }
+            start++;
+        }
+        std::string relative(path.substr(start));
+        std::replace(relative.begin(), relative.end(), '\\', '/');
+        return relative;
+    }
+
+    static uint32_t narrow(size_t value) {
+        if (value > UINT32_MAX) {
+            throw std::runtime_error("value too large for the index format");
+        }
+        return static_cast<uint32_t>(value);
+    }
+};
+
+// The chunks of one extraction, kept on the C++ side so that a list view
+// can page through millions of them: count, ranges and display previews
+// without a Python object per chunk. The chunks are either held in memory
+// (filled batch by batch while extracting) or read on demand from a mapped
+// ExtractionIndex. Not synchronised; from Python the GIL serialises access.
+class ChunkStore {
+public:
+    using TextChunk = TextExtractor::TextChunk;
+
+    ChunkStore() = default;
+
+    explicit ChunkStore(std::vector<TextChunk> chunks) : items(std::move(chunks)) {}
+
+    explicit ChunkStore(std::shared_ptr<const ExtractionIndex> index) : index(std::move(index)) {}
+
+    void append(std::vector<TextChunk>&& batch) {
+        if (index) {
+            throw std::logic_error("cannot append to a chunk store read from an index");
+        }
+        if (items.empty()) {
+            items = std::move(batch);
+        } else {
+            items.insert(items.end(), std::make_move_iterator(batch.begin()), std::make_move_iterator(batch.end()));
+        }
+    }
+
+    size_t size() const {
+        return index ? index->get_chunk_count() : items.size();
+    }
+
+    std::string_view text(size_t i) const {
+        if (index) {
+            return index->record(i).text;
+        }
+        check_index(i);
+        return items[i].text;
+    }
+
+    TextChunk chunk(size_t i) const {
+        if (index) {
+            return index->chunk(i);
+        }
+        check_index(i);
+        return items[i];
+    }
+
+    std::string_view file_path(size_t i) const {
+        if (index) {
+            return index->file_path(index->record(i).file_index);
+        }
+        check_index(i);
+        return items[i].file_path;
+    }
+
+    size_t line_number(size_t i) const {
+        if (index) {
+            return index->record(i).line_number;
+        }
+        check_index(i);
+        return items[i].line_number;
+    }
+
+    // Chunks [start, start + count), cut short at the end of the store
+    std::vector<TextChunk> get_range(size_t start, size_t count) const {
+        std::vector<TextChunk> result;
+        size_t end = range_end(start, count);
+        result.reserve(end - start);
+        for (size_t i = start; i < end; i++) {
+            result.push_back(chunk(i));
+        }
+        return result;
+    }
+
+    // One list line per chunk of [start, start + count): the text, or its first
+    // max_chars characters followed by "... [<length> chars]"
+    std::vector<std::string> previews(size_t start, size_t count, size_t max_chars = 100) const {
+        std::vector<std::string> result;
+        size_t end = range_end(start, count);
+        result.reserve(end - start);
+        for (size_t i = start; i < end; i++) {
+            result.push_back(preview(text(i), max_chars));
+        }
+        return result;
+    }
+
+    // previews() for a list of chunk indices, e.g. search results
+    std::vector<std::string> previews_of(const std::vector<size_t>& indices, size_t max_chars = 100) const {
+        std::vector<std::string> result;
+        result.reserve(indices.size());
+        for (size_t i : indices) {
+            result.push_back(preview(text(i), max_chars));
+        }
+        return result;
+    }
+
+    static std::string preview(std::string_view text, size_t max_chars) {
+        size_t chars = 0;
+        size_t cut = text.size();
+        for (size_t pos = 0; pos < text.size(); pos++) {
+            // Count characters as their first bytes
+            if ((static_cast<unsigned char>(text[pos]) & 0xC0) != 0x80) {
+                if (chars == max_chars) {
+                    cut = pos;
+                }
+                chars++;
+            }
+        }
+        if (chars <= max_chars) {
+            return std::string(text);
+        }
+        std::string result(text.substr(0, cut));
+        result += "... [";
+        result += std::to_string(chars);
+        result += " chars]";
+        return result;
+    }
+
+    struct LengthSummary {
+        size_t max_chars = 0;
+        size_t total_chars = 0;
+        std::vector<size_t> longer_than;   // Texts longer than each threshold
+    };
+
+    // Text lengths in characters, for statistics, without reading the texts into Python
+    LengthSummary length_summary(const std::vector<size_t>& thresholds) const {
+        LengthSummary summary;
+        summary.longer_than.assign(thresholds.size(), 0);
+        for (size_t i = 0; i < size(); i++) {
+            std::string_view value = text(i);
+            size_t chars = 0;
+            for (char c : value) {
+                chars += (static_cast<unsigned char>(c) & 0xC0) != 0x80;
+            }
+            summary.max_chars = std::max(summary.max_chars, chars);
+            summary.total_chars += chars;
+            for (size_t t = 0; t < thresholds.size(); t++) {
+                summary.longer_than[t] += chars > thresholds[t];
+            }
+        }
+        return summary;
+    }
+
+    // All chunks, for the functions that take a chunk list; a store read from
+    // an index decodes them on the first call
+    const std::vector<TextChunk>& chunks() const {
+        if (index) {
+            std::lock_guard<std::mutex> lock(load_mutex);
+            if (items.size() != index->get_chunk_count()) {
+                items = index->chunks();
+            }
+        }
+        return items;
+    }
+
+private:
+    mutable std::vector<TextChunk> items;
+    std::shared_ptr<const ExtractionIndex> index;
+    mutable std::mutex load_mutex;
+
+    void check_index(size_t i) const {
+        if (i >= items.size()) {
+            throw std::out_of_range("index out of range");
+        }
+    }
+
+    size_t range_end(size_t start, size_t count) const {
+        size_t total = size();
+        if (start >= total) {
+            return start;
+        }
+        return start + std::min(count, total - start);
+    }
+};
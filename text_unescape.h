@@ -0,0 +1,185 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Escape decoding used by TextExtractor to clean matched texts, and the
+// matching encoder used when translations are written back.
+// Kept free of pybind11 so benchmarks can include it directly.
+
+namespace text_unescape {
+
+// Same character set as std::isspace in the classic locale
+inline bool is_space(unsigned char ch) {
+    return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\v' || ch == '\f' || ch == '\r';
+}
+
+inline int hex_value(char ch) {
+    if (ch >= '0' && ch <= '9') return ch - '0';
+    if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+    if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+    return -1;
+}
+
+// Parse the four hex digits of a \uXXXX escape starting at `pos`; -1 if invalid
+inline long parse_hex4(std::string_view text, size_t pos) {
+    if (pos + 4 > text.size()) {
+        return -1;
+    }
+    long value = 0;
+    for (size_t i = 0; i < 4; i++) {
+        int digit = hex_value(text[pos + i]);
+        if (digit < 0) {
+            return -1;
+        }
+        value = (value << 4) | digit;
+    }
+    return value;
+}
+
+inline void append_utf8(std::string& out, uint32_t cp) {
+    if (cp < 0x80) {
+        out.push_back(static_cast<char>(cp));
+    } else if (cp < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else {
+        out.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+}
+
+// Decode \n \t \r \" \' \\ and \uXXXX (including surrogate pairs) and trim
+// surrounding whitespace, in a single left-to-right pass. The result is
+// written to `out`, which is cleared first so one buffer can be reused for
+// every match. Unknown or malformed escapes are copied through unchanged;
+// lone surrogates become U+FFFD.
+inline void unescape(std::string_view text, std::string& out) {
+    out.clear();
+    size_t trimmed_size = 0;   // Size of `out` without trailing whitespace
+
+    auto emit = [&](char ch) {
+        // Leading whitespace is dropped before it is ever written
+        if (out.empty() && is_space(static_cast<unsigned char>(ch))) {
+            return;
+        }
+        out.push_back(ch);
+        if (!is_space(static_cast<unsigned char>(ch))) {
+            trimmed_size = out.size();
+        }
+    };
+
+    size_t pos = 0;
+    while (pos < text.size()) {
+        // Copy the run up to the next backslash in one go
+        size_t backslash = text.find('\\', pos);
+        size_t run_end = backslash == std::string_view::npos ? text.size() : backslash;
+        if (out.empty()) {
+            while (pos < run_end && is_space(static_cast<unsigned char>(text[pos]))) {
+                pos++;
+            }
+        }
+        if (pos < run_end) {
+            size_t run_start = out.size();
+            out.append(text.data() + pos, run_end - pos);
+            for (size_t i = out.size(); i > run_start; i--) {
+                if (!is_space(static_cast<unsigned char>(out[i - 1]))) {
+                    trimmed_size = i;
+                    break;
+                }
+            }
+            pos = run_end;
+        }
+        if (pos >= text.size()) {
+            break;
+        }
+
+        if (pos + 1 >= text.size()) {
+            emit('\\');
+            break;
+        }
+
+        char escaped = text[pos + 1];
+        switch (escaped) {
+            case 'n': emit('\n'); pos += 2; break;
+            case 't': emit('\t'); pos += 2; break;
+            case 'r': emit('\r'); pos += 2; break;
+            case '"': emit('"'); pos += 2; break;
+            case '\'': emit('\''); pos += 2; break;
+            case '\\': emit('\\'); pos += 2; break;
+            case 'u': {
+                long unit = parse_hex4(text, pos + 2);
+                if (unit < 0) {
+                    emit('\\');
+                    pos += 1;
+                    break;
+                }
+                uint32_t cp = static_cast<uint32_t>(unit);
+                pos += 6;
+                if (cp >= 0xD800 && cp <= 0xDBFF) {
+                    long low = pos + 1 < text.size() && text[pos] == '\\' && text[pos + 1] == 'u'
+                                   ? parse_hex4(text, pos + 2) : -1;
+                    if (low >= 0xDC00 && low <= 0xDFFF) {
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (static_cast<uint32_t>(low) - 0xDC00);
+                        pos += 6;
+                    } else {
+                        cp = 0xFFFD;
+                    }
+                } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+                    cp = 0xFFFD;
+                }
+
+                // Code points >= 0x80 are never whitespace, so bypass emit()
+                if (cp < 0x80) {
+                    emit(static_cast<char>(cp));
+                } else {
+                    append_utf8(out, cp);
+                    trimmed_size = out.size();
+                }
+                break;
+            }
+            default:
+                emit('\\');
+                pos += 1;
+                break;
+        }
+    }
+
+    out.resize(trimmed_size);
+}
+
+// Inverse of unescape() for writing text back into a source file: encodes
+// backslashes, CR, LF and TAB, and the enclosing `quote` character (0 = none)
+inline void escape(std::string_view text, char quote, std::string& out) {
+    out.clear();
+    out.reserve(text.size());
+    for (char ch : text) {
+        switch (ch) {
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (quote != 0 && ch == quote) {
+                    out.push_back('\\');
+                }
+                out.push_back(ch);
+                break;
+        }
+    }
+}
+
+inline std::string unescape(std::string_view text) {
+    std::string out;
+    unescape(text, out);
+    return out;
+}
+
+}  // namespace text_unescape
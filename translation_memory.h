@@ -0,0 +1,812 @@
+#pragma once
+
+#include <cmath>
+
+#include "text_extractor.h"
+
+// Fuzzy lookup of earlier translations. The source texts are indexed by
+// character trigrams; a lookup takes the few entries sharing the most
+// trigrams with the query and ranks them by edit distance, so "Potion x3"
+// finds the translation of "Potion x2". Lookups read a bounded number of
+// postings, so their cost barely grows with the memory; the price is that a
+// query made only of very common trigrams may miss a weaker match. The index
+// has the same form in memory and on disk, so opening a saved memory maps the
+// file and parses nothing.
+//
+// Layout, all integers little-endian:
+//   header   "GTXTRMEM", u32 version, u32 header size, u64 entry count,
+//            u64 gram count, u64 offsets of the entry table, gram table,
+//            posting table and string table, u64 string table size
+//   entry    u64 source offset, u64 translation offset, u32 source length,
+//            u32 translation length, u32 trigram count, u32 character count
+//   gram     u32 trigram hash, u32 posting count, u64 first posting
+//   posting  u32 entry index
+// Entries are sorted by character count, then source text, so the entries
+// long enough and short enough to match a query are a range of indexes; the
+// postings of a gram list its entries in ascending order. Grams are sorted
+// by hash. String offsets are relative to the string table.
+class TranslationMemory {
+public:
+    static constexpr std::string_view magic = "GTXTRMEM";
+    static constexpr uint32_t version = 1;
+    static constexpr size_t header_size = 72;
+    static constexpr size_t entry_record_size = 32;
+    static constexpr size_t gram_record_size = 16;
+    // Lookup limits: postings read before common trigrams stop adding
+    // candidates, and candidates scored by edit distance (at least 8 per
+    // match asked for)
+    static constexpr size_t posting_budget = 16384;
+    static constexpr size_t max_candidates = 64;
+
+    struct Match {
+        size_t index;
+        std::string source;
+        std::string translation;
+        double score;   // 1 - edit distance / characters of the longer text
+    };
+
+    // Open (memory-map) a memory written by save()
+    explicit TranslationMemory(const std::string& path) {
+        // Threshold 0: always map, never copy
+        if (!buffer.open(path, 0)) {
+            throw std::runtime_error("Could not open translation memory: " + path);
+        }
+        load(buffer.view(), path);
+    }
+
+    TranslationMemory(const TranslationMemory&) = delete;
+    TranslationMemory& operator=(const TranslationMemory&) = delete;
+
+    // Index {source text: translation} on `threads` threads (0 = all cores)
+    static std::unique_ptr<TranslationMemory> build(const std::unordered_map<std::string, std::string>& translations,
+                                                    size_t threads = 0) {
+        using Pair = std::pair<const std::string, std::string>;
+        const size_t entry_count = translations.size();
+        if (entry_count > UINT32_MAX) {
+            throw std::length_error("too many entries for a translation memory");
+        }
+        if (threads == 0) {
+            threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+        }
+        WorkStealingPool pool(threads);
+
+        struct Source {
+            uint32_t char_count;
+            const Pair* entry;
+        };
+        std::vector<Source> entries;
+        entries.reserve(entry_count);
+        for (const auto& entry : translations) {
+            entries.push_back({0, &entry});
+        }
+        const size_t range_size = 16384;
+        const size_t range_count = (entry_count + range_size - 1) / range_size;
+        for (size_t r = 0; r < range_count; r++) {
+            pool.submit([&, r] {
+                size_t end = std::min(entry_count, (r + 1) * range_size);
+                for (size_t i = r * range_size; i < end; i++) {
+                    entries[i].char_count = narrow(character_count(entries[i].entry->first));
+                }
+            });
+        }
+        pool.wait();
+        std::sort(entries.begin(), entries.end(), [](const Source& a, const Source& b) {
+            return a.char_count != b.char_count ? a.char_count < b.char_count : a.entry->first < b.entry->first;
+        });
+
+        // Each range of entries sorts its (trigram << 32 | entry) keys into
+        // buckets by the top byte of the trigram, so that every bucket can
+        // be sorted and written on its own
+        constexpr size_t bucket_count = 256;
+        std::vector<std::vector<std::vector<uint64_t>>> range_keys(range_count);
+        std::vector<uint32_t> gram_counts(entry_count);
+        for (size_t r = 0; r < range_count; r++) {
+            pool.submit([&, r] {
+                LookupScratch& scratch = LookupScratch::local();
+                auto& keys = range_keys[r];
+                keys.resize(bucket_count);
+                size_t end = std::min(entry_count, (r + 1) * range_size);
+                for (size_t i = r * range_size; i < end; i++) {
+                    index_characters(entries[i].entry->first, scratch.chars);
+                    trigrams(scratch.chars, scratch.grams);
+                    gram_counts[i] = static_cast<uint32_t>(scratch.grams.size());
+                    for (uint32_t gram : scratch.grams) {
+                        keys[gram >> 24].push_back(static_cast<uint64_t>(gram) << 32 | i);
+                    }
+                }
+            });
+        }
+        pool.wait();
+
+        std::vector<std::vector<uint64_t>> buckets(bucket_count);
+        std::vector<uint64_t> bucket_grams(bucket_count, 0);
+        for (size_t b = 0; b < bucket_count; b++) {
+            pool.submit([&, b] {
+                std::vector<uint64_t>& keys = buckets[b];
+                size_t total = 0;
+                for (const auto& range : range_keys) {
+                    total += range[b].size();
+                }
+                keys.reserve(total);
+                for (auto& range : range_keys) {
+                    keys.insert(keys.end(), range[b].begin(), range[b].end());
+                    std::vector<uint64_t>().swap(range[b]);
+                }
+                std::sort(keys.begin(), keys.end());
+                for (size_t i = 0; i < keys.size(); i++) {
+                    if (i == 0 || (keys[i] >> 32) != (keys[i - 1] >> 32)) {
+                        bucket_grams[b]++;
+                    }
+                }
+            });
+        }
+        pool.wait();
+        std::vector<std::vector<std::vector<uint64_t>>>().swap(range_keys);
+
+        std::vector<uint64_t> gram_base(bucket_count + 1, 0);
+        std::vector<uint64_t> posting_base(bucket_count + 1, 0);
+        for (size_t b = 0; b < bucket_count; b++) {
+            gram_base[b + 1] = gram_base[b] + bucket_grams[b];
+            posting_base[b + 1] = posting_base[b] + buckets[b].size();
+        }
+        std::vector<uint64_t> string_offsets(entry_count + 1, 0);
+        for (size_t i = 0; i < entry_count; i++) {
+            string_offsets[i + 1] = string_offsets[i] + entries[i].entry->first.size() + entries[i].entry->second.size();
+        }
+        const uint64_t entries_offset = header_size;
+        const uint64_t grams_offset = entries_offset + entry_count * entry_record_size;
+        const uint64_t postings_offset = grams_offset + gram_base[bucket_count] * gram_record_size;
+        const uint64_t strings_offset = postings_offset + posting_base[bucket_count] * 4;
+        const uint64_t strings_size = string_offsets[entry_count];
+
+        std::unique_ptr<TranslationMemory> memory(new TranslationMemory());
+        std::string& image = memory->image;
+        image.resize(static_cast<size_t>(strings_offset + strings_size));
+        {
+            std::string header;
+            BinaryWriter writer(header);
+            writer.raw(magic);
+            writer.u32(version);
+            writer.u32(static_cast<uint32_t>(header_size));
+            writer.u64(entry_count);
+            writer.u64(gram_base[bucket_count]);
+            writer.u64(entries_offset);
+            writer.u64(grams_offset);
+            writer.u64(postings_offset);
+            writer.u64(strings_offset);
+            writer.u64(strings_size);
+            std::memcpy(image.data(), header.data(), header.size());
+        }
+        for (size_t r = 0; r < range_count; r++) {
+            pool.submit([&, r] {
+                size_t end = std::min(entry_count, (r + 1) * range_size);
+                for (size_t i = r * range_size; i < end; i++) {
+                    const std::string& source = entries[i].entry->first;
+                    const std::string& translation = entries[i].entry->second;
+                    char* record = image.data() + entries_offset + i * entry_record_size;
+                    store_u64(record, string_offsets[i]);
+                    store_u64(record + 8, string_offsets[i] + source.size());
+                    store_u32(record + 16, narrow(source.size()));
+                    store_u32(record + 20, narrow(translation.size()));
+                    store_u32(record + 24, gram_counts[i]);
+                    store_u32(record + 28, entries[i].char_count);
+                    char* text = image.data() + strings_offset + string_offsets[i];
+                    std::memcpy(text, source.data(), source.size());
+                    std::memcpy(text + source.size(), translation.data(), translation.size());
+                }
+            });
+        }
+        for (size_t b = 0; b < bucket_count; b++) {
+            pool.submit([&, b] {
+                const std::vector<uint64_t>& keys = buckets[b];
+                char* gram = image.data() + grams_offset + gram_base[b] * gram_record_size;
+                char* posting = image.data() + postings_offset + posting_base[b] * 4;
+                for (size_t i = 0; i < keys.size();) {
+                    uint32_t hash = static_cast<uint32_t>(keys[i] >> 32);
+                    size_t first = i;
+                    for (; i < keys.size() && static_cast<uint32_t>(keys[i] >> 32) == hash; i++) {
+                        store_u32(posting + i * 4, static_cast<uint32_t>(keys[i]));
+                    }
+                    store_u32(gram, hash);
+                    store_u32(gram + 4, static_cast<uint32_t>(i - first));
+                    store_u64(gram + 8, posting_base[b] + first);
+                    gram += gram_record_size;
+                }
+                std::vector<uint64_t>().swap(buckets[b]);
+            });
+        }
+        pool.wait();
+        memory->load(memory->image, "translation memory");
+        return memory;
+    }
+
+    bool save(const std::string& path) const {
+        try {
+            std::string temp_path = path + ".tmp";
+            {
+                BufferedFileWriter out(temp_path, std::ios::out | std::ios::binary | std::ios::trunc);
+                if (!out.is_open()) {
+                    std::cerr << "Could not write translation memory: " << temp_path << std::endl;
+                    return false;
+                }
+                out.write(data);
+                if (!out.close()) {
+                    std::cerr << "Error writing translation memory: " << temp_path << std::endl;
+                    return false;
+                }
+            }
+            fs::rename(temp_path, path);
+            return true;
+        } catch (const std::exception& e) {
+            std::cerr << "Error saving translation memory: " << e.what() << std::endl;
+            return false;
+        }
+    }
+
+    size_t size() const {
+        return static_cast<size_t>(entry_count);
+    }
+
+    std::string_view source(size_t index) const {
+        return entry(index).source;
+    }
+
+    std::string_view translation(size_t index) const {
+        return entry(index).translation;
+    }
+
+    // The `k` entries most similar to `text` with a score of at least
+    // `min_score`, best first. Candidates are found through the trigrams
+    // they share with the query (letters compared case-insensitively, all
+    // digits alike), then scored by edit distance on the original characters.
+    std::vector<Match> lookup(std::string_view text, size_t k = 5, double min_score = 0.6) const {
+        std::vector<Match> matches;
+        if (k == 0 || entry_count == 0) {
+            return matches;
+        }
+        LookupScratch& scratch = LookupScratch::local();
+        const double threshold = std::clamp(min_score, 0.0, 1.0);
+        characters(text, scratch.query_chars);
+        const size_t query_length = scratch.query_chars.size();
+
+        // Entries whose length alone keeps them below min_score are outside
+        // [first, last); the postings are cut to that range of indexes
+        const uint32_t first = first_entry_of_length(static_cast<uint32_t>(std::ceil(threshold * query_length - 1e-9)));
+        const double longest = threshold > 0 ? std::floor(query_length / threshold + 1e-9) : UINT32_MAX;
+        const uint32_t last = longest >= UINT32_MAX ? static_cast<uint32_t>(entry_count)
+                                                    : first_entry_of_length(static_cast<uint32_t>(longest) + 1);
+        if (first >= last) {
+            return matches;
+        }
+
+        index_characters(text, scratch.chars);
+        trigrams(scratch.chars, scratch.grams);
+        const size_t query_grams = scratch.grams.size();
+        auto& lists = scratch.lists;
+        lists.clear();
+        for (uint32_t gram : scratch.grams) {
+            Postings postings = find_gram(gram).slice(first, last);
+            if (postings.count > 0) {
+                lists.push_back(postings);
+            }
+        }
+        if (lists.empty()) {
+            return matches;
+        }
+        std::sort(lists.begin(), lists.end(), [](const Postings& a, const Postings& b) { return a.count < b.count; });
+
+        // An entry with a trigram Dice coefficient of at least t shares at
+        // least t * q / (2 - t) of the q query trigrams, so it is in one of
+        // the rarest q - that + 1 lists. Long lists, from trigrams as common
+        // as "the", are read only within a budget so that lookups stay quick
+        // however large the memory grows.
+        const double dice_threshold = threshold / 2;
+        size_t min_overlap = static_cast<size_t>(std::ceil(dice_threshold * query_grams / (2 - dice_threshold) - 1e-9));
+        min_overlap = std::max<size_t>(min_overlap, 1);
+        if (min_overlap > lists.size()) {
+            return matches;
+        }
+        const size_t prefix = lists.size() - min_overlap + 1;
+        if (scratch.counts.size() < entry_count) {
+            scratch.counts.resize(static_cast<size_t>(entry_count), 0);
+        }
+        auto& counts = scratch.counts;
+        auto& touched = scratch.touched;
+        size_t scanned = 0;
+        size_t l = 0;
+        for (; l < prefix && (l == 0 || scanned + lists[l].count <= posting_budget); l++) {
+            scanned += lists[l].count;
+            for (uint32_t p = 0; p < lists[l].count; p++) {
+                uint32_t id = lists[l].at(p);
+                if (id >= entry_count) {
+                    for (uint32_t seen : touched) {
+                        counts[seen] = 0;
+                    }
+                    touched.clear();
+                    throw std::runtime_error("Corrupt translation memory posting");
+                }
+                if (counts[id]++ == 0) {
+                    touched.push_back(id);
+                }
+            }
+        }
+
+        // Only the entries sharing the most of those trigrams are scored,
+        // ties going to the lengths nearest the query's
+        const size_t limit = std::max<size_t>(max_candidates, k * 8);
+        auto& histogram = scratch.histogram;
+        histogram.assign(l + 1, 0);
+        for (uint32_t id : touched) {
+            histogram[counts[id]]++;
+        }
+        uint32_t min_count = static_cast<uint32_t>(l);
+        for (size_t above = histogram[l]; min_count > 1 && above < limit;) {
+            above += histogram[--min_count];
+        }
+        auto& candidates = scratch.candidates;
+        candidates.clear();
+        for (uint32_t id : touched) {
+            if (counts[id] >= min_count) {
+                candidates.push_back({static_cast<double>(counts[id]), id});
+            }
+            counts[id] = 0;
+        }
+        touched.clear();
+        if (candidates.size() > limit) {
+            auto gap = [&](uint32_t id) {
+                uint32_t chars = load_u32(data.data() + entries_offset + id * entry_record_size + 28);
+                return chars > query_length ? chars - query_length : query_length - chars;
+            };
+            std::nth_element(candidates.begin(), candidates.begin() + limit, candidates.end(),
+                             [&](const std::pair<double, uint32_t>& a, const std::pair<double, uint32_t>& b) {
+                                 return a.first != b.first ? a.first > b.first : gap(a.second) < gap(b.second);
+                             });
+            candidates.resize(limit);
+        }
+
+        scratch.pattern.build(scratch.query_chars);
+        auto& scored = scratch.scored;
+        scored.clear();
+        for (const auto& candidate : candidates) {
+            Entry found = entry(candidate.second);
+            size_t longer = std::max<size_t>(query_length, found.char_count);
+            if (longer == 0) {
+                scored.push_back({1.0, candidate.second});
+                continue;
+            }
+            size_t max_distance = static_cast<size_t>((1 - threshold) * longer + 1e-9);
+            size_t shorter = std::min<size_t>(query_length, found.char_count);
+            if (longer - shorter > max_distance) {
+                continue;
+            }
+            characters(found.source, scratch.entry_chars);
+            size_t distance = scratch.pattern.distance(scratch.entry_chars);
+            if (distance <= max_distance) {
+                scored.push_back({1.0 - static_cast<double>(distance) / longer, candidate.second});
+            }
+        }
+        std::sort(scored.begin(), scored.end(),
+                  [](const std::pair<double, uint32_t>& a, const std::pair<double, uint32_t>& b) {
+                      return a.first != b.first ? a.first > b.first : a.second < b.second;
+                  });
+        for (size_t i = 0; i < scored.size() && matches.size() < k; i++) {
+            if (scored[i].first < threshold) {
+                break;
+            }
+            Entry found = entry(scored[i].second);
+            matches.push_back({scored[i].second, std::string(found.source), std::string(found.translation),
+                               scored[i].first});
+        }
+        return matches;
+    }
+
+    // lookup() for many texts at once, on `threads` threads (0 = all cores)
+    std::vector<std::vector<Match>> lookup_many(const std::vector<std::string>& texts, size_t k = 5,
+                                                double min_score = 0.6, size_t threads = 0) const {
+        std::vector<std::vector<Match>> results(texts.size());
+        if (threads == 0) {
+            threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+        }
+        const size_t batch = 256;
+        WorkStealingPool pool(std::min(threads, std::max<size_t>((texts.size() + batch - 1) / batch, 1)));
+        for (size_t begin = 0; begin < texts.size(); begin += batch) {
+            pool.submit([this, &texts, &results, k, min_score, begin, batch] {
+                size_t end = std::min(texts.size(), begin + batch);
+                for (size_t i = begin; i < end; i++) {
+                    results[i] = lookup(texts[i], k, min_score);
+                }
+            });
+        }
+        pool.wait();
+        return results;
+    }
+
+private:
+    FileBuffer buffer;    // The mapped file, for a memory opened from disk
+    std::string image;    // The index, for a memory built in this process
+    std::string_view data;
+    uint64_t entry_count = 0;
+    uint64_t gram_count = 0;
+    uint64_t posting_count = 0;
+    uint64_t entries_offset = 0;
+    uint64_t grams_offset = 0;
+    uint64_t postings_offset = 0;
+    uint64_t strings_offset = 0;
+    uint64_t strings_size = 0;
+
+    TranslationMemory() = default;
+
+    struct Entry {
+        std::string_view source;
+        std::string_view translation;
+        uint32_t gram_count;
+        uint32_t char_count;
+    };
+
+    // Entry indexes of one trigram, in the mapped data
+    struct Postings {
+        const char* ids;
+        uint32_t count;
+
+        uint32_t at(uint32_t i) const {
+            return load_u32(ids + static_cast<size_t>(i) * 4);
+        }
+
+        // Position of the first index >= id
+        uint32_t lower_bound(uint32_t id) const {
+            uint32_t low = 0;
+            uint32_t high = count;
+            while (low < high) {
+                uint32_t mid = low + (high - low) / 2;
+                if (at(mid) < id) {
+                    low = mid + 1;
+                } else {
+                    high = mid;
+                }
+            }
+            return low;
+        }
+
+        // The indexes in [first, last)
+        Postings slice(uint32_t first, uint32_t last) const {
+            uint32_t begin = lower_bound(first);
+            uint32_t end = lower_bound(last);
+            return {ids + static_cast<size_t>(begin) * 4, end - begin};
+        }
+    };
+
+    // Edit distance to one query, a column of the distance matrix per step
+    // and 64 rows per machine word (Myers' bit-vector algorithm, in blocks)
+    class BitPattern {
+    public:
+        void build(const std::vector<uint32_t>& query) {
+            length = query.size();
+            blocks = (length + 63) / 64;
+            table_size = 16;
+            shift = 28;
+            while (table_size < query.size() * 2) {
+                table_size *= 2;
+                shift--;
+            }
+            ascii.assign(128 * blocks, 0);
+            keys.assign(table_size, empty);
+            masks.assign(table_size * blocks, 0);
+            for (size_t i = 0; i < length; i++) {
+                uint32_t c = query[i];
+                uint64_t* mask = c < 128 ? &ascii[c * blocks] : &masks[slot(c) * blocks];
+                mask[i / 64] |= uint64_t(1) << (i % 64);
+            }
+            positive.resize(blocks);
+            negative.resize(blocks);
+        }
+
+        size_t distance(const std::vector<uint32_t>& text) {
+            if (length == 0) {
+                return text.size();
+            }
+            std::fill(positive.begin(), positive.end(), ~uint64_t(0));
+            std::fill(negative.begin(), negative.end(), 0);
+            const uint64_t high_bit = uint64_t(1) << 63;
+            const uint64_t last_bit = uint64_t(1) << ((length - 1) % 64);
+            size_t score = length;
+            for (uint32_t c : text) {
+                const uint64_t* equals = c < 128 ? &ascii[c * blocks] : find(c);
+                // Row 0 of the matrix counts up, D[0][j] = j, so the first
+                // block always sees a horizontal step of +1
+                int carry = 1;
+                for (size_t b = 0; b < blocks; b++) {
+                    uint64_t equal = equals ? equals[b] : 0;
+                    uint64_t pv = positive[b];
+                    uint64_t mv = negative[b];
+                    uint64_t vertical = equal | mv;
+                    if (carry < 0) {
+                        equal |= 1;
+                    }
+                    uint64_t horizontal = (((equal & pv) + pv) ^ pv) | equal;
+                    uint64_t ph = mv | ~(horizontal | pv);
+                    uint64_t mh = pv & horizontal;
+                    uint64_t out = b + 1 == blocks ? last_bit : high_bit;
+                    int next = (ph & out) ? 1 : (mh & out) ? -1 : 0;
+                    ph <<= 1;
+                    mh <<= 1;
+                    if (carry < 0) {
+                        mh |= 1;
+                    } else if (carry > 0) {
+                        ph |= 1;
+                    }
+                    positive[b] = mh | ~(vertical | ph);
+                    negative[b] = ph & vertical;
+                    carry = next;
+                }
+                score += carry;
+            }
+            return score;
+        }
+
+    private:
+        static constexpr uint32_t empty = UINT32_MAX;
+        size_t length = 0;
+        size_t blocks = 0;
+        size_t table_size = 0;
+        int shift = 0;                  // Hash to the top log2(table_size) bits
+        std::vector<uint64_t> ascii;    // Masks of the ASCII characters, `blocks` words each
+        std::vector<uint32_t> keys;     // Open-addressed table of the others
+        std::vector<uint64_t> masks;
+        std::vector<uint64_t> positive;
+        std::vector<uint64_t> negative;
+
+        size_t hash(uint32_t c) const {
+            return static_cast<size_t>((c * 0x9E3779B1u) >> shift);
+        }
+
+        size_t slot(uint32_t c) {
+            size_t i = hash(c);
+            while (keys[i] != empty && keys[i] != c) {
+                i = (i + 1) & (table_size - 1);
+            }
+            keys[i] = c;
+            return i;
+        }
+
+        const uint64_t* find(uint32_t c) const {
+            for (size_t i = hash(c);; i = (i + 1) & (table_size - 1)) {
+                if (keys[i] == c) {
+                    return &masks[i * blocks];
+                }
+                if (keys[i] == empty) {
+                    return nullptr;
+                }
+            }
+        }
+    };
+
+    // Buffers one thread reuses from lookup to lookup
+    struct LookupScratch {
+        std::vector<uint32_t> chars;
+        std::vector<uint32_t> grams;
+        std::vector<Postings> lists;
+        std::vector<uint32_t> counts;     // Trigrams shared with the query, by entry; zero between lookups
+        std::vector<uint32_t> touched;    // Entries with a non-zero count
+        std::vector<size_t> histogram;    // Touched entries by count
+        std::vector<std::pair<double, uint32_t>> candidates;
+        std::vector<std::pair<double, uint32_t>> scored;
+        std::vector<uint32_t> query_chars;
+        std::vector<uint32_t> entry_chars;
+        BitPattern pattern;
+
+        static LookupScratch& local() {
+            thread_local LookupScratch scratch;
+            return scratch;
+        }
+    };
+
+    void load(std::string_view contents, const std::string& name) {
+        data = contents;
+        BinaryReader reader(data);
+        if (data.size() < header_size || reader.raw(magic.size()) != magic) {
+            throw std::runtime_error("Not a translation memory: " + name);
+        }
+        if (reader.u32() != version || reader.u32() != header_size) {
+            throw std::runtime_error("Unsupported translation memory version: " + name);
+        }
+        entry_count = reader.u64();
+        gram_count = reader.u64();
+        entries_offset = reader.u64();
+        grams_offset = reader.u64();
+        postings_offset = reader.u64();
+        strings_offset = reader.u64();
+        strings_size = reader.u64();
+        if (!in_data(entries_offset, entry_count, entry_record_size) ||
+            !in_data(grams_offset, gram_count, gram_record_size) ||
+            postings_offset > strings_offset || !in_data(strings_offset, strings_size, 1) ||
+            (strings_offset - postings_offset) % 4 != 0 || entry_count > UINT32_MAX) {
+            throw std::runtime_error("Truncated translation memory: " + name);
+        }
+        posting_count = (strings_offset - postings_offset) / 4;
+    }
+
+    bool in_data(uint64_t offset, uint64_t count, uint64_t record_size) const {
+        return offset <= data.size() && count <= (data.size() - offset) / record_size;
+    }
+
+    Entry entry(size_t index) const {
+        if (index >= entry_count) {
+            throw std::out_of_range("index out of range");
+        }
+        BinaryReader reader(data.substr(static_cast<size_t>(entries_offset + index * entry_record_size),
+                                        entry_record_size));
+        uint64_t source_offset = reader.u64();
+        uint64_t translation_offset = reader.u64();
+        uint32_t source_length = reader.u32();
+        uint32_t translation_length = reader.u32();
+        Entry result;
+        result.source = string_at(source_offset, source_length);
+        result.translation = string_at(translation_offset, translation_length);
+        result.gram_count = reader.u32();
+        result.char_count = reader.u32();
+        return result;
+    }
+
+    std::string_view string_at(uint64_t offset, uint64_t length) const {
+        if (offset > strings_size || length > strings_size - offset) {
+            throw std::runtime_error("Corrupt translation memory string reference");
+        }
+        return data.substr(static_cast<size_t>(strings_offset + offset), static_cast<size_t>(length));
+    }
+
+    // Index of the first entry with at least `length` characters
+    uint32_t first_entry_of_length(uint32_t length) const {
+        uint64_t low = 0;
+        uint64_t high = entry_count;
+        const char* entries = data.data() + entries_offset;
+        while (low < high) {
+            uint64_t mid = low + (high - low) / 2;
+            if (load_u32(entries + mid * entry_record_size + 28) < length) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        return static_cast<uint32_t>(low);
+    }
+
+    Postings find_gram(uint32_t hash) const {
+        uint64_t low = 0;
+        uint64_t high = gram_count;
+        const char* grams = data.data() + grams_offset;
+        while (low < high) {
+            uint64_t mid = low + (high - low) / 2;
+            uint32_t value = load_u32(grams + mid * gram_record_size);
+            if (value < hash) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        if (low == gram_count || load_u32(grams + low * gram_record_size) != hash) {
+            return {nullptr, 0};
+        }
+        const char* record = grams + low * gram_record_size;
+        uint32_t count = load_u32(record + 4);
+        uint64_t first = load_u64(record + 8);
+        if (first > posting_count || count > posting_count - first) {
+            throw std::runtime_error("Corrupt translation memory gram");
+        }
+        return {data.data() + postings_offset + first * 4, count};
+    }
+
+    // Next UTF-8 character at `pos`; a byte that does not start a valid
+    // sequence stands for itself, outside the Unicode range
+    static uint32_t next_character(std::string_view text, size_t& pos) {
+        unsigned char lead = static_cast<unsigned char>(text[pos]);
+        size_t length = lead < 0x80 ? 1 : (lead >> 5) == 0x6 ? 2 : (lead >> 4) == 0xE ? 3 : (lead >> 3) == 0x1E ? 4 : 0;
+        if (length == 0 || pos + length > text.size()) {
+            pos++;
+            return 0x110000 + lead;
+        }
+        uint32_t c = length == 1 ? lead : lead & (0x7F >> length);
+        for (size_t i = 1; i < length; i++) {
+            unsigned char next = static_cast<unsigned char>(text[pos + i]);
+            if ((next & 0xC0) != 0x80) {
+                pos++;
+                return 0x110000 + lead;
+            }
+            c = (c << 6) | (next & 0x3F);
+        }
+        pos += length;
+        return c;
+    }
+
+    static size_t character_count(std::string_view text) {
+        size_t count = 0;
+        for (size_t pos = 0; pos < text.size(); count++) {
+            next_character(text, pos);
+        }
+        return count;
+    }
+
+    static void characters(std::string_view text, std::vector<uint32_t>& out) {
+        out.clear();
+        for (size_t pos = 0; pos < text.size();) {
+            out.push_back(next_character(text, pos));
+        }
+    }
+
+    // Characters as the trigram index sees them: ASCII letters lower-cased,
+    // every digit as '0', and runs of whitespace as one space
+    static void index_characters(std::string_view text, std::vector<uint32_t>& out) {
+        out.clear();
+        bool in_space = false;
+        for (size_t pos = 0; pos < text.size();) {
+            uint32_t c = next_character(text, pos);
+            if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+                if (!in_space && !out.empty()) {
+                    out.push_back(' ');
+                }
+                in_space = true;
+                continue;
+            }
+            in_space = false;
+            if (c >= 'A' && c <= 'Z') {
+                c += 'a' - 'A';
+            } else if (c >= '0' && c <= '9') {
+                c = '0';
+            }
+            out.push_back(c);
+        }
+        if (!out.empty() && out.back() == ' ') {
+            out.pop_back();
+        }
+    }
+
+    // Distinct trigram hashes, sorted. The text is padded at both ends, so
+    // n characters make n trigrams.
+    static void trigrams(const std::vector<uint32_t>& chars, std::vector<uint32_t>& out) {
+        constexpr uint32_t pad = 0x200000;
+        out.clear();
+        const size_t n = chars.size();
+        for (size_t i = 0; i < n; i++) {
+            uint64_t a = i > 0 ? chars[i - 1] : pad;
+            uint64_t b = chars[i];
+            uint64_t c = i + 1 < n ? chars[i + 1] : pad;
+            uint64_t h = a * 0x9E3779B97F4A7C15ULL ^ b * 0xC2B2AE3D27D4EB4FULL ^ c * 0x165667B19E3779F9ULL;
+            h ^= h >> 29;
+            h *= 0xBF58476D1CE4E5B9ULL;
+            h ^= h >> 32;
+            out.push_back(static_cast<uint32_t>(h));
+        }
+        std::sort(out.begin(), out.end());
+        out.erase(std::unique(out.begin(), out.end()), out.end());
+    }
+
+    static uint32_t load_u32(const char* p) {
+        uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        value = __builtin_bswap32(value);
+#endif
+        return value;
+    }
+
+    static uint64_t load_u64(const char* p) {
+        return load_u32(p) | static_cast<uint64_t>(load_u32(p + 4)) << 32;
+    }
+
+    static void store_u32(char* p, uint32_t value) {
+        for (int i = 0; i < 4; i++) {
+            p[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+        }
+    }
+
+    static void store_u64(char* p, uint64_t value) {
+        store_u32(p, static_cast<uint32_t>(value));
+        store_u32(p + 4, static_cast<uint32_t>(value >> 32));
+    }
+
+    static uint32_t narrow(size_t value) {
+        if (value > UINT32_MAX) {
+            throw std::runtime_error("value too large for the translation memory format");
+        }
+        return static_cast<uint32_t>(value);
+    }
+};